@@ -8,6 +8,7 @@
 
 #include "MainComponent.h"
 #include "MixScriptMixer.h"
+#include "MixScriptTrace.h"
 
 #include <windows.h> // for debug
 
@@ -95,6 +96,13 @@ MainComponent::MainComponent() :
     };
     addAndMakeVisible(record_automation);
 
+    record_rides.setButtonText("Record Rides");
+    record_rides.setToggleState(false, juce::NotificationType::dontSendNotification);
+    record_rides.onClick = [this]() {
+        mixer->HandleAction(MixScript::SourceActionInfo(MixScript::SA_SET_LIVE_RECORD, (int)record_rides.getToggleState()));
+    };
+    addAndMakeVisible(record_rides);
+
     playing_controls.setBounds(4, 160, playing_controls.getWidth(), playing_controls.getHeight());
     addAndMakeVisible(&playing_controls);
     // TODO: Remove old non-thread safe update.
@@ -140,6 +148,7 @@ void MainComponent::prepareToPlay (int samplesPerBlockExpected, double sampleRat
     // but be careful - it will be called on the audio thread, not the GUI thread.
 
     // For more details, see the help for AudioProcessor::prepareToPlay()
+    mixer->PrepareOutput(sampleRate, samplesPerBlockExpected);
 }
 
 void MainComponent::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill)
@@ -152,24 +161,14 @@ void MainComponent::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFil
     // (to prevent the output of random noise)
     bufferToFill.clearActiveBufferRegion();
 
-    mixer->ProcessActions();
-
     int32_t cue_pos = queued_cue.load();
     if (cue_pos != 0) {
         queued_cue.compare_exchange_strong(cue_pos, 0); // TODO: don't block on audio thread
-        if (cue_pos != 0) {
-            mixer->ResetToCue(static_cast<uint32_t>(cue_pos > 0 ? cue_pos : 0));
-        }
-    }
-
-    if (playback_paused.load()) {
-        return;
     }
 
     MixScript::FloatOutputWriter output_writer = { bufferToFill.buffer->getWritePointer(0),
         bufferToFill.buffer->getWritePointer(1) };
-    
-    mixer->Mix(output_writer, bufferToFill.numSamples);
+    mixer->AudioCallback(output_writer, bufferToFill.numSamples, cue_pos, playback_paused.load());
 }
 
 void MainComponent::releaseResources()
@@ -326,9 +325,11 @@ void MainComponent::mouseDown(const MouseEvent &event)
 void MainComponent::SaveProject() {
     const bool paused_state = playback_paused.load();
     playback_paused = true;
-    FileChooser chooser("Select Output File", juce::File::getCurrentWorkingDirectory(), "*.mix");
+    FileChooser chooser("Select Output File", juce::File::getCurrentWorkingDirectory(), "*.mixb;*.mix");
     if (chooser.browseForFileToOpen()) {
-        const juce::File& file = chooser.getResult().withFileExtension(".mix");        
+        // Binary unless text is asked for by name.
+        const juce::File& result = chooser.getResult();
+        const juce::File& file = result.hasFileExtension(".mix") ? result : result.withFileExtension(".mixb");
         mixer->Save(file.getFullPathName().toRawUTF8());
     }
     playback_paused = paused_state;
@@ -337,10 +338,14 @@ void MainComponent::SaveProject() {
 void MainComponent::LoadProject() {
     const bool paused_state = playback_paused.load();
     playback_paused = true;
-    FileChooser chooser("Select Project File", juce::File::getCurrentWorkingDirectory(), "*.mix");
+    FileChooser chooser("Select Project File", juce::File::getCurrentWorkingDirectory(), "*.mixb;*.mix");
     if (chooser.browseForFileToOpen()) {
-        const juce::File& file = chooser.getResult().withFileExtension(".mix");
-        mixer->Load(file.getFullPathName().toRawUTF8());
+        const juce::File& result = chooser.getResult();
+        const juce::File& file = result.hasFileExtension(".mix") ? result : result.withFileExtension(".mixb");
+        if (!mixer->Load(file.getFullPathName().toRawUTF8())) {
+            AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, "Load Project",
+                "Not a MixScript project.");
+        }
         // TODO: Sync visuals state better.
         track_playing_visuals.get()->peaks.dirty = true;
         track_incoming_visuals.get()->peaks.dirty = true;
@@ -348,6 +353,36 @@ void MainComponent::LoadProject() {
     playback_paused = paused_state;
 }
 
+void MainComponent::DumpCallbackStats() {
+    FileChooser chooser("Select Stats File", juce::File::getCurrentWorkingDirectory(), "*.txt");
+    if (chooser.browseForFileToSave(true)) {
+        const juce::File& file = chooser.getResult().withFileExtension(".txt");
+        mixer->callback_stats.Dump(file.getFullPathName().toRawUTF8());
+    }
+}
+
+#ifdef MIXSCRIPT_TRACE
+void MainComponent::DumpTrace() {
+    FileChooser chooser("Select Trace File", juce::File::getCurrentWorkingDirectory(), "*.json");
+    if (chooser.browseForFileToSave(true)) {
+        const juce::File& file = chooser.getResult().withFileExtension(".json");
+        MixScript::DumpTrace(file.getFullPathName().toRawUTF8());
+    }
+}
+#endif
+
+void MainComponent::LoadImpulseResponse() {
+    // Playback continues, the mixer swaps the prepared convolvers in on the audio thread.
+    FileChooser chooser("Select Impulse Response", juce::File::getCurrentWorkingDirectory(), "*.wav");
+    if (chooser.browseForFileToOpen()) {
+        const juce::File& file = chooser.getResult();
+        if (!mixer->LoadImpulseResponse(file.getFullPathName().toRawUTF8())) {
+            AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, "Impulse Response",
+                "Expected a 16 bit wav file.");
+        }
+    }
+}
+
 void MainComponent::ExportRender() {
     const bool paused_state = playback_paused.load();
     playback_paused = true;
@@ -357,6 +392,8 @@ void MainComponent::ExportRender() {
             std::move(mixer->Render()));
         const juce::File& file = chooser.getResult().withFileExtension(".wav");
         MixScript::WriteWaveFile(file.getFullPathName().toRawUTF8(), output_source);
+        AlertWindow::showMessageBoxAsync(AlertWindow::InfoIcon, "Export",
+            String::formatted("Integrated loudness %.1f LUFS", output_source->integrated_lufs));
     }
     playback_paused = paused_state;
 }
@@ -383,6 +420,27 @@ enum MenuActions : int {
     MS_Control_Lp_Shelf_Gain,
     MS_Control_Hp_Shelf_Gain,
     MS_Show_Key_Bindings,
+    MS_Auto_Align_Sync,
+    MS_Tempo_Stretch,
+    MS_Tempo_Varispeed,
+    MS_Quality_Linear,
+    MS_Quality_Cubic,
+    MS_Quality_Sinc,
+    MS_Control_Low_Gain,
+    MS_Control_Mid_Gain,
+    MS_Control_High_Gain,
+    MS_Control_Filter_Sweep,
+    MS_Master_Limiter,
+    MS_Match_Loudness,
+    MS_Control_Convolution_Send,
+    MS_Load_Impulse_Response,
+    MS_Control_Delay_Send,
+    MS_Control_Delay_Feedback,
+    MS_Dump_Callback_Stats,
+    MS_Reset_Callback_Stats,
+    MS_Dump_Trace,
+    MS_Clear_Trace,
+    MS_Realtime_Hardening,
 };
 
 PopupMenu MainComponent::getMenuForIndex(int topLevelMenuIndex, const String& menuName)
@@ -395,18 +453,50 @@ PopupMenu MainComponent::getMenuForIndex(int topLevelMenuIndex, const String& me
         menu.addItem(MS_Load, "Load");
         menu.addItem(MS_Export, "Export");
         menu.addItem(MS_Show_Key_Bindings, "Key Bindings");
+        menu.addSeparator();
+        menu.addItem(MS_Dump_Callback_Stats, "Dump Callback Stats");
+        menu.addItem(MS_Reset_Callback_Stats, "Reset Callback Stats");
+        menu.addItem(MS_Realtime_Hardening, "Realtime Hardening", true, mixer->RealtimeHardening());
+#ifdef MIXSCRIPT_TRACE
+        menu.addItem(MS_Dump_Trace, "Dump Trace");
+        menu.addItem(MS_Clear_Trace, "Clear Trace");
+#endif
     }
     else if (menuName == "Markers") {
         menu.addItem(MS_Gen_Implied_Markers, "Generate Implied Markers");
         menu.addSeparator();
         menu.addItem(MS_Set_Sync, "Set Sync (S)");
         menu.addItem(MS_Align_Sync, "Align Sync");
+        menu.addItem(MS_Auto_Align_Sync, "Auto Align Sync");
         menu.addItem(MS_Gen_Implied_Markers, "Seek Sync");
     }
     else if (menuName == "Controls") {
         menu.addItem(MS_Control_Gain, "Track Gain");
         menu.addItem(MS_Control_Fader, "Fader");
         menu.addItem(MS_Control_Lp_Shelf_Gain, "LP Shelf");
+        menu.addItem(MS_Control_Low_Gain, "Low");
+        menu.addItem(MS_Control_Mid_Gain, "Mid");
+        menu.addItem(MS_Control_High_Gain, "High");
+        menu.addItem(MS_Control_Filter_Sweep, "Filter Sweep");
+        menu.addItem(MS_Control_Convolution_Send, "Convolution Send");
+        menu.addItem(MS_Control_Delay_Send, "Delay Send");
+        menu.addItem(MS_Control_Delay_Feedback, "Delay Feedback");
+        menu.addItem(MS_Load_Impulse_Response, "Load Impulse Response");
+        menu.addSeparator();
+        menu.addItem(MS_Tempo_Stretch, "Stretch To Playing Tempo", true,
+            mixer->Selected().tempo_mode == MixScript::DTM_STRETCH);
+        menu.addItem(MS_Tempo_Varispeed, "Varispeed To Playing Tempo", true,
+            mixer->Selected().tempo_mode == MixScript::DTM_VARISPEED);
+        menu.addSeparator();
+        PopupMenu quality_menu;
+        const nMath::ResampleQuality quality = mixer->output_quality.load();
+        quality_menu.addItem(MS_Quality_Linear, "Linear", true, quality == nMath::RQ_LINEAR);
+        quality_menu.addItem(MS_Quality_Cubic, "Cubic", true, quality == nMath::RQ_CUBIC);
+        quality_menu.addItem(MS_Quality_Sinc, "Sinc", true, quality == nMath::RQ_SINC);
+        menu.addSubMenu("Output Resampling", quality_menu);
+        menu.addItem(MS_Master_Limiter, "Master Limiter", true, !mixer->limiter_bypass.load());
+        menu.addItem(MS_Match_Loudness, String::formatted("Match Loudness (%.0f LUFS)",
+            MixScript::Mixer::kLoudnessTarget));
     }
 
     return menu;
@@ -427,6 +517,26 @@ void MainComponent::menuItemSelected(int menuItemID, int /*topLevelMenuIndex*/)
     case MS_Show_Key_Bindings:
         ShowKeyBindings();
         break;
+    case MS_Dump_Callback_Stats:
+        DumpCallbackStats();
+        break;
+    case MS_Reset_Callback_Stats:
+        mixer->callback_stats.Reset();
+        break;
+    case MS_Realtime_Hardening:
+        if (!mixer->SetRealtimeHardening(!mixer->RealtimeHardening())) {
+            AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, "Realtime Hardening",
+                "Some memory could not be locked, it was prefaulted only. Raise the memlock limit to lock it.");
+        }
+        break;
+#ifdef MIXSCRIPT_TRACE
+    case MS_Dump_Trace:
+        DumpTrace();
+        break;
+    case MS_Clear_Trace:
+        MixScript::ClearTrace();
+        break;
+#endif
     case MS_Set_Sync:
         mixer->SetMixSync();
         break;
@@ -436,6 +546,14 @@ void MainComponent::menuItemSelected(int menuItemID, int /*topLevelMenuIndex*/)
     case MS_Seek_Sync:
         mixer->SeekSync();
         break;
+    case MS_Auto_Align_Sync:
+    {
+        const bool paused_state = playback_paused.load();
+        playback_paused = true;
+        mixer->AutoAlignSync();
+        playback_paused = paused_state;
+    }
+        break;
     case MS_Gen_Implied_Markers:
     {
         const bool paused_state = playback_paused.load();
@@ -444,6 +562,28 @@ void MainComponent::menuItemSelected(int menuItemID, int /*topLevelMenuIndex*/)
         playback_paused = paused_state;
     }
         break;
+    case MS_Tempo_Stretch:
+    case MS_Tempo_Varispeed:
+    {
+        const MixScript::DeckTempoMode mode = menuItemID == MS_Tempo_Stretch ? MixScript::DTM_STRETCH :
+            MixScript::DTM_VARISPEED;
+        const bool active = mixer->Selected().tempo_mode == mode;
+        mixer->HandleAction(MixScript::SourceActionInfo{ MixScript::SA_SET_TEMPO_MODE,
+            static_cast<int>(active ? MixScript::DTM_NONE : mode) });
+    }
+        break;
+    case MS_Quality_Linear:
+    case MS_Quality_Cubic:
+    case MS_Quality_Sinc:
+        mixer->output_quality = static_cast<nMath::ResampleQuality>(menuItemID - MS_Quality_Linear);
+        break;
+    case MS_Master_Limiter:
+        mixer->limiter_bypass = !mixer->limiter_bypass.load();
+        break;
+    case MS_Match_Loudness:
+        mixer->HandleAction(MixScript::SourceActionInfo{ MixScript::SA_MATCH_LOUDNESS,
+            MixScript::Mixer::kLoudnessTarget });
+        break;
     case MS_Control_Fader:
         mixer->SetSelectedAction(MixScript::SA_MULTIPLY_FADER_GAIN);
         break;
@@ -456,22 +596,51 @@ void MainComponent::menuItemSelected(int menuItemID, int /*topLevelMenuIndex*/)
     case MS_Control_Hp_Shelf_Gain:
         mixer->SetSelectedAction(MixScript::SA_MULTIPLY_HP_SHELF_GAIN);
         break;
+    case MS_Control_Low_Gain:
+        mixer->SetSelectedAction(MixScript::SA_MULTIPLY_LOW_GAIN);
+        break;
+    case MS_Control_Mid_Gain:
+        mixer->SetSelectedAction(MixScript::SA_MULTIPLY_MID_GAIN);
+        break;
+    case MS_Control_High_Gain:
+        mixer->SetSelectedAction(MixScript::SA_MULTIPLY_HIGH_GAIN);
+        break;
+    case MS_Control_Filter_Sweep:
+        mixer->SetSelectedAction(MixScript::SA_SWEEP_FILTER);
+        break;
+    case MS_Control_Convolution_Send:
+        mixer->SetSelectedAction(MixScript::SA_MULTIPLY_CONVOLUTION_SEND);
+        break;
+    case MS_Load_Impulse_Response:
+        LoadImpulseResponse();
+        break;
+    case MS_Control_Delay_Send:
+        mixer->SetSelectedAction(MixScript::SA_MULTIPLY_DELAY_SEND);
+        break;
+    case MS_Control_Delay_Feedback:
+        mixer->SetSelectedAction(MixScript::SA_DELAY_FEEDBACK);
+        break;
     default:
         break;
     }
-    if (menuItemID >= MS_Control_Fader && menuItemID <= MS_Control_Gain) {
+    if ((menuItemID >= MS_Control_Fader && menuItemID <= MS_Control_Gain) ||
+        (menuItemID >= MS_Control_Low_Gain && menuItemID <= MS_Control_Filter_Sweep) ||
+        menuItemID == MS_Control_Convolution_Send ||
+        (menuItemID >= MS_Control_Delay_Send && menuItemID <= MS_Control_Delay_Feedback)) {
         track_playing_visuals->gain_automation.dirty = true;
         track_incoming_visuals->gain_automation.dirty = true;
     }
 }
 
 void MainComponent::timerCallback() {
+    mixer->GrowRecordingRoom();
     repaint();
 }
 
 void PaintAudioSource(Graphics& g, const juce::Rectangle<int>& rect, const MixScript::WaveAudioSource* source, 
         MixScript::TrackVisualCache* track_visuals, const bool selected, const int sync_cue_id, 
         const MixScript::SourceAction selected_action) {
+    MS_TRACE_SCOPE("PaintAudioSource");
     MixScript::WavePeaks& peaks = track_visuals->peaks;
     MixScript::AmplitudeAutomation& automation = track_visuals->gain_automation;
 
@@ -616,6 +785,7 @@ void PaintAudioSource(Graphics& g, const juce::Rectangle<int>& rect, const MixSc
 //==============================================================================
 void MainComponent::paint (Graphics& g)
 {
+    MS_TRACE_SCOPE("MainComponent::paint");
     // (Our component is opaque, so we must completely fill the background with a solid colour)
     g.fillAll (getLookAndFeel().findColour (ResizableWindow::backgroundColourId));
 
@@ -665,4 +835,5 @@ void MainComponent::resized()
     label_outfile.setBounds(row_out.removeFromLeft(350));
 
     record_automation.setBounds(row_out.removeFromRight(120));
+    record_rides.setBounds(row_out.removeFromRight(120));
 }
@@ -68,6 +68,7 @@ private:
 
     ToggleButton visual_accentuate;
     ToggleButton record_automation;
+    ToggleButton record_rides;
 
     TrackControlsComponent playing_controls;
 
@@ -78,6 +79,11 @@ private:
     void ExportRender();
     void SaveProject();
     void LoadProject();
+    void LoadImpulseResponse();
+    void DumpCallbackStats();
+#ifdef MIXSCRIPT_TRACE
+    void DumpTrace();
+#endif
 
     void SetUpKeyBindings();
     void ShowKeyBindings();
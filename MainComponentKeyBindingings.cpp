@@ -219,6 +219,66 @@ void MainComponent::SetUpKeyBindings() {
             track_incoming_visuals->gain_automation.dirty = true;
         }
     } });
+    key_bindings.emplace_back(LightKeyBinding{ (int)'5', juce::String("Low Gain"), true, false, false,
+        [this]() {
+        const MixScript::SourceAction selected_action = mixer->SelectedAction();
+        const MixScript::SourceAction next_action = MixScript::SA_MULTIPLY_LOW_GAIN;
+        if (next_action != mixer->SelectedAction()) {
+            mixer->SetSelectedAction(next_action);
+            track_playing_visuals->gain_automation.dirty = true;
+            track_incoming_visuals->gain_automation.dirty = true;
+        }
+    } });
+    key_bindings.emplace_back(LightKeyBinding{ (int)'6', juce::String("Mid Gain"), true, false, false,
+        [this]() {
+        const MixScript::SourceAction selected_action = mixer->SelectedAction();
+        const MixScript::SourceAction next_action = MixScript::SA_MULTIPLY_MID_GAIN;
+        if (next_action != mixer->SelectedAction()) {
+            mixer->SetSelectedAction(next_action);
+            track_playing_visuals->gain_automation.dirty = true;
+            track_incoming_visuals->gain_automation.dirty = true;
+        }
+    } });
+    key_bindings.emplace_back(LightKeyBinding{ (int)'7', juce::String("High Gain"), true, false, false,
+        [this]() {
+        const MixScript::SourceAction selected_action = mixer->SelectedAction();
+        const MixScript::SourceAction next_action = MixScript::SA_MULTIPLY_HIGH_GAIN;
+        if (next_action != mixer->SelectedAction()) {
+            mixer->SetSelectedAction(next_action);
+            track_playing_visuals->gain_automation.dirty = true;
+            track_incoming_visuals->gain_automation.dirty = true;
+        }
+    } });
+    key_bindings.emplace_back(LightKeyBinding{ (int)'8', juce::String("Filter Sweep"), true, false, false,
+        [this]() {
+        const MixScript::SourceAction selected_action = mixer->SelectedAction();
+        const MixScript::SourceAction next_action = MixScript::SA_SWEEP_FILTER;
+        if (next_action != mixer->SelectedAction()) {
+            mixer->SetSelectedAction(next_action);
+            track_playing_visuals->gain_automation.dirty = true;
+            track_incoming_visuals->gain_automation.dirty = true;
+        }
+    } });
+    key_bindings.emplace_back(LightKeyBinding{ (int)'9', juce::String("Convolution Send"), true, false, false,
+        [this]() {
+        const MixScript::SourceAction selected_action = mixer->SelectedAction();
+        const MixScript::SourceAction next_action = MixScript::SA_MULTIPLY_CONVOLUTION_SEND;
+        if (next_action != mixer->SelectedAction()) {
+            mixer->SetSelectedAction(next_action);
+            track_playing_visuals->gain_automation.dirty = true;
+            track_incoming_visuals->gain_automation.dirty = true;
+        }
+    } });
+    key_bindings.emplace_back(LightKeyBinding{ (int)'0', juce::String("Delay Send"), true, false, false,
+        [this]() {
+        const MixScript::SourceAction selected_action = mixer->SelectedAction();
+        const MixScript::SourceAction next_action = MixScript::SA_MULTIPLY_DELAY_SEND;
+        if (next_action != mixer->SelectedAction()) {
+            mixer->SetSelectedAction(next_action);
+            track_playing_visuals->gain_automation.dirty = true;
+            track_incoming_visuals->gain_automation.dirty = true;
+        }
+    } });
 }
 
 juce::String KeyCodeToString(int key_code) {
@@ -20,7 +20,17 @@ namespace MixScript {
         SA_RESET_AUTOMATION_IN_REGION,
         SA_BYPASS,
         SA_SOLO,
-        SA_CUE_POSITION
+        SA_CUE_POSITION,
+        SA_SET_LIVE_RECORD,
+        SA_SET_TEMPO_MODE,
+        SA_MULTIPLY_LOW_GAIN,
+        SA_MULTIPLY_MID_GAIN,
+        SA_MULTIPLY_HIGH_GAIN,
+        SA_SWEEP_FILTER,
+        SA_MATCH_LOUDNESS,
+        SA_MULTIPLY_CONVOLUTION_SEND,
+        SA_MULTIPLY_DELAY_SEND,
+        SA_DELAY_FEEDBACK
     };
 
     struct SourceActionInfo {
@@ -67,6 +77,8 @@ namespace MixScript {
         void WriteAction(const SourceActionInfo& _action);
         void BeginRead();
         bool ReadAction(SourceActionInfo& _action);
+        template <class Ranges>
+        void WorkingMemory(Ranges& ranges) const { ranges.Add(buffer); }
     private:
         std::vector<SourceActionInfo> buffer;
         std::atomic<uint32_t> read_index;
@@ -0,0 +1,559 @@
+// MixScriptAnalysis - onset, tempo and loudness analysis of loaded tracks
+// Author - Nic Taylor
+
+#include "MixScriptAnalysis.h"
+#include "MixScriptTrace.h"
+#include "WavAudioSource.h"
+#include "nFFT.h"
+#include "nLoudness.h"
+#include "nMath.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <algorithm>
+#include <thread>
+#include <assert.h>
+
+namespace MixScript
+{
+    namespace {
+        constexpr float kMinBpm = 70.f;
+        constexpr float kMaxBpm = 180.f;
+        // Log compression so quiet onsets still register next to loud ones.
+        constexpr float kFluxCompression = 1000.f;
+
+        inline float MonoSample(const WaveAudioSource& source, const int64_t sample) {
+            const int16_t* frame = reinterpret_cast<const int16_t*>(source.audio_start) + sample * source.format.channels;
+            int32_t sum = 0;
+            for (uint32_t channel = 0; channel < source.format.channels; ++channel) {
+                sum += frame[channel];
+            }
+            return sum / (32768.f * source.format.channels);
+        }
+
+        struct FluxWorker {
+            const WaveAudioSource& source;
+            const nMath::FFT& fft;
+            const std::vector<float>& window;
+            int64_t num_samples;
+            std::vector<float> input;
+            std::vector<float> real;
+            std::vector<float> imag;
+            std::vector<float> magnitudes[2];
+
+            FluxWorker(const WaveAudioSource& source_, const nMath::FFT& fft_, const std::vector<float>& window_,
+                const int64_t num_samples_) : source(source_), fft(fft_), window(window_), num_samples(num_samples_),
+                input(kOnsetFrameSize), real(kOnsetFrameSize / 2 + 1), imag(kOnsetFrameSize / 2 + 1) {
+                magnitudes[0].resize(kOnsetFrameSize / 2 + 1);
+                magnitudes[1].resize(kOnsetFrameSize / 2 + 1);
+            }
+
+            void Magnitudes(const int64_t frame, std::vector<float>& magnitude) {
+                const int64_t start = frame * kOnsetHopSize;
+                for (uint32_t i = 0; i < kOnsetFrameSize; ++i) {
+                    const int64_t sample = start + i;
+                    input[i] = sample < num_samples ? window[i] * MonoSample(source, sample) : 0.f;
+                }
+                fft.RealForward(&input[0], &real[0], &imag[0]);
+                for (uint32_t bin = 0; bin < magnitude.size(); ++bin) {
+                    magnitude[bin] = logf(1.f + kFluxCompression * sqrtf(real[bin] * real[bin] + imag[bin] * imag[bin]));
+                }
+            }
+
+            void Run(const int64_t first_frame, const int64_t end_frame, float* flux) {
+                MS_TRACE_SCOPE("FluxWorker::Run");
+                // The first frame of the track compares against itself rather than silence.
+                int current = 0;
+                Magnitudes(nMath::Max(first_frame - 1, (int64_t)0), magnitudes[current]);
+                for (int64_t frame = first_frame; frame < end_frame; ++frame) {
+                    const std::vector<float>& previous = magnitudes[current];
+                    current ^= 1;
+                    Magnitudes(frame, magnitudes[current]);
+                    float sum = 0.f;
+                    for (uint32_t bin = 0; bin < previous.size(); ++bin) {
+                        sum += nMath::Max(magnitudes[current][bin] - previous[bin], 0.f);
+                    }
+                    flux[frame] = sum;
+                }
+            }
+        };
+
+        // Weighted energy per loudness hop over [first_hop, end_hop). The filter settles on the audio before
+        // first_hop so chunk boundaries do not restart it from silence.
+        void LoudnessEnergy(const WaveAudioSource& source, const uint32_t frames_per_hop, const int64_t first_hop,
+            const int64_t end_hop, double* hop_energy) {
+            MS_TRACE_SCOPE("LoudnessEnergy");
+            nMath::KWeighting weighting;
+            weighting.Prepare(static_cast<float>(source.format.sample_rate));
+            const int16_t* samples = reinterpret_cast<const int16_t*>(source.audio_start);
+            const uint32_t channels = source.format.channels;
+            const int64_t first = first_hop * frames_per_hop;
+            const int64_t end = end_hop * frames_per_hop;
+            const int64_t warm_up = nMath::Max(first - static_cast<int64_t>(source.format.sample_rate / 2), (int64_t)0);
+            // Weighting is a frame behind, the energy returned on frame f belongs to frame f - 1.
+            for (int64_t frame = warm_up; frame <= end; ++frame) {
+                float left = 0.f;
+                float right = 0.f;
+                if (frame < end) {
+                    const int16_t* sample = samples + frame * channels;
+                    left = sample[0] / 32768.f;
+                    right = channels > 1 ? sample[1] / 32768.f : 0.f;
+                }
+                const float energy = weighting.Process(left, right);
+                if (frame > first) {
+                    hop_energy[(frame - 1) / frames_per_hop] += energy;
+                }
+            }
+        }
+
+        // Rise of a 2 ms rectified envelope of the mono sum, warmed up before first.
+        void TransientEnvelope(const WaveAudioSource& source, const int64_t first, const int64_t count,
+            std::vector<float>& rise) {
+            constexpr int64_t kWarmUp = 256;
+            const float decay = expf(-1.f / (0.002f * source.format.sample_rate));
+            float envelope = 0.f;
+            for (int64_t sample = nMath::Max(first - kWarmUp, (int64_t)0); sample < first; ++sample) {
+                envelope = decay * envelope + (1.f - decay) * fabsf(MonoSample(source, sample));
+            }
+            rise.resize(static_cast<size_t>(count));
+            for (int64_t i = 0; i < count; ++i) {
+                const float previous = envelope;
+                envelope = decay * envelope + (1.f - decay) * fabsf(MonoSample(source, first + i));
+                rise[i] = nMath::Max(envelope - previous, 0.f);
+            }
+        }
+
+        // Lag into search where reference matches best, normalised by the energy of search under the reference
+        // so loud passages do not win on level alone. Correlation is done in the frequency domain.
+        double BestCorrelationLag(const std::vector<float>& reference, const std::vector<float>& search,
+            const bool interpolate) {
+            assert(search.size() >= reference.size());
+            const size_t num_lags = search.size() - reference.size() + 1;
+            const uint32_t padded = nMath::NextPowerOf2(static_cast<uint32_t>(search.size()));
+            const nMath::FFT fft(nMath::Max(padded / 2, 4u));
+            const uint32_t num_bins = fft.Size() + 1;
+            std::vector<float> buffer(2 * fft.Size(), 0.f);
+            std::vector<float> search_real(num_bins), search_imag(num_bins);
+            std::vector<float> reference_real(num_bins), reference_imag(num_bins);
+            std::copy(search.begin(), search.end(), buffer.begin());
+            fft.RealForward(&buffer[0], &search_real[0], &search_imag[0]);
+            std::fill(buffer.begin(), buffer.end(), 0.f);
+            std::copy(reference.begin(), reference.end(), buffer.begin());
+            fft.RealForward(&buffer[0], &reference_real[0], &reference_imag[0]);
+            // search * conj(reference)
+            for (uint32_t bin = 0; bin < num_bins; ++bin) {
+                const float real = search_real[bin] * reference_real[bin] + search_imag[bin] * reference_imag[bin];
+                const float imag = search_imag[bin] * reference_real[bin] - search_real[bin] * reference_imag[bin];
+                search_real[bin] = real;
+                search_imag[bin] = imag;
+            }
+            fft.RealInverse(&search_real[0], &search_imag[0], &buffer[0]);
+
+            std::vector<double> energy(search.size() + 1, 0.0);
+            for (size_t i = 0; i < search.size(); ++i) {
+                energy[i + 1] = energy[i] + search[i] * search[i];
+            }
+            std::vector<float> scores(num_lags);
+            size_t best_lag = 0;
+            for (size_t lag = 0; lag < num_lags; ++lag) {
+                const double window_energy = energy[lag + reference.size()] - energy[lag];
+                scores[lag] = static_cast<float>(buffer[lag] / sqrt(window_energy + 1e-9));
+                if (scores[lag] > scores[best_lag]) {
+                    best_lag = lag;
+                }
+            }
+            if (!interpolate || best_lag == 0 || best_lag + 1 == num_lags) {
+                return static_cast<double>(best_lag);
+            }
+            const float left = scores[best_lag - 1];
+            const float right = scores[best_lag + 1];
+            const float curvature = left - 2.f * scores[best_lag] + right;
+            return curvature < 0.f ? best_lag + 0.5 * (left - right) / curvature : static_cast<double>(best_lag);
+        }
+
+        // Mean of the envelope on a beat comb with period in frames, starting at phase, taking the peak within radius
+        // frames of each tooth.
+        float CombScore(const std::vector<float>& envelope, const double phase, const double period, const int stride,
+            const int radius) {
+            const int64_t last = static_cast<int64_t>(envelope.size()) - 1;
+            float score = 0.f;
+            int count = 0;
+            for (double pos = phase; pos <= last; pos += period * stride) {
+                const int64_t centre = static_cast<int64_t>(pos + 0.5);
+                float peak = 0.f;
+                for (int64_t i = nMath::Max(centre - radius, (int64_t)0); i <= nMath::Min(centre + radius, last); ++i) {
+                    peak = nMath::Max(peak, envelope[i]);
+                }
+                score += peak;
+                ++count;
+            }
+            return count > 0 ? score / count : 0.f;
+        }
+    }
+
+    void ComputeOnsetEnvelope(const WaveAudioSource& source, OnsetEnvelope& envelope, uint32_t num_threads) {
+        MS_TRACE_SCOPE("ComputeOnsetEnvelope");
+        envelope.hop_size = kOnsetHopSize;
+        envelope.sample_rate = source.format.sample_rate;
+        envelope.values.clear();
+        if (source.Empty() || source.format.channels == 0 || ByteRate(source.format) != 2) {
+            return;
+        }
+        const int64_t num_samples = (source.audio_end - source.audio_start) / (source.format.channels * 2);
+        const int64_t num_frames = num_samples / kOnsetHopSize;
+        if (num_frames <= 0) {
+            return;
+        }
+        envelope.values.resize(static_cast<size_t>(num_frames));
+
+        const nMath::FFT fft(kOnsetFrameSize / 2);
+        std::vector<float> window(kOnsetFrameSize);
+        for (uint32_t i = 0; i < kOnsetFrameSize; ++i) {
+            window[i] = 0.5f - 0.5f * cosf(2.f * (float)M_PI * i / kOnsetFrameSize);
+        }
+
+        if (num_threads == 0) {
+            num_threads = nMath::Max(std::thread::hardware_concurrency(), 1u);
+        }
+        // Keep enough frames per thread that the extra leading frame is noise.
+        constexpr int64_t kMinFramesPerThread = 256;
+        num_threads = static_cast<uint32_t>(nMath::Clamp<int64_t>(num_frames / kMinFramesPerThread, 1, num_threads));
+        const int64_t frames_per_thread = (num_frames + num_threads - 1) / num_threads;
+
+        std::vector<FluxWorker> workers(num_threads, FluxWorker(source, fft, window, num_samples));
+        std::vector<std::thread> threads;
+        threads.reserve(num_threads);
+        float* flux = &envelope.values[0];
+        for (uint32_t thread = 0; thread < num_threads; ++thread) {
+            const int64_t first_frame = thread * frames_per_thread;
+            const int64_t end_frame = nMath::Min(first_frame + frames_per_thread, num_frames);
+            FluxWorker& worker = workers[thread];
+            if (thread + 1 == num_threads) {
+                worker.Run(first_frame, end_frame, flux); // calling thread takes the last chunk
+            }
+            else {
+                threads.emplace_back([&worker, first_frame, end_frame, flux]() {
+                    worker.Run(first_frame, end_frame, flux);
+                });
+            }
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    bool EstimateTempo(const WaveAudioSource& source, const OnsetEnvelope& envelope, TempoAnalysis& analysis) {
+        MS_TRACE_SCOPE("EstimateTempo");
+        const size_t num_frames = envelope.values.size();
+        const float frames_per_second = envelope.FramesPerSecond();
+        const uint32_t max_lag = static_cast<uint32_t>(ceilf(60.f * frames_per_second / kMinBpm)) + 1;
+        if (num_frames < 4 * max_lag) {
+            return false;
+        }
+
+        // Remove the local mean so sustained loud passages do not read as onsets.
+        constexpr size_t kMeanWindow = 16;
+        std::vector<float> onsets(num_frames);
+        float running_sum = 0.f;
+        for (size_t i = 0; i < num_frames; ++i) {
+            running_sum += envelope.values[i];
+            if (i >= kMeanWindow) {
+                running_sum -= envelope.values[i - kMeanWindow];
+            }
+            const float mean = running_sum / nMath::Min(i + 1, kMeanWindow);
+            onsets[i] = nMath::Max(envelope.values[i] - mean, 0.f);
+        }
+
+        // Autocorrelation through the power spectrum, zero padded to avoid wrap around.
+        const uint32_t padded = nMath::NextPowerOf2(static_cast<uint32_t>(2 * num_frames));
+        const nMath::FFT fft(padded / 2);
+        std::vector<float> signal(padded, 0.f);
+        std::copy(onsets.begin(), onsets.end(), signal.begin());
+        std::vector<float> real(padded / 2 + 1);
+        std::vector<float> imag(padded / 2 + 1);
+        fft.RealForward(&signal[0], &real[0], &imag[0]);
+        for (size_t bin = 0; bin < real.size(); ++bin) {
+            real[bin] = real[bin] * real[bin] + imag[bin] * imag[bin];
+            imag[bin] = 0.f;
+        }
+        std::vector<float> autocorrelation(padded);
+        fft.RealInverse(&real[0], &imag[0], &autocorrelation[0]);
+        if (autocorrelation[0] <= 0.f) {
+            return false;
+        }
+
+        // Score lags with their double and half so the comb prefers the bar consistent period, weighted toward
+        // 120 bpm in log tempo to settle octave ambiguity.
+        const uint32_t min_lag = static_cast<uint32_t>(floorf(60.f * frames_per_second / kMaxBpm));
+        uint32_t best_lag = 0;
+        float best_score = 0.f;
+        for (uint32_t lag = nMath::Max(min_lag, 2u); lag <= max_lag; ++lag) {
+            const float bpm = 60.f * frames_per_second / lag;
+            const float octaves = log2f(bpm / 120.f);
+            const float weight = expf(-0.5f * octaves * octaves);
+            const float score = weight * (autocorrelation[lag] + 0.5f * autocorrelation[2 * lag] +
+                0.25f * autocorrelation[lag / 2]);
+            if (score > best_score) {
+                best_score = score;
+                best_lag = lag;
+            }
+        }
+        if (best_lag == 0) {
+            return false;
+        }
+
+        // Refine on peaks at multiples of the period, each doubling the precision, with parabolic interpolation
+        // for a sub frame peak. A beat of error in the period otherwise drifts the grid over a long track.
+        auto peak_near = [&autocorrelation](const double lag, const uint32_t radius) -> double {
+            const uint32_t centre_lag = static_cast<uint32_t>(lag + 0.5);
+            uint32_t peak = centre_lag;
+            for (uint32_t i = centre_lag - radius; i <= centre_lag + radius; ++i) {
+                if (autocorrelation[i] > autocorrelation[peak]) {
+                    peak = i;
+                }
+            }
+            const float left = autocorrelation[peak - 1];
+            const float centre = autocorrelation[peak];
+            const float right = autocorrelation[peak + 1];
+            const float curvature = left - 2.f * centre + right;
+            return curvature < 0.f ? peak + 0.5 * (left - right) / curvature : peak;
+        };
+        double period = peak_near(best_lag, 0);
+        for (uint32_t multiple = 2; (multiple * period + 3) < num_frames / 2; multiple *= 2) {
+            period = peak_near(multiple * period, 2) / multiple;
+        }
+
+        // Beat phase by comb scoring every frame offset within one period, then the downbeat out of four.
+        double best_phase = 0.0;
+        float best_phase_score = -1.f;
+        for (uint32_t phase = 0; phase < static_cast<uint32_t>(ceil(period)); ++phase) {
+            const float score = CombScore(onsets, phase, period, 1, 0);
+            if (score > best_phase_score) {
+                best_phase_score = score;
+                best_phase = phase;
+            }
+        }
+        int best_beat = 0;
+        float best_beat_score = -1.f;
+        for (int beat = 0; beat < WaveAudioSource::kBeatsPerMarker; ++beat) {
+            const float score = CombScore(envelope.values, best_phase + beat * period, period,
+                WaveAudioSource::kBeatsPerMarker, 1);
+            if (score > best_beat_score) {
+                best_beat_score = score;
+                best_beat = beat;
+            }
+        }
+
+        const double bytes_per_frame = static_cast<double>(envelope.hop_size) * source.format.channels *
+            ByteRate(source.format);
+        // Flux at frame i measures the change since frame i - 1, centre the onset between them.
+        const double frame_centre = 0.5 * (kOnsetFrameSize - envelope.hop_size) / envelope.hop_size;
+        analysis.bytes_per_beat = period * bytes_per_frame;
+        analysis.downbeat_offset = (best_phase + best_beat * period + frame_centre) * bytes_per_frame;
+        analysis.bpm = BytesPerBeatToBpm(source.format, analysis.bytes_per_beat);
+        analysis.confidence = nMath::Clamp(autocorrelation[best_lag] / autocorrelation[0], 0.f, 1.f);
+        return true;
+    }
+
+    bool AnalyseTempo(WaveAudioSource& source, TempoAnalysis& analysis) {
+        ComputeOnsetEnvelope(source, source.onset_envelope);
+        return EstimateTempo(source, source.onset_envelope, analysis);
+    }
+
+    void SeedBeatGrid(WaveAudioSource& source, const TempoAnalysis& analysis) {
+        source.bpm = analysis.bpm;
+        source.tempo_map.Reset(analysis.downbeat_offset, analysis.bytes_per_beat);
+        if (source.cue_starts.empty()) {
+            source.MaterialiseImpliedMarkers();
+        }
+    }
+
+    float ComputeLoudness(const WaveAudioSource& source, uint32_t num_threads) {
+        MS_TRACE_SCOPE("ComputeLoudness");
+        if (source.Empty() || source.format.sample_rate == 0) {
+            return nMath::kLoudnessAbsoluteGate;
+        }
+        const uint32_t frames_per_hop = source.format.sample_rate / 10;
+        const int64_t num_samples = (source.audio_end - source.audio_start) / (source.format.channels * 2);
+        const int64_t num_hops = num_samples / frames_per_hop;
+        if (num_hops <= 0) {
+            return nMath::kLoudnessAbsoluteGate;
+        }
+        std::vector<double> hop_energy(static_cast<size_t>(num_hops), 0.0);
+
+        if (num_threads == 0) {
+            num_threads = nMath::Max(std::thread::hardware_concurrency(), 1u);
+        }
+        // Keep enough hops per thread that the warm up is noise.
+        constexpr int64_t kMinHopsPerThread = 64;
+        num_threads = static_cast<uint32_t>(nMath::Clamp<int64_t>(num_hops / kMinHopsPerThread, 1, num_threads));
+        const int64_t hops_per_thread = (num_hops + num_threads - 1) / num_threads;
+
+        std::vector<std::thread> threads;
+        threads.reserve(num_threads);
+        double* energy = &hop_energy[0];
+        for (uint32_t thread = 0; thread < num_threads; ++thread) {
+            const int64_t first_hop = thread * hops_per_thread;
+            const int64_t end_hop = nMath::Min(first_hop + hops_per_thread, num_hops);
+            if (thread + 1 == num_threads) {
+                LoudnessEnergy(source, frames_per_hop, first_hop, end_hop, energy); // calling thread takes the last chunk
+            }
+            else {
+                threads.emplace_back([&source, frames_per_hop, first_hop, end_hop, energy]() {
+                    LoudnessEnergy(source, frames_per_hop, first_hop, end_hop, energy);
+                });
+            }
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        return nMath::GatedLoudness(hop_energy, frames_per_hop);
+    }
+
+    void AnalyseLoudness(WaveAudioSource& source) {
+        source.integrated_lufs = ComputeLoudness(source);
+    }
+
+    void ComputePeakPyramid(const WaveAudioSource& source, PeakPyramid& pyramid) {
+        MS_TRACE_SCOPE("ComputePeakPyramid");
+        pyramid.levels.clear();
+        if (source.Empty() || source.audio_end <= source.audio_start || ByteRate(source.format) != 2) {
+            return;
+        }
+        const int16_t* samples = reinterpret_cast<const int16_t*>(source.audio_start);
+        const uint64_t num_samples = (source.audio_end - source.audio_start) / 2;
+        const uint64_t num_blocks = (num_samples + PeakPyramid::kBlockSamples - 1) / PeakPyramid::kBlockSamples;
+        pyramid.levels.emplace_back(static_cast<size_t>(num_blocks));
+        std::vector<PeakPyramid::Peak>& base = pyramid.levels.back();
+        for (uint64_t block = 0; block < num_blocks; ++block) {
+            const uint64_t end = nMath::Min((block + 1) * PeakPyramid::kBlockSamples, num_samples);
+            PeakPyramid::Peak peak = { samples[block * PeakPyramid::kBlockSamples],
+                samples[block * PeakPyramid::kBlockSamples] };
+            for (uint64_t i = block * PeakPyramid::kBlockSamples; i < end; ++i) {
+                peak.min = nMath::Min(peak.min, samples[i]);
+                peak.max = nMath::Max(peak.max, samples[i]);
+            }
+            base[block] = peak;
+        }
+        while (pyramid.levels.back().size() > 1) {
+            const std::vector<PeakPyramid::Peak>& below = pyramid.levels.back();
+            std::vector<PeakPyramid::Peak> level((below.size() + 1) / 2);
+            for (size_t i = 0; i < level.size(); ++i) {
+                const PeakPyramid::Peak& left = below[2 * i];
+                const PeakPyramid::Peak& right = 2 * i + 1 < below.size() ? below[2 * i + 1] : left;
+                level[i] = { nMath::Min(left.min, right.min), nMath::Max(left.max, right.max) };
+            }
+            pyramid.levels.push_back(std::move(level));
+        }
+    }
+
+    bool PeakRange(const WaveAudioSource& source, const PeakPyramid& pyramid, uint64_t first_sample,
+        uint64_t end_sample, int16_t& min, int16_t& max) {
+        const uint64_t num_samples = (source.audio_end - source.audio_start) / 2;
+        end_sample = nMath::Min(end_sample, num_samples);
+        if (first_sample >= end_sample) {
+            return false;
+        }
+        const int16_t* samples = reinterpret_cast<const int16_t*>(source.audio_start);
+        min = samples[first_sample];
+        max = samples[first_sample];
+        const auto scan = [samples, &min, &max](const uint64_t first, const uint64_t end) {
+            for (uint64_t i = first; i < end; ++i) {
+                min = nMath::Min(min, samples[i]);
+                max = nMath::Max(max, samples[i]);
+            }
+        };
+        // Samples up to the first whole block, then the largest aligned blocks that fit, then the tail.
+        const uint64_t block_samples = PeakPyramid::kBlockSamples;
+        const uint64_t first_block = (first_sample + block_samples - 1) / block_samples;
+        const uint64_t end_block = end_sample / block_samples;
+        if (pyramid.levels.empty() || first_block >= end_block) {
+            scan(first_sample, end_sample);
+            return true;
+        }
+        scan(first_sample, first_block * block_samples);
+        uint64_t block = first_block;
+        while (block < end_block) {
+            size_t level = 0;
+            while (level + 1 < pyramid.levels.size() && block % (2ull << level) == 0 &&
+                block + (2ull << level) <= end_block) {
+                ++level;
+            }
+            const PeakPyramid::Peak& peak = pyramid.levels[level][static_cast<size_t>(block >> level)];
+            min = nMath::Min(min, peak.min);
+            max = nMath::Max(max, peak.max);
+            block += 1ull << level;
+        }
+        scan(end_block * block_samples, end_sample);
+        return true;
+    }
+
+    bool AlignToPlaying(const WaveAudioSource& playing, const WaveAudioSource& incoming, const int64_t incoming_offset,
+        const int64_t playing_estimate, const int64_t search_bytes, int64_t& aligned_offset) {
+        const OnsetEnvelope& playing_onsets = playing.onset_envelope;
+        const OnsetEnvelope& incoming_onsets = incoming.onset_envelope;
+        // Onset hops and sample offsets are compared frame for frame, so both decks need the same rate and layout.
+        if (playing_onsets.values.empty() || incoming_onsets.values.empty() ||
+            playing.format.channels != incoming.format.channels ||
+            playing.format.sample_rate != incoming.format.sample_rate ||
+            playing.format.bit_rate != incoming.format.bit_rate) {
+            return false;
+        }
+        const int64_t frame_bytes = playing.format.channels * ByteRate(playing.format);
+        const int64_t hop_bytes = kOnsetHopSize * frame_bytes;
+        const int64_t hop = kOnsetHopSize;
+
+        // Coarse: about six seconds of incoming onsets from the sync point against the playing search range.
+        constexpr int64_t kWindowFrames = 512;
+        const int64_t incoming_frame = incoming_offset / hop_bytes;
+        const int64_t window = nMath::Min(kWindowFrames, (int64_t)incoming_onsets.values.size() - incoming_frame);
+        const int64_t radius = search_bytes / hop_bytes + 1;
+        const int64_t search_first = nMath::Max(playing_estimate / hop_bytes - radius, (int64_t)0);
+        const int64_t search_end = nMath::Min(playing_estimate / hop_bytes + radius + window,
+            (int64_t)playing_onsets.values.size());
+        if (window < 16 || search_end - search_first < window) {
+            return false;
+        }
+        std::vector<float> reference(incoming_onsets.values.begin() + incoming_frame,
+            incoming_onsets.values.begin() + incoming_frame + window);
+        float mean = 0.f;
+        for (const float value : reference) {
+            mean += value;
+        }
+        mean /= window;
+        for (float& value : reference) {
+            value -= mean;
+        }
+        const std::vector<float> search(playing_onsets.values.begin() + search_first,
+            playing_onsets.values.begin() + search_end);
+        const double coarse_frame = search_first + BestCorrelationLag(reference, search, true);
+        const int64_t incoming_sample = incoming_offset / frame_bytes;
+        const int64_t coarse_sample = static_cast<int64_t>(coarse_frame * hop + 0.5) +
+            (incoming_sample - incoming_frame * hop);
+
+        // Fine: attack envelopes of the audio one hop either side of the coarse match, centred on the strongest onset
+        // of the reference so the window is not spent on a break. Attacks line up between different tracks where
+        // the waveforms would not.
+        constexpr int64_t kRefineSamples = 8192;
+        const int64_t strongest_frame = std::max_element(reference.begin(), reference.end()) - reference.begin();
+        const int64_t refine_shift = nMath::Max(strongest_frame * hop - kRefineSamples / 4, (int64_t)0);
+        const int64_t playing_samples = (playing.audio_end - playing.audio_start) / frame_bytes;
+        const int64_t incoming_samples = (incoming.audio_end - incoming.audio_start) / frame_bytes;
+        const int64_t refine_length = nMath::Min(kRefineSamples, incoming_samples - incoming_sample - refine_shift);
+        const int64_t refine_centre = coarse_sample + refine_shift;
+        const int64_t refine_first = nMath::Max(refine_centre - hop, (int64_t)0);
+        const int64_t refine_end = nMath::Min(refine_centre + hop + refine_length, playing_samples);
+        if (refine_length < hop || refine_end - refine_first < refine_length) {
+            aligned_offset = nMath::Clamp(coarse_sample, (int64_t)0, playing_samples - 1) * frame_bytes;
+            return true;
+        }
+        std::vector<float> refine_reference;
+        TransientEnvelope(incoming, incoming_sample + refine_shift, refine_length, refine_reference);
+        std::vector<float> refine_search;
+        TransientEnvelope(playing, refine_first, refine_end - refine_first, refine_search);
+        const int64_t fine_sample = refine_first - refine_shift +
+            static_cast<int64_t>(BestCorrelationLag(refine_reference, refine_search, false));
+        aligned_offset = nMath::Max(fine_sample, (int64_t)0) * frame_bytes;
+        return true;
+    }
+}
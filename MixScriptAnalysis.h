@@ -0,0 +1,67 @@
+// MixScriptAnalysis - onset, tempo and loudness analysis of loaded tracks
+// Author - Nic Taylor
+
+#pragma once
+#include <vector>
+#include <stdint.h>
+
+namespace MixScript
+{
+    struct WaveAudioSource;
+
+    constexpr uint32_t kOnsetFrameSize = 1024;
+    constexpr uint32_t kOnsetHopSize = 512;
+
+    // Spectral flux per hop, frame i covers samples starting at i * hop_size.
+    struct OnsetEnvelope {
+        uint32_t hop_size;
+        uint32_t sample_rate;
+        std::vector<float> values;
+
+        float FramesPerSecond() const { return sample_rate / (float)hop_size; }
+    };
+
+    // Min and max of the interleaved samples over blocks of kBlockSamples, each level above halves the level below.
+    // Lets the waveform view find the peak of any range in a handful of reads when zoomed out.
+    struct PeakPyramid {
+        static constexpr uint32_t kBlockSamples = 256;
+        struct Peak {
+            int16_t min;
+            int16_t max;
+        };
+        std::vector<std::vector<Peak>> levels;
+    };
+
+    struct TempoAnalysis {
+        float bpm;
+        double bytes_per_beat;
+        double downbeat_offset; // bytes from audio_start of the first downbeat
+        float confidence; // 0 to 1, autocorrelation peak over energy
+    };
+
+    // Log magnitude spectral flux of the mono sum. Frames are split across num_threads, 0 uses every core.
+    void ComputeOnsetEnvelope(const WaveAudioSource& source, OnsetEnvelope& envelope, uint32_t num_threads = 0);
+    // Autocorrelation tempo between kMinBpm and kMaxBpm, then beat phase and downbeat by comb scoring.
+    bool EstimateTempo(const WaveAudioSource& source, const OnsetEnvelope& envelope, TempoAnalysis& analysis);
+    // Keeps the onset envelope on the source for alignment.
+    bool AnalyseTempo(WaveAudioSource& source, TempoAnalysis& analysis);
+    // Sets bpm and the tempo map. Bars are only materialised when the track has no markers of its own.
+    void SeedBeatGrid(WaveAudioSource& source, const TempoAnalysis& analysis);
+
+    // Integrated loudness in LUFS of the whole source, K-weighted and gated per BS.1770. Hops are split across
+    // num_threads, 0 uses every core.
+    float ComputeLoudness(const WaveAudioSource& source, uint32_t num_threads = 0);
+    // Keeps integrated loudness on the source for loudness matching.
+    void AnalyseLoudness(WaveAudioSource& source);
+
+    void ComputePeakPyramid(const WaveAudioSource& source, PeakPyramid& pyramid);
+    // Peak of samples [first_sample, end_sample) past audio_start, clamped to the source. False when empty.
+    bool PeakRange(const WaveAudioSource& source, const PeakPyramid& pyramid, uint64_t first_sample,
+        uint64_t end_sample, int16_t& min, int16_t& max);
+
+    // Bytes from playing audio_start that line up with incoming_offset of incoming. Cross-correlates the onset
+    // envelopes search_bytes either side of playing_estimate, then refines to the sample on the audio itself.
+    // False when the decks differ in sample rate, channels or bit rate.
+    bool AlignToPlaying(const WaveAudioSource& playing, const WaveAudioSource& incoming, const int64_t incoming_offset,
+        const int64_t playing_estimate, const int64_t search_bytes, int64_t& aligned_offset);
+}
@@ -0,0 +1,222 @@
+// MixScriptCache - content addressed sidecar cache of the load analysis
+// Author - Nic Taylor
+
+#include "MixScriptCache.h"
+#include "MixScriptProject.h"
+#include "MixScriptTrace.h"
+#include "WavAudioSource.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace MixScript
+{
+    namespace {
+        constexpr char kCacheMagic[4] = { 'M', 'S', 'A', 'C' };
+        // Bump when an analysis changes its output for the same audio, every older cache then reads as stale.
+        constexpr uint32_t kCacheVersion = 1;
+
+        enum CacheSectionTag : uint32_t {
+            CST_KEY = 1,  // CacheKey
+            CST_RESULTS,  // CacheResults
+            CST_ONSETS,   // float, the onset envelope
+            CST_PEAKS,    // PeakPyramid::Peak, per level
+        };
+
+        // What the cached values were computed from. Any field that differs makes the cache stale.
+        struct CacheKey {
+            uint64_t content_hash;
+            uint64_t audio_bytes;
+            uint32_t channels;
+            uint32_t sample_rate;
+            uint32_t bit_rate;
+            uint32_t onset_frame_size;
+            uint32_t onset_hop_size;
+            uint32_t peak_block_samples;
+        };
+
+        struct CacheResults {
+            double bytes_per_beat;
+            double downbeat_offset;
+            float bpm;
+            float confidence;
+            float integrated_lufs;
+            uint8_t tempo_found;
+            uint8_t reserved[3];
+        };
+
+        static_assert(sizeof(CacheKey) == 40 && sizeof(CacheResults) == 32 && sizeof(PeakPyramid::Peak) == 4,
+            "Cache records are part of the file format");
+
+        CacheKey MakeKey(const WaveAudioSource& source, const uint64_t content_hash) {
+            return CacheKey{ content_hash, static_cast<uint64_t>(source.audio_end - source.audio_start),
+                source.format.channels, source.format.sample_rate, source.format.bit_rate, kOnsetFrameSize,
+                kOnsetHopSize, PeakPyramid::kBlockSamples };
+        }
+
+        constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+        constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+        constexpr uint64_t kPrime3 = 0x165667B19E3779F9ull;
+        constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+        constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+        inline uint64_t RotateLeft(const uint64_t x, const int bits) {
+            return (x << bits) | (x >> (64 - bits));
+        }
+        inline uint64_t Read64(const uint8_t* p) {
+            uint64_t value;
+            memcpy(&value, p, sizeof(value));
+            return value;
+        }
+        inline uint32_t Read32(const uint8_t* p) {
+            uint32_t value;
+            memcpy(&value, p, sizeof(value));
+            return value;
+        }
+        inline uint64_t HashRound(uint64_t acc, const uint64_t input) {
+            acc += input * kPrime2;
+            return RotateLeft(acc, 31) * kPrime1;
+        }
+        inline uint64_t HashMerge(uint64_t acc, const uint64_t value) {
+            acc ^= HashRound(0, value);
+            return acc * kPrime1 + kPrime4;
+        }
+    }
+
+    uint64_t XXHash64(const void* data, const size_t num_bytes, const uint64_t seed) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        const uint8_t* const end = p + num_bytes;
+        uint64_t hash;
+        if (num_bytes >= 32) {
+            // Four independent lanes keep the multiplies pipelined.
+            uint64_t v1 = seed + kPrime1 + kPrime2;
+            uint64_t v2 = seed + kPrime2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - kPrime1;
+            const uint8_t* const limit = end - 32;
+            do {
+                v1 = HashRound(v1, Read64(p));
+                v2 = HashRound(v2, Read64(p + 8));
+                v3 = HashRound(v3, Read64(p + 16));
+                v4 = HashRound(v4, Read64(p + 24));
+                p += 32;
+            } while (p <= limit);
+            hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+            hash = HashMerge(hash, v1);
+            hash = HashMerge(hash, v2);
+            hash = HashMerge(hash, v3);
+            hash = HashMerge(hash, v4);
+        }
+        else {
+            hash = seed + kPrime5;
+        }
+        hash += static_cast<uint64_t>(num_bytes);
+
+        for (; p + 8 <= end; p += 8) {
+            hash ^= HashRound(0, Read64(p));
+            hash = RotateLeft(hash, 27) * kPrime1 + kPrime4;
+        }
+        if (p + 4 <= end) {
+            hash ^= static_cast<uint64_t>(Read32(p)) * kPrime1;
+            hash = RotateLeft(hash, 23) * kPrime2 + kPrime3;
+            p += 4;
+        }
+        for (; p < end; ++p) {
+            hash ^= *p * kPrime5;
+            hash = RotateLeft(hash, 11) * kPrime1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= kPrime2;
+        hash ^= hash >> 29;
+        hash *= kPrime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    uint64_t AudioContentHash(const WaveAudioSource& source) {
+        MS_TRACE_SCOPE("AudioContentHash");
+        const uint32_t format[3] = { source.format.channels, source.format.sample_rate, source.format.bit_rate };
+        return XXHash64(source.audio_start, source.audio_end - source.audio_start, XXHash64(format, sizeof(format)));
+    }
+
+    std::string AnalysisCachePath(const WaveAudioSource& source, const std::string& cache_directory,
+        const uint64_t content_hash) {
+        if (cache_directory.empty()) {
+            return source.file_name.empty() ? std::string() : source.file_name + ".msa";
+        }
+        char name[24];
+        snprintf(name, sizeof(name), "%016llx.msa", static_cast<unsigned long long>(content_hash));
+        const char last = cache_directory.back();
+        return last == '/' || last == '\\' ? cache_directory + name : cache_directory + "/" + name;
+    }
+
+    bool LoadAnalysisCache(const char* file_path, const uint64_t content_hash, WaveAudioSource& source,
+        CachedAnalysis& analysis) {
+        MS_TRACE_SCOPE("LoadAnalysisCache");
+        ProjectReader reader;
+        if (!reader.Open(file_path, kCacheMagic, kCacheVersion)) {
+            return false;
+        }
+        const ProjectRecords<CacheKey> keys = reader.Records<CacheKey>(CST_KEY);
+        const ProjectRecords<CacheResults> results = reader.Records<CacheResults>(CST_RESULTS);
+        const CacheKey expected = MakeKey(source, content_hash);
+        if (keys.count != 1 || results.count != 1 || memcmp(&keys[0], &expected, sizeof(CacheKey)) != 0) {
+            return false;
+        }
+
+        // Level sizes follow from the audio length, a pyramid that disagrees would index past its levels.
+        PeakPyramid pyramid;
+        const uint64_t num_samples = expected.audio_bytes / 2;
+        uint64_t level_size = (num_samples + PeakPyramid::kBlockSamples - 1) / PeakPyramid::kBlockSamples;
+        for (int32_t level = 0; level_size > 0; ++level) {
+            const ProjectRecords<PeakPyramid::Peak> peaks = reader.Records<PeakPyramid::Peak>(CST_PEAKS, level);
+            if (peaks.count != level_size) {
+                return false;
+            }
+            pyramid.levels.emplace_back(static_cast<size_t>(level_size));
+            for (uint64_t i = 0; i < level_size; ++i) {
+                pyramid.levels.back()[static_cast<size_t>(i)] = peaks[i];
+            }
+            level_size = level_size > 1 ? (level_size + 1) / 2 : 0;
+        }
+
+        const ProjectRecords<float> onsets = reader.Records<float>(CST_ONSETS);
+        source.onset_envelope.hop_size = kOnsetHopSize;
+        source.onset_envelope.sample_rate = source.format.sample_rate;
+        source.onset_envelope.values.resize(static_cast<size_t>(onsets.count));
+        for (uint64_t i = 0; i < onsets.count; ++i) {
+            source.onset_envelope.values[static_cast<size_t>(i)] = onsets[i];
+        }
+        source.peak_pyramid = std::move(pyramid);
+
+        const CacheResults& cached = results[0];
+        analysis.tempo.bpm = cached.bpm;
+        analysis.tempo.bytes_per_beat = cached.bytes_per_beat;
+        analysis.tempo.downbeat_offset = cached.downbeat_offset;
+        analysis.tempo.confidence = cached.confidence;
+        analysis.tempo_found = cached.tempo_found != 0;
+        analysis.integrated_lufs = cached.integrated_lufs;
+        return true;
+    }
+
+    bool SaveAnalysisCache(const char* file_path, const uint64_t content_hash, const WaveAudioSource& source,
+        const CachedAnalysis& analysis) {
+        MS_TRACE_SCOPE("SaveAnalysisCache");
+        ProjectWriter writer;
+        writer.Add(CST_KEY, -1, std::vector<CacheKey>{ MakeKey(source, content_hash) });
+        CacheResults results = {};
+        results.bytes_per_beat = analysis.tempo.bytes_per_beat;
+        results.downbeat_offset = analysis.tempo.downbeat_offset;
+        results.bpm = analysis.tempo.bpm;
+        results.confidence = analysis.tempo.confidence;
+        results.integrated_lufs = analysis.integrated_lufs;
+        results.tempo_found = analysis.tempo_found ? 1 : 0;
+        writer.Add(CST_RESULTS, -1, std::vector<CacheResults>{ results });
+        writer.Add(CST_ONSETS, -1, source.onset_envelope.values);
+        for (size_t level = 0; level < source.peak_pyramid.levels.size(); ++level) {
+            writer.Add(CST_PEAKS, static_cast<int32_t>(level), source.peak_pyramid.levels[level]);
+        }
+        return writer.Write(file_path, kCacheMagic, kCacheVersion);
+    }
+}
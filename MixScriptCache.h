@@ -0,0 +1,38 @@
+// MixScriptCache - content addressed sidecar cache of the load analysis
+// Author - Nic Taylor
+
+#pragma once
+#include "MixScriptAnalysis.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace MixScript
+{
+    struct WaveAudioSource;
+
+    // XXH64 of the bytes, the same value as the reference implementation.
+    uint64_t XXHash64(const void* data, const size_t num_bytes, const uint64_t seed = 0);
+    // Hash of the decoded samples and their format, independent of the file name and of chunks other than data.
+    uint64_t AudioContentHash(const WaveAudioSource& source);
+
+    // <file>.msa next to the wav when cache_directory is empty, <cache_directory>/<hash>.msa otherwise, so a
+    // shared directory finds a track again after it is moved or renamed. Empty when neither is known.
+    std::string AnalysisCachePath(const WaveAudioSource& source, const std::string& cache_directory,
+        const uint64_t content_hash);
+
+    // Everything derived from the audio at load. The onset envelope and peak pyramid are filled on the source.
+    struct CachedAnalysis {
+        TempoAnalysis tempo;
+        bool tempo_found;
+        float integrated_lufs;
+    };
+
+    // Fills the source and analysis from the cache file. Returns false when the file is missing, not a cache, from
+    // another version or stale, which is a key that does not match the audio or analysis parameters.
+    bool LoadAnalysisCache(const char* file_path, const uint64_t content_hash, WaveAudioSource& source,
+        CachedAnalysis& analysis);
+    bool SaveAnalysisCache(const char* file_path, const uint64_t content_hash, const WaveAudioSource& source,
+        const CachedAnalysis& analysis);
+}
@@ -2,16 +2,27 @@
 // Author - Nic Taylor
 
 #include "MixScriptMixer.h"
+#include "MixScriptAnalysis.h"
+#include "MixScriptCache.h"
+#include "MixScriptProject.h"
+#include "MixScriptRealtime.h"
+#include "MixScriptTrace.h"
 #include "WavAudioBuffer.h"
 #include "nMath.h"
+#ifdef _WIN32
 #undef UNICODE // using single byte file loading routines
 #include <windows.h>
+#else
+#include <stdio.h>
+#endif
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <algorithm>
 #include <stdint.h>
 #include <memory>
 #include <assert.h>
+#include <float.h>
+#include <string.h>
 
 #include <iostream>
 #include <fstream>
@@ -32,32 +43,332 @@ namespace MixScript
         return expf(db * ln10_20);
     }
 
+    // Sets the initial track gain so the integrated loudness of the source lands on target_lufs.
+    static void MatchLoudness(WaveAudioSource& source, const float target_lufs) {
+        if (source.Empty() || source.gain_control.movements.empty() ||
+            source.integrated_lufs <= nMath::kLoudnessAbsoluteGate) {
+            return;
+        }
+        const float db = nMath::Clamp(target_lufs - source.integrated_lufs, -24.f, 12.f);
+        source.gain_control.movements.front().control.gain = DbToGain(db);
+    }
+
+    constexpr std::array<SourceAction, Mixer::kNumRecordableActions> kRecordableActions = { MixScript::SA_MULTIPLY_FADER_GAIN,
+        MixScript::SA_MULTIPLY_TRACK_GAIN, MixScript::SA_MULTIPLY_LP_SHELF_GAIN, MixScript::SA_MULTIPLY_HP_SHELF_GAIN,
+        MixScript::SA_MULTIPLY_LOW_GAIN, MixScript::SA_MULTIPLY_MID_GAIN, MixScript::SA_MULTIPLY_HIGH_GAIN,
+        MixScript::SA_SWEEP_FILTER, MixScript::SA_MULTIPLY_CONVOLUTION_SEND, MixScript::SA_MULTIPLY_DELAY_SEND,
+        MixScript::SA_DELAY_FEEDBACK };
+
+    // Swaps in storage when it is larger. Copying within its capacity does not allocate, the old buffer is left in
+    // storage.
+    static void AdoptShelfCache(std::vector<nMath::ShelfFilterParams>& cache,
+        std::vector<nMath::ShelfFilterParams>& storage) {
+        if (storage.capacity() > cache.capacity()) {
+            storage.assign(cache.begin(), cache.end());
+            cache.swap(storage);
+        }
+    }
+
+    // Tempo at the last read, from the tempo map when there is one.
+    static float LocalBpm(const WaveAudioSource& source) {
+        return source.tempo_map.Empty() ? source.bpm :
+            source.tempo_map.Bpm(source.format, static_cast<double>(source.last_read_pos.load()));
+    }
+
+    // Channels of a 16 bit source as float at sample_rate, windowed sinc when the rates differ.
+    static void ResampledChannels(const WaveAudioSource& source, const float sample_rate, const uint32_t max_frames,
+        std::vector<float>& left, std::vector<float>& right) {
+        const int16_t* samples = reinterpret_cast<const int16_t*>(source.audio_start);
+        const uint32_t channels = source.format.channels;
+        const int64_t num_frames = (source.audio_end - source.audio_start) / (channels * ByteRate(source.format));
+        const double ratio = source.format.sample_rate / static_cast<double>(sample_rate);
+        const uint32_t num_output = static_cast<uint32_t>(nMath::Min(static_cast<double>(max_frames), num_frames / ratio));
+        left.resize(num_output);
+        right.resize(channels > 1 ? num_output : 0);
+        typedef nMath::SincResampler Resampler;
+        const Resampler resampler(0.95f / static_cast<float>(nMath::Max(ratio, 1.0)));
+        float coefficients[Resampler::kTaps];
+        float left_taps[Resampler::kTaps];
+        float right_taps[Resampler::kTaps];
+        for (uint32_t i = 0; i < num_output; ++i) {
+            const double position = i * ratio;
+            const int64_t frame = static_cast<int64_t>(position);
+            if (ratio == 1.0) {
+                left[i] = samples[frame * channels] / 32768.f;
+                if (channels > 1) {
+                    right[i] = samples[frame * channels + 1] / 32768.f;
+                }
+                continue;
+            }
+            resampler.Coefficients(static_cast<float>(position - frame), coefficients);
+            for (int32_t tap = 0; tap < Resampler::kTaps; ++tap) {
+                const int64_t tap_frame = frame - Resampler::kLeadFrames + tap;
+                const bool inside = tap_frame >= 0 && tap_frame < num_frames;
+                left_taps[tap] = inside ? samples[tap_frame * channels] / 32768.f : 0.f;
+                right_taps[tap] = inside && channels > 1 ? samples[tap_frame * channels + 1] / 32768.f : 0.f;
+            }
+            left[i] = Resampler::Apply(left_taps, coefficients);
+            if (channels > 1) {
+                right[i] = Resampler::Apply(right_taps, coefficients);
+            }
+        }
+    }
+
     Mixer::Mixer() : playing(nullptr), incoming(nullptr), selected_track(0), update_param_on_selected_marker(false),
+        live_record(false), mix_sample_rate(0), device_sample_rate(0.0), output_block_size(0),
         selected_action(MixScript::SA_MULTIPLY_FADER_GAIN) {
         modifier_mono = false;
+        realtime_hardening = false;
+        realtime_priority_requested = false;
+        audio_thread_realtime = false;
+        output_quality = nMath::RQ_SINC;
+        limiter_bypass = false;
+        last_capture_pos.fill(-1);
+        recording_room_requested = false;
+        holding_point = false;
     }
 
     void Mixer::LoadPlaceholders() {
         playing = std::unique_ptr<MixScript::WaveAudioSource>(new MixScript::WaveAudioSource());
         incoming = std::unique_ptr<MixScript::WaveAudioSource>(new MixScript::WaveAudioSource());
+        UpdateMixSampleRate();
     }
 
     void Mixer::LoadPlayingFromFile(const char* file_path) {
-        playing = std::unique_ptr<MixScript::WaveAudioSource>(std::move(MixScript::LoadWaveFile(file_path)));
+        MS_TRACE_SCOPE("Mixer::LoadPlayingFromFile");
+        LoadPlaying(MixScript::LoadWaveFile(file_path));
+    }
+
+    void Mixer::LoadIncomingFromFile(const char* file_path) {
+        MS_TRACE_SCOPE("Mixer::LoadIncomingFromFile");
+        LoadIncoming(MixScript::LoadWaveFile(file_path));
+    }
+
+    void Mixer::LoadPlaying(std::unique_ptr<WaveAudioSource> source) {
+        const MemoryRanges released = LockedMemory();
+        ReserveRecording(*source);
+        playing = std::move(source);
         playing->fader_control.Add(GainControl{ 1.f }, playing->audio_start);
         playing->gain_control.Add(GainControl{ 1.f }, playing->audio_start);
+        AnalyseDeck(*playing);
         if (incoming != nullptr) {
             MixScript::ResetToCue(incoming, 0);
         }
+        UpdateMixSampleRate();
+        HardenMemory(released);
     }
 
-    void Mixer::LoadIncomingFromFile(const char* file_path) {
-        incoming = std::unique_ptr<MixScript::WaveAudioSource>(std::move(MixScript::LoadWaveFile(file_path)));
+    void Mixer::LoadIncoming(std::unique_ptr<WaveAudioSource> source) {
+        const MemoryRanges released = LockedMemory();
+        ReserveRecording(*source);
+        incoming = std::move(source);
         incoming->fader_control.Add(GainControl{ 0.f }, incoming->audio_start);
-        incoming->gain_control.Add(GainControl{ 1.f }, playing->audio_start);
+        incoming->gain_control.Add(GainControl{ 1.f }, incoming->audio_start);
+        AnalyseDeck(*incoming);
         if (playing != nullptr) {
             MixScript::ResetToCue(playing, 0);
         }
+        UpdateMixSampleRate();
+        HardenMemory(released);
+    }
+
+    void Mixer::AnalyseDeck(WaveAudioSource& source) {
+        MS_TRACE_SCOPE("Mixer::AnalyseDeck");
+        CachedAnalysis analysis = {};
+        const bool cacheable = !source.Empty() && ByteRate(source.format) == 2;
+        const uint64_t content_hash = cacheable ? AudioContentHash(source) : 0;
+        const std::string cache_path = cacheable ? AnalysisCachePath(source, analysis_cache_directory, content_hash) :
+            std::string();
+        if (cache_path.empty() || !LoadAnalysisCache(cache_path.c_str(), content_hash, source, analysis)) {
+            analysis.tempo_found = AnalyseTempo(source, analysis.tempo);
+            AnalyseLoudness(source);
+            analysis.integrated_lufs = source.integrated_lufs;
+            ComputePeakPyramid(source, source.peak_pyramid);
+            // A cache that cannot be written, a read only music folder say, only costs the next load its time.
+            if (!cache_path.empty()) {
+                SaveAnalysisCache(cache_path.c_str(), content_hash, source, analysis);
+            }
+        }
+        source.integrated_lufs = analysis.integrated_lufs;
+        if (analysis.tempo_found) {
+            SeedBeatGrid(source, analysis.tempo);
+        }
+    }
+
+    void Mixer::UpdateMixSampleRate() {
+        const WaveAudioSource* lead = playing != nullptr && !playing->Empty() ? playing.get() : incoming.get();
+        const uint32_t last_mix_sample_rate = mix_sample_rate;
+        mix_sample_rate = lead != nullptr && !lead->Empty() ? lead->format.sample_rate : 0;
+        if (mix_sample_rate != 0) {
+            limiter.Prepare(static_cast<float>(mix_sample_rate));
+        }
+        // A deck keeps its convolver unless the rate moved, only a new deck has none yet.
+        for (WaveAudioSource* source : { playing.get(), incoming.get() }) {
+            if (source == nullptr) {
+                continue;
+            }
+            source->SetMixSampleRate(mix_sample_rate);
+            if (mix_sample_rate != last_mix_sample_rate || !source->convolution.HasPublished()) {
+                PrepareConvolution(*source);
+            }
+        }
+        PrepareOutputStage();
+    }
+
+    bool Mixer::LoadImpulseResponse(const char* file_path) {
+        MS_TRACE_SCOPE("Mixer::LoadImpulseResponse");
+        std::unique_ptr<WaveAudioSource> loaded = LoadWaveFile(file_path);
+        if (loaded->Empty() || loaded->format.bit_rate != 16 || loaded->audio_end <= loaded->audio_start) {
+            return false;
+        }
+        const MemoryRanges released = LockedMemory();
+        impulse_response = std::move(loaded);
+        PrepareConvolution(*playing);
+        PrepareConvolution(*incoming);
+        HardenMemory(released);
+        return true;
+    }
+
+    void Mixer::PrepareConvolution(WaveAudioSource& source) {
+        if (impulse_response == nullptr || source.Empty()) {
+            return;
+        }
+        MS_TRACE_SCOPE("Mixer::PrepareConvolution");
+        const uint32_t mix_rate = mix_sample_rate;
+        const float sample_rate = static_cast<float>(mix_rate != 0 ? mix_rate : impulse_response->format.sample_rate);
+        std::vector<float> left;
+        std::vector<float> right;
+        ResampledChannels(*impulse_response, sample_rate,
+            static_cast<uint32_t>(kMaxImpulseResponseSeconds * sample_rate), left, right);
+        // Unit energy in the louder channel so a full send lands near the level of the dry signal.
+        double energy = 0.0;
+        for (const std::vector<float>* channel : { &left, &right }) {
+            double sum = 0.0;
+            for (const float value : *channel) {
+                sum += value * value;
+            }
+            energy = nMath::Max(energy, sum);
+        }
+        if (energy > 0.0) {
+            const float scale = static_cast<float>(1.0 / sqrt(energy));
+            for (float& value : left) {
+                value *= scale;
+            }
+            for (float& value : right) {
+                value *= scale;
+            }
+        }
+        source.convolution.Publish(std::unique_ptr<nMath::Convolver>(new nMath::Convolver(left, right, sample_rate)));
+    }
+
+    void Mixer::PrepareOutput(const double device_sample_rate_, const int32_t max_block_size) {
+        device_sample_rate = device_sample_rate_;
+        output_block_size = nMath::Max(max_block_size, 1);
+        callback_stats.Prepare(device_sample_rate);
+        const MemoryRanges released = LockedMemory();
+        PrepareOutputStage();
+        HardenMemory(released);
+    }
+
+    void Mixer::PrepareOutputStage() {
+        if (device_sample_rate <= 0.0 || mix_sample_rate == 0) {
+            return;
+        }
+        const nMath::StreamResampler* published = output_stage.Published();
+        if (published != nullptr && published->InputRate() == mix_sample_rate &&
+            published->OutputRate() == device_sample_rate && published->MaxOutputFrames() == output_block_size) {
+            return;
+        }
+        MS_TRACE_SCOPE("Mixer::PrepareOutputStage");
+        std::unique_ptr<nMath::StreamResampler> stage(new nMath::StreamResampler());
+        stage->Prepare(mix_sample_rate, device_sample_rate, output_block_size);
+        output_stage.Publish(std::move(stage));
+    }
+
+    void Mixer::MixOutput(FloatOutputWriter& output_writer, int samples_to_write) {
+        // The stage published with the last load or device change, matching the rate the decks now mix at.
+        nMath::StreamResampler* const resampler = output_stage.Acquire();
+        if (resampler == nullptr || resampler->Bypassed()) {
+            Mix(output_writer, samples_to_write);
+            return;
+        }
+        // Devices may deliver more than the expected block, split so each block stays within the budget.
+        const nMath::ResampleQuality quality = output_quality.load();
+        while (samples_to_write > 0) {
+            const int32_t block = nMath::Min(samples_to_write, resampler->MaxOutputFrames());
+            const int32_t input_frames = resampler->Reserve(block);
+            FloatOutputWriter input_writer = { resampler->PendingLeft(), resampler->PendingRight() };
+            Mix(input_writer, input_frames);
+            resampler->Process(output_writer.left, output_writer.right, block, quality);
+            output_writer.left += block;
+            output_writer.right += block;
+            samples_to_write -= block;
+        }
+    }
+
+    void Mixer::AudioCallback(FloatOutputWriter& output_writer, const int32_t num_frames, const int32_t reset_cue_id,
+        const bool paused) {
+        if (realtime_priority_requested.load(std::memory_order_relaxed) &&
+            realtime_priority_requested.exchange(false)) {
+            audio_thread_realtime = SetRealtimePriority();
+        }
+        callback_stats.BeginCallback(num_frames);
+        ProcessActions();
+        callback_stats.EndActions();
+
+        if (reset_cue_id != 0) {
+            ResetToCue(static_cast<uint32_t>(reset_cue_id > 0 ? reset_cue_id : 0));
+        }
+
+        if (!paused) {
+            MixOutput(output_writer, num_frames);
+        }
+        callback_stats.EndCallback();
+    }
+
+    bool Mixer::SetRealtimeHardening(const bool enable) {
+        realtime_hardening = enable;
+        callback_stats.SetCountPageFaults(enable);
+        if (enable) {
+            realtime_priority_requested = true;
+            return HardenMemory(MemoryRanges());
+        }
+        MemoryRanges locked;
+        WorkingMemory(locked);
+        UnlockMemory(locked);
+        return true;
+    }
+
+    void Mixer::WorkingMemory(MemoryRanges& ranges) const {
+        ranges.Add(this, sizeof(Mixer));
+        actions.WorkingMemory(ranges);
+        output_stage.WorkingMemory(ranges);
+        recording_room.WorkingMemory(ranges);
+        limiter.WorkingMemory(ranges);
+        for (const WaveAudioSource* source : { playing.get(), incoming.get(), impulse_response.get() }) {
+            if (source != nullptr) {
+                source->WorkingMemory(ranges);
+            }
+        }
+    }
+
+    MemoryRanges Mixer::LockedMemory() const {
+        MemoryRanges ranges;
+        if (realtime_hardening.load()) {
+            WorkingMemory(ranges);
+        }
+        return ranges;
+    }
+
+    bool Mixer::HardenMemory(const MemoryRanges& released) {
+        if (!realtime_hardening.load()) {
+            return true;
+        }
+        // Unlocked first, a freed block may since have been handed to one of the ranges locked below.
+        UnlockMemory(released);
+        MemoryRanges ranges;
+        WorkingMemory(ranges);
+        return PrefaultAndLock(ranges);
     }
 
     float Mixer::FaderGainValue(float& interpolation_percent) const {
@@ -65,11 +376,8 @@ namespace MixScript
         interpolation_percent = 0.0f;
         uint8_t const * const cue_pos = source.SelectedMarkerPos();
         const float gain = source.fader_control.ValueAt(cue_pos);
-        const auto& movements = source.fader_control.movements;
-        auto it = std::find_if(movements.begin(), movements.end(),
-            [&](const Movement& a) { return a.cue_pos == cue_pos; });
-        if (it != movements.end()) {
-            interpolation_percent = (*it).threshold_percent;
+        if (const Movement* movement = source.fader_control.movements.Find(cue_pos)) {
+            interpolation_percent = movement->threshold_percent;
         }
 
         return gain;
@@ -95,6 +403,11 @@ namespace MixScript
     }
     
     void Mixer::HandleAction(const SourceActionInfo& action_info) {
+        GrowRecordingRoom();
+        // The recorder's worker is started here, on the control thread, rather than when the action is processed.
+        if (action_info.action == SA_SET_LIVE_RECORD && action_info.i_value != 0) {
+            recorder.Start();
+        }
         actions.WriteAction(action_info);
     }
 
@@ -104,6 +417,206 @@ namespace MixScript
         while (actions.ReadAction(action_info)) {
             DoAction(action_info);
         }
+        if (live_record) {
+            CaptureLiveControls();
+        }
+        ApplyRecordedMovements();
+    }
+
+    void Mixer::WriteMovement(WaveAudioSource& target, const GainControl& control, MixerControl& mixer_control,
+        const float interpolation_percent, const int precompute_index) {
+        if (live_record) {
+            if (!mixer_control.live) {
+                mixer_control.live = true;
+                last_capture_pos[&target == incoming.get() ? 1 : 0] = -1;
+            }
+            mixer_control.live_movement = Movement{ control, MFT_LINEAR, 0.f, 0,
+                target.audio_start + target.last_read_pos, precompute_index };
+            return;
+        }
+        UpdateMovement(target, control, mixer_control, interpolation_percent, update_param_on_selected_marker,
+            precompute_index);
+    }
+
+    int Mixer::AddShelfPrecompute(WaveAudioSource& target, const SourceAction action, const float db) {
+        // TODO: Replace index with uid
+        if (action == MixScript::SA_MULTIPLY_LP_SHELF_GAIN) {
+            target.lp_shelf_precomute.cache.emplace_back(target.ShelfConfig(action, db));
+            return static_cast<int>(target.lp_shelf_precomute.cache.size()) - 1;
+        }
+        target.hp_shelf_precomute.cache.emplace_back(target.ShelfConfig(action, db));
+        return static_cast<int>(target.hp_shelf_precomute.cache.size()) - 1;
+    }
+
+    int Mixer::ShelfPrecomputeIndex(WaveAudioSource& target, const SourceAction action, const float db) {
+        if (!live_record) {
+            return AddShelfPrecompute(target, action, db);
+        }
+        MovementPrecomputeCacheShelf& precompute = action == MixScript::SA_MULTIPLY_LP_SHELF_GAIN ?
+            target.lp_shelf_precomute : target.hp_shelf_precomute;
+        precompute.live = target.ShelfConfig(action, db);
+        return MovementPrecomputeCacheShelf::kLiveIndex;
+    }
+
+    void Mixer::RebuildShelfPrecompute(WaveAudioSource& target) {
+        for (const SourceAction action : { MixScript::SA_MULTIPLY_LP_SHELF_GAIN, MixScript::SA_MULTIPLY_HP_SHELF_GAIN }) {
+            for (Movement& movement : target.GetControl(action).movements) {
+                if (movement.precompute_index < 0) {
+                    const float gain = movement.control.Value();
+                    movement.precompute_index = AddShelfPrecompute(target, action, gain > 0.f ? GainToDb(gain) : -96.f);
+                }
+            }
+        }
+    }
+
+    void Mixer::ReserveRecording(WaveAudioSource& source) {
+        for (const SourceAction action : kRecordableActions) {
+            MovementList<Movement>& movements = source.GetControl(action).movements;
+            movements.Reserve(movements.size() + kRecordReserve);
+        }
+        source.lp_shelf_precomute.cache.reserve(source.lp_shelf_precomute.cache.size() + kRecordReserve);
+        source.hp_shelf_precomute.cache.reserve(source.hp_shelf_precomute.cache.size() + kRecordReserve);
+    }
+
+    void Mixer::CaptureLiveControls() {
+        for (int32_t deck = 0; deck < 2; ++deck) {
+            const WaveAudioSource& source = deck ? *incoming.get() : *playing.get();
+            const int32_t position = source.last_read_pos;
+            if (source.Empty() || position == last_capture_pos[deck]) {
+                continue;
+            }
+            last_capture_pos[deck] = position;
+            for (const SourceAction action : kRecordableActions) {
+                const MixerControl& control = source.GetControl(action);
+                if (control.live) {
+                    recorder.Capture(deck, action, position, control.live_movement.control.Value());
+                }
+            }
+        }
+    }
+
+    void Mixer::EndLiveRecord() {
+        last_capture_pos.fill(-1);
+        CaptureLiveControls();
+        for (int32_t deck = 0; deck < 2; ++deck) {
+            WaveAudioSource& source = deck ? *incoming.get() : *playing.get();
+            for (const SourceAction action : kRecordableActions) {
+                MixerControl& control = source.GetControl(action);
+                if (control.live) {
+                    recorder.EndRide(deck, action);
+                    control.live = false;
+                }
+            }
+        }
+    }
+
+    void Mixer::ApplyRecordedMovements() {
+        AdoptRecordingRoom();
+        // Points are applied in order, so later ones queue behind a held point until its room arrives.
+        if (holding_point && !ApplyRecordedPoint(held_point)) {
+            return;
+        }
+        holding_point = false;
+        while (recorder.ReadSimplified(held_point)) {
+            if (!ApplyRecordedPoint(held_point)) {
+                holding_point = true;
+                return;
+            }
+        }
+    }
+
+    bool Mixer::ApplyRecordedPoint(const AutomationPoint& point) {
+        WaveAudioSource& source = point.target ? *incoming.get() : *playing.get();
+        if (source.Empty() || point.position >= source.audio_end - source.audio_start) {
+            return true;
+        }
+        // Only reserved room is used so the audio thread never allocates.
+        MixerControl& control = source.GetControl(point.action);
+        const std::vector<nMath::ShelfFilterParams>* shelf_cache =
+            point.action == MixScript::SA_MULTIPLY_LP_SHELF_GAIN ? &source.lp_shelf_precomute.cache :
+            point.action == MixScript::SA_MULTIPLY_HP_SHELF_GAIN ? &source.hp_shelf_precomute.cache : nullptr;
+        if (!control.movements.HasReservedRoom() ||
+            (shelf_cache != nullptr && shelf_cache->size() == shelf_cache->capacity())) {
+            RequestRecordingRoom();
+            return false;
+        }
+        const int precompute_index = shelf_cache != nullptr ? AddShelfPrecompute(source, point.action,
+            point.value > 0.f ? GainToDb(point.value) : -96.f) : -1;
+        // Transition of zero and threshold of zero interpolates linearly between recorded points.
+        control.ClearMovements(source.audio_start + point.erase_from, source.audio_start + point.position);
+        control.movements.Insert(Movement{ GainControl{ point.value }, MFT_LINEAR, 0.f, 0,
+            source.audio_start + point.position, precompute_index });
+        return true;
+    }
+
+    void Mixer::RequestRecordingRoom() {
+        // One request at a time, the control thread reads it until it clears the flag.
+        if (recording_room_requested.load(std::memory_order_acquire)) {
+            return;
+        }
+        for (int32_t deck = 0; deck < 2; ++deck) {
+            const WaveAudioSource& source = deck ? *incoming.get() : *playing.get();
+            for (size_t i = 0; i < kNumRecordableActions; ++i) {
+                const MovementList<Movement>& movements = source.GetControl(kRecordableActions[i]).movements;
+                recording_room_request.num_chunks[deck][i] = movements.HasReservedRoom() ? -1 :
+                    static_cast<int32_t>(movements.NumChunks());
+            }
+            const std::vector<nMath::ShelfFilterParams>& lp_cache = source.lp_shelf_precomute.cache;
+            const std::vector<nMath::ShelfFilterParams>& hp_cache = source.hp_shelf_precomute.cache;
+            recording_room_request.lp_shelf_cache[deck] = lp_cache.size() < lp_cache.capacity() ? -1 :
+                static_cast<int32_t>(lp_cache.size());
+            recording_room_request.hp_shelf_cache[deck] = hp_cache.size() < hp_cache.capacity() ? -1 :
+                static_cast<int32_t>(hp_cache.size());
+        }
+        recording_room_requested.store(true, std::memory_order_release);
+    }
+
+    void Mixer::GrowRecordingRoom() {
+        if (!recording_room_requested.load(std::memory_order_acquire)) {
+            return;
+        }
+        MS_TRACE_SCOPE("Mixer::GrowRecordingRoom");
+        std::unique_ptr<RecordingRoom> room(new RecordingRoom());
+        room->adopted = false;
+        for (int32_t deck = 0; deck < 2; ++deck) {
+            room->decks[deck] = deck ? incoming.get() : playing.get();
+            for (size_t i = 0; i < kNumRecordableActions; ++i) {
+                const int32_t num_chunks = recording_room_request.num_chunks[deck][i];
+                if (num_chunks >= 0) {
+                    room->movements[deck][i] = MovementList<Movement>::ReserveStorage(num_chunks, kRecordReserve);
+                }
+            }
+            if (recording_room_request.lp_shelf_cache[deck] >= 0) {
+                room->lp_shelf_cache[deck].reserve(recording_room_request.lp_shelf_cache[deck] + kRecordReserve);
+            }
+            if (recording_room_request.hp_shelf_cache[deck] >= 0) {
+                room->hp_shelf_cache[deck].reserve(recording_room_request.hp_shelf_cache[deck] + kRecordReserve);
+            }
+        }
+        const MemoryRanges released = LockedMemory();
+        recording_room.Publish(std::move(room));
+        HardenMemory(released);
+        recording_room_requested.store(false, std::memory_order_release);
+    }
+
+    void Mixer::AdoptRecordingRoom() {
+        RecordingRoom* const room = recording_room.Acquire();
+        if (room == nullptr || room->adopted) {
+            return;
+        }
+        room->adopted = true;
+        for (int32_t deck = 0; deck < 2; ++deck) {
+            WaveAudioSource& source = deck ? *incoming.get() : *playing.get();
+            // A deck loaded since the request has its own reserve.
+            if (room->decks[deck] != &source) {
+                continue;
+            }
+            for (size_t i = 0; i < kNumRecordableActions; ++i) {
+                source.GetControl(kRecordableActions[i]).movements.Adopt(room->movements[deck][i]);
+            }
+            AdoptShelfCache(source.lp_shelf_precomute.cache, room->lp_shelf_cache[deck]);
+            AdoptShelfCache(source.hp_shelf_precomute.cache, room->hp_shelf_cache[deck]);
+        }
     }
 
     void Mixer::DoAction(const SourceActionInfo& action_info) {
@@ -130,8 +643,7 @@ namespace MixScript
             db = nMath::Clamp(db, -96.f, 12.f);
             //char debug_msg[256]; sprintf(&debug_msg[0], "Next db %.3f\n", db);
             //OutputDebugString(debug_msg);
-            UpdateMovement(target, GainControl{ DbToGain(db) }, target.gain_control, 1.f,
-                update_param_on_selected_marker, -1);
+            WriteMovement(target, GainControl{ DbToGain(db) }, target.gain_control, 1.f, -1);
         }
         break;
         case MixScript::SA_MULTIPLY_LP_SHELF_GAIN:
@@ -139,12 +651,8 @@ namespace MixScript
             const float current_gain = target.lp_shelf_control.ValueAt(target.audio_start + target.last_read_pos);
             float db = (current_gain > 0.f ? GainToDb(current_gain) : -96.f) + action_info.r_value;
             db = nMath::Clamp(db, -24.f, 6.f);
-            // TODO: Replace index with uid
-            target.lp_shelf_precomute.cache.emplace_back(fabsf(db) > 0.01 ?
-                nMath::TwoPoleButterworthLowShelfConfig(FrequencyToPercent(target.format, 200.f), db) :
-                nMath::TwoPoleNullConfig());            
-            UpdateMovement(target, GainControl{ DbToGain(db) }, target.lp_shelf_control, 1.f,
-                update_param_on_selected_marker, target.lp_shelf_precomute.cache.size() - 1);
+            const int precompute_index = ShelfPrecomputeIndex(target, MixScript::SA_MULTIPLY_LP_SHELF_GAIN, db);
+            WriteMovement(target, GainControl{ DbToGain(db) }, target.lp_shelf_control, 1.f, precompute_index);
         }
         break;
         case MixScript::SA_MULTIPLY_HP_SHELF_GAIN:
@@ -152,12 +660,49 @@ namespace MixScript
             const float current_gain = target.hp_shelf_control.ValueAt(target.audio_start + target.last_read_pos);
             float db = (current_gain > 0.f ? GainToDb(current_gain) : -96.f) + action_info.r_value;
             db = nMath::Clamp(db, -24.f, 6.f);
-            // TODO: Replace index with uid
-            target.hp_shelf_precomute.cache.emplace_back(fabsf(db) > 0.01 ?
-                nMath::TwoPoleButterworthHighShelfConfig(FrequencyToPercent(target.format, 3000.f), db) :
-                nMath::TwoPoleNullConfig());
-            UpdateMovement(target, GainControl{ DbToGain(db) }, target.hp_shelf_control, 1.f,
-                update_param_on_selected_marker, target.hp_shelf_precomute.cache.size() - 1);
+            const int precompute_index = ShelfPrecomputeIndex(target, MixScript::SA_MULTIPLY_HP_SHELF_GAIN, db);
+            WriteMovement(target, GainControl{ DbToGain(db) }, target.hp_shelf_control, 1.f, precompute_index);
+        }
+        break;
+        case MixScript::SA_MULTIPLY_LOW_GAIN:
+        case MixScript::SA_MULTIPLY_MID_GAIN:
+        case MixScript::SA_MULTIPLY_HIGH_GAIN:
+        {
+            MixerControl& band_control = target.GetControl(action_info.action);
+            const float current_gain = band_control.ValueAt(target.audio_start + target.last_read_pos);
+            float db = (current_gain > 0.f ? GainToDb(current_gain) : -96.f) + action_info.r_value;
+            db = nMath::Clamp(db, -96.f, 6.f);
+            // Bottom of the range kills the band.
+            WriteMovement(target, GainControl{ db > -96.f ? DbToGain(db) : 0.f }, band_control, 1.f, -1);
+        }
+        break;
+        case MixScript::SA_MULTIPLY_CONVOLUTION_SEND:
+        case MixScript::SA_MULTIPLY_DELAY_SEND:
+        {
+            // Same steps as the fader.
+            MixerControl& send_control = target.GetControl(action_info.action);
+            const float minimuum_adjustment = DbToGain(0.5f) - 1.f;
+            const float current_send = send_control.ValueAt(target.audio_start + target.last_read_pos);
+            const float next_send = nMath::Clamp(current_send + minimuum_adjustment * action_info.r_value, 0.f, 1.f);
+            WriteMovement(target, GainControl{ next_send }, send_control, 1.f, -1);
+        }
+        break;
+        case MixScript::SA_DELAY_FEEDBACK:
+        {
+            const float current_feedback = target.delay_feedback_control.movements.empty() ?
+                WaveAudioSource::kDefaultDelayFeedback :
+                target.delay_feedback_control.ValueAt(target.audio_start + target.last_read_pos);
+            const float next_feedback = nMath::Clamp(current_feedback + 0.01f * action_info.r_value, 0.f,
+                nMath::FeedbackDelay::kMaxFeedback);
+            WriteMovement(target, GainControl{ next_feedback }, target.delay_feedback_control, 1.f, -1);
+        }
+        break;
+        case MixScript::SA_SWEEP_FILTER:
+        {
+            const float current_sweep = target.filter_control.ValueAt(target.audio_start + target.last_read_pos);
+            // A step is 1% of the range, large steps snap to either end.
+            const float next_sweep = nMath::Clamp(current_sweep + 0.01f * action_info.r_value, 0.f, 2.f);
+            WriteMovement(target, GainControl{ next_sweep }, target.filter_control, 1.f, -1);
         }
         break;
         case MixScript::SA_BYPASS_GAIN:
@@ -169,10 +714,28 @@ namespace MixScript
         case MixScript::SA_SET_RECORD:
             update_param_on_selected_marker = !(action_info.i_value != 0);
             break;
+        case MixScript::SA_MATCH_LOUDNESS:
+            MatchLoudness(*playing.get(), action_info.r_value);
+            MatchLoudness(*incoming.get(), action_info.r_value);
+            break;
+        case MixScript::SA_SET_TEMPO_MODE:
+            target.tempo_mode = static_cast<DeckTempoMode>(action_info.i_value);
+            break;
+        case MixScript::SA_SET_LIVE_RECORD:
+            // HandleAction started the recorder for every on, so an on while recording is finished at once and the
+            // worker is not left running after the recording ends.
+            if (live_record) {
+                if (action_info.i_value == 0) {
+                    EndLiveRecord();
+                }
+                recorder.Finish();
+            }
+            live_record = action_info.i_value != 0;
+            break;
         case MixScript::SA_RESET_AUTOMATION:
             if (control.movements.size() > 1) {
                 auto& movements = control.movements;
-                movements.erase(movements.begin() + 1, movements.end());                
+                movements.Erase(std::next(movements.begin()), movements.end());
             }
             break;
         case MixScript::SA_RESET_AUTOMATION_IN_REGION:
@@ -197,8 +760,7 @@ namespace MixScript
 
     // TODO: Deprecate
     void Mixer::UpdateGainValue(WaveAudioSource& source, const float gain, const float interpolation_percent) {
-        UpdateMovement(source, GainControl{ gain }, source.fader_control, interpolation_percent,
-            update_param_on_selected_marker, -1);
+        WriteMovement(source, GainControl{ gain }, source.fader_control, interpolation_percent, -1);
     }
 
     WaveAudioSource& Mixer::Selected() {
@@ -250,20 +812,8 @@ namespace MixScript
 
     void Mixer::ClearImpliedMarkers() {
         WaveAudioSource& source = Selected();
-        const int selected_marker = source.selected_marker;
-        uint8_t const * const selected_marker_start = selected_marker > 0 ? source.cue_starts[source.selected_marker - 1].start : nullptr;
-        int selected_marker_offset = 0;
-        auto& cues = source.cue_starts;
-        cues.erase(std::remove_if(cues.begin(), cues.end(), [selected_marker_start, &selected_marker_offset](const MixScript::Cue& cue) {
-            if (cue.start < selected_marker_start && cue.type == CT_IMPLIED) {
-                ++selected_marker_offset;
-            }
-            return cue.type == CT_IMPLIED;
-        }), cues.end());
-        if (selected_marker_offset > 0) {
-            source.selected_marker -= selected_marker_offset;
-            assert(source.selected_marker > 0);
-        }
+        source.tempo_map.Clear();
+        source.ClearImpliedMarkers();
     }
 
     void Mixer::GenerateImpliedMarkers() {        
@@ -283,21 +833,10 @@ namespace MixScript
         if (cue_end < cue_start) {
             std::swap(cue_end, cue_start);
         }
-        auto& cues = source.cue_starts;
-        uint8_t const * const original_pos = source.read_pos;
-        source.read_pos = cues[cue_start - 1].start;
-        uint8_t const * const read_end_cue = cues[cue_end - 1].start;
-        const uint32_t delta = static_cast<uint32_t>(read_end_cue - cues[cue_start - 1].start);
-        while (source.read_pos - source.audio_start > delta) {
-            source.read_pos -= delta;
-            source.AddMarker(CT_IMPLIED); // Will invalidate cue_start and cue_end
-        }
-        source.read_pos = read_end_cue;
-        while (source.audio_end - source.read_pos > delta) {
-            source.read_pos += delta;
-            source.AddMarker(CT_IMPLIED);
-        }
-        source.read_pos = original_pos;
+        const auto& cues = source.cue_starts;
+        uint8_t const * const first = cues[cue_start - 1].start;
+        uint8_t const * const last = cues[cue_end - 1].start;
+        source.GenerateImpliedMarkers(first, static_cast<uint32_t>(last - first));
     }
 
     void Mixer::SeekSync() {
@@ -347,6 +886,41 @@ namespace MixScript
         mix_sync.playing_cue_id = playing_cue_id;
     }
 
+    void Mixer::AutoAlignSync() {
+        if (playing->Empty() || incoming->Empty()) {
+            return;
+        }
+        const auto& incoming_cues = incoming->cue_starts;
+        const int64_t incoming_offset = mix_sync.incoming_cue_id > 0 &&
+            mix_sync.incoming_cue_id <= (int)incoming_cues.size() ?
+            incoming_cues[mix_sync.incoming_cue_id - 1].start - incoming->audio_start : 0;
+        auto& playing_cues = playing->cue_starts;
+        const int64_t playing_estimate = mix_sync.playing_cue_id > 0 &&
+            mix_sync.playing_cue_id <= (int)playing_cues.size() ?
+            playing_cues[mix_sync.playing_cue_id - 1].start - playing->audio_start : playing->last_read_pos.load();
+        // Two bars either side of the current sync.
+        const float search_ms = playing->bpm > 0.f ? 2 * WaveAudioSource::kBeatsPerMarker * 60000.f / playing->bpm :
+            4000.f;
+        int64_t aligned_offset = 0;
+        if (!AlignToPlaying(*playing, *incoming, incoming_offset, playing_estimate,
+            static_cast<int64_t>(TimeMsToBytes(playing->format, search_ms)), aligned_offset)) {
+            OutputDebugString("Auto align failed, decks differ in format, missing onsets or the sync window is too short.");
+            return;
+        }
+
+        uint8_t const * const aligned_pos = playing->audio_start + aligned_offset;
+        const size_t index = playing->NextCueIndex(aligned_pos);
+        if (index == playing_cues.size() || playing_cues[index].start != aligned_pos) {
+            playing_cues.insert(playing_cues.begin() + index, { aligned_pos, playing_cues.empty() ? CT_LEFT_RIGHT :
+                CT_DEFAULT });
+            if (playing->selected_marker > (int)index) {
+                ++playing->selected_marker;
+            }
+        }
+        mix_sync.playing_cue_id = static_cast<int>(index) + 1;
+        ResetToCue(0);
+    }
+
     void Mixer::SetMixSync() {
         switch (selected_track)
         {
@@ -372,9 +946,18 @@ namespace MixScript
             return;
         }
 
+        UpdateDeckTempo();
+        UpdateDeckDelays();
+        playing_.convolution.Acquire();
+        incoming_.convolution.Acquire();
+        limiter.bypass = limiter_bypass.load();
+
         float left = 0;
         float right = 0;
         const bool make_mono = modifier_mono;
+        // Two clock reads a frame, only on the callbacks sampled for deck cost.
+        const bool time_decks = callback_stats.SamplingDecks();
+        const int64_t solo_start = time_decks ? CallbackStats::Now() : 0;
 
         // TODO: Figure out template unresolved external bug preventing refactor.
         if (incoming_.playback_solo && (!playing_.playback_solo || playing_.Empty())) {
@@ -386,10 +969,14 @@ namespace MixScript
                     left = 0.707f * (left + right);
                     right = left;
                 }
+                limiter.Process(left, right);
                 output_writer.WriteLeft(left);
                 output_writer.WriteRight(right);
             }
             incoming_.last_read_pos = static_cast<int32_t>(incoming_.read_pos - incoming_.audio_start);
+            if (time_decks) {
+                callback_stats.AddDeckTime(DI_INCOMING, CallbackStats::Now() - solo_start);
+            }
             return;
         }
         else if (playing_.playback_solo && (!incoming_.playback_solo || incoming_.Empty())) {
@@ -401,36 +988,74 @@ namespace MixScript
                     left = 0.707f * (left + right);
                     right = left;
                 }
+                limiter.Process(left, right);
                 output_writer.WriteLeft(left);
                 output_writer.WriteRight(right);
             }
             playing_.last_read_pos = static_cast<int32_t>(playing_.read_pos - playing_.audio_start);
+            if (time_decks) {
+                callback_stats.AddDeckTime(DI_PLAYING, CallbackStats::Now() - solo_start);
+            }
             return;
         }
         else {
             const uint8_t* front = playing_.cue_starts.size() ? playing_.cue_starts[mix_sync.playing_cue_id - 1].start :
                 playing_.audio_start;
+            // Track the next cue of each deck instead of searching per sample. Only a jump needs a new search.
+            // A stretched or varispeed deck can step over a cue, so a cue counts once the read passes it.
+            const std::vector<MixScript::Cue>& playing_cues = playing_.cue_starts;
+            const std::vector<MixScript::Cue>& incoming_cues = incoming_.cue_starts;
+            size_t next_playing = playing_.NextCueIndex(playing_.read_pos);
+            size_t next_incoming = incoming_.NextCueIndex(incoming_.read_pos);
             for (int32_t i = 0; i < samples_to_read; ++i) {
-                uint32_t cue_id = 0;
-                // TODO: look up next cue instead of per sample.
-                bool on_cue = playing_.Cue(playing_.read_pos, cue_id) && (int)cue_id >= mix_sync.playing_cue_id;
+                uint8_t const * const playing_before = playing_.read_pos;
+                uint8_t const * const incoming_before = incoming_.read_pos;
+                const int64_t playing_start = time_decks ? CallbackStats::Now() : 0;
                 left = playing_.ReadAndProcess(0);
                 // Second read should use first read pos for automation calculation
                 right = playing_.ReadAndProcess(1);
+                const int64_t incoming_start = time_decks ? CallbackStats::Now() : 0;
                 if (playing_.read_pos >= front) {
                     left += incoming_.ReadAndProcess(0);
                     right += incoming_.ReadAndProcess(1);
                 }
+                if (time_decks) {
+                    callback_stats.AddDeckTime(DI_PLAYING, incoming_start - playing_start);
+                    callback_stats.AddDeckTime(DI_INCOMING, CallbackStats::Now() - incoming_start);
+                }
+                // Playing cues in [before, after), incoming cues in (before, after]. A playing deck that did not
+                // move checks its position only. An incoming deck reading slower than the mix stalls on the cue it
+                // was reset to, so it only counts cues it moves onto.
+                const int32_t cue_id = static_cast<int32_t>(next_playing) + 1; // 1 based
+                const bool on_cue = next_playing < playing_cues.size() && cue_id >= mix_sync.playing_cue_id &&
+                    (playing_cues[next_playing].start < playing_.read_pos ||
+                    playing_cues[next_playing].start == playing_before);
+                while (next_playing < playing_cues.size() && playing_cues[next_playing].start < playing_.read_pos) {
+                    ++next_playing;
+                }
+                if (incoming_.read_pos > incoming_before) {
+                    while (next_incoming < incoming_cues.size() && incoming_cues[next_incoming].start <= incoming_before) {
+                        ++next_incoming;
+                    }
+                }
+                const size_t crossed_incoming = next_incoming;
+                while (next_incoming < incoming_cues.size() && incoming_cues[next_incoming].start < incoming_.read_pos) {
+                    ++next_incoming;
+                }
                 if (on_cue) {
-                    MixScript::ResetToCue(incoming, (uint32_t)((int32_t)cue_id + mix_sync.Delta()));
+                    MixScript::ResetToCue(incoming, (uint32_t)(cue_id + mix_sync.Delta()));
+                    next_incoming = incoming_.NextCueIndex(incoming_.read_pos);
                 }
-                else if (incoming_.Cue(incoming_.read_pos, cue_id)) {
-                    MixScript::ResetToCue(playing, (uint32_t)((int32_t)cue_id + mix_sync.Reverse()));
+                else if (incoming_.read_pos > incoming_before && crossed_incoming < incoming_cues.size() &&
+                    incoming_cues[crossed_incoming].start <= incoming_.read_pos) {
+                    MixScript::ResetToCue(playing, (uint32_t)((int32_t)crossed_incoming + 1 + mix_sync.Reverse()));
+                    next_playing = playing_.NextCueIndex(playing_.read_pos);
                 }
                 if (make_mono) {
                     left = 0.707f * (left + right);
                     right = left;
                 }
+                limiter.Process(left, right);
                 output_writer.WriteLeft(left);
                 output_writer.WriteRight(right);
             }
@@ -439,6 +1064,34 @@ namespace MixScript
         }
     }
 
+    template void Mixer::Mix<FloatOutputWriter>(FloatOutputWriter& output_writer, int samples_to_read);
+    template void Mixer::Mix<PCMOutputWriter>(PCMOutputWriter& output_writer, int samples_to_read);
+
+    void Mixer::UpdateDeckTempo() {
+        WaveAudioSource& incoming_ = *incoming.get();
+        if (incoming_.tempo_mode == DTM_NONE || playing->Empty() || incoming_.Empty()) {
+            return;
+        }
+        const float playing_bpm = LocalBpm(*playing.get());
+        const float incoming_bpm = LocalBpm(incoming_);
+        incoming_.SetTempoRate(playing_bpm > 0.f && incoming_bpm > 0.f ? playing_bpm / incoming_bpm : 1.f);
+    }
+
+    void Mixer::UpdateDeckDelays() {
+        // Default tempo for a deck without analysis.
+        constexpr float kFallbackBpm = 120.f;
+        for (WaveAudioSource* source : { playing.get(), incoming.get() }) {
+            if (source->Empty() || !source->delay.Prepared()) {
+                continue;
+            }
+            const float bpm = LocalBpm(*source);
+            // A deck following the playing tempo echoes at the tempo heard.
+            const float heard_bpm = (bpm > 0.f ? bpm : kFallbackBpm) *
+                (source->tempo_mode != DTM_NONE ? source->TempoRate() : 1.f);
+            source->delay.SetDelayFrames(source->delay_beats * 60.f * mix_sample_rate / heard_bpm);
+        }
+    }
+
     void Mixer::ResetToCue(const uint32_t cue_id) {
         MixScript::ResetToCue(playing, cue_id);
         if (cue_id == 0) { // TODO: This will lead to marker bugs.
@@ -455,10 +1108,31 @@ namespace MixScript
             fs << "  type: " << static_cast<int32_t>(cue.type) << "\n";
             fs << "}\n";
         }
+        for (const SourceAction action : kRecordableActions) {
+            for (const Movement& movement : source->GetControl(action).movements) {
+                fs << "movements {\n";
+                fs << "  action: " << static_cast<int32_t>(action) << "\n";
+                fs << "  pos: " << static_cast<int64_t>(movement.cue_pos - source->audio_start) << "\n";
+                fs << "  value: " << movement.control.gain << "\n";
+                fs << "  type: " << static_cast<int32_t>(movement.interpolation_type) << "\n";
+                fs << "  threshold: " << movement.threshold_percent << "\n";
+                fs << "  transition: " << movement.transition_samples << "\n";
+                fs << "}\n";
+            }
+        }
         fs << "}\n";
     }
 
+    bool IsBinaryProject(const char* file_path) {
+        const size_t length = strlen(file_path);
+        return length >= 5 && strcmp(file_path + length - 5, ".mixb") == 0;
+    }
+
     void Mixer::Save(const char* file_path) {
+        if (IsBinaryProject(file_path)) {
+            SaveBinary(file_path);
+            return;
+        }
         // TOOD: Switch to protobuf?
         std::ofstream fs(file_path);
         fs << "Playing: " << playing->file_name.c_str() << "\n";
@@ -498,6 +1172,21 @@ namespace MixScript
         return line[0] == '}';
     }
 
+    // Both loaders skip cues and movements the mixer cannot play rather than casting them into an enum.
+    static bool LoadableCue(const WaveAudioSource& source, const std::vector<Cue>& cue_starts, const int64_t pos,
+        const int32_t type) {
+        // NextCueIndex searches cue_starts, so only a cue past the last one kept is taken.
+        const bool ordered = cue_starts.empty() || source.audio_start + pos > cue_starts.back().start;
+        return pos >= 0 && pos < source.audio_end - source.audio_start && ordered && type >= CT_DEFAULT &&
+            type <= CT_IMPLIED;
+    }
+
+    static bool LoadableMovement(const int32_t action, const int32_t interpolation_type) {
+        return interpolation_type >= MFT_LINEAR && interpolation_type <= MFT_EXP &&
+            std::find(kRecordableActions.begin(), kRecordableActions.end(), static_cast<SourceAction>(action)) !=
+            kRecordableActions.end();
+    }
+
     void LoadAudioSource(std::ifstream& fs, WaveAudioSource& source) {
         std::string line;
         std::getline(fs, line);
@@ -505,7 +1194,7 @@ namespace MixScript
         std::getline(fs, line);
         std::string cue_pos;
         std::string cue_type_param;
-        CueType cue_type;
+        int32_t cue_type;
         std::vector<Cue> cue_starts;
         const uint32_t indent = 2;
 
@@ -515,22 +1204,87 @@ namespace MixScript
                 ParseParam("pos", line, cue_pos, indent);
                 std::getline(fs, line);
                 if (ParseParam("type", line, cue_type_param, indent)) {
-                    cue_type = static_cast<CueType>(std::stoi(cue_type_param));
+                    cue_type = std::stoi(cue_type_param);
                     std::getline(fs, line);
                 }
                 else {
                     cue_type = CT_DEFAULT;
                 }
-                cue_starts.push_back({ source.audio_start + std::stoi(cue_pos), cue_type });
+                const int64_t pos = std::stoll(cue_pos);
+                if (LoadableCue(source, cue_starts, pos, cue_type)) {
+                    cue_starts.push_back({ source.audio_start + pos, static_cast<CueType>(cue_type) });
+                }
             }
             std::getline(fs, line);
         }
+        // Saved implied markers take precedence over the analysed grid.
+        if (std::any_of(cue_starts.begin(), cue_starts.end(), [](const Cue& cue) { return cue.type == CT_IMPLIED; })) {
+            source.tempo_map.Clear();
+        }
         source.cue_starts = std::move(cue_starts);
+
+        // Projects saved before automation was stored keep the defaults from the load.
+        bool cleared = false;
+        std::string param;
+        while (ParseStartBlock("movements", line)) {
+            if (!cleared) {
+                for (const SourceAction action : kRecordableActions) {
+                    source.GetControl(action).movements.clear();
+                }
+                source.lp_shelf_precomute.cache.clear();
+                source.hp_shelf_precomute.cache.clear();
+                cleared = true;
+            }
+            Movement movement{ GainControl{ 1.f }, MFT_LINEAR, 0.f, 0, source.audio_start, -1 };
+            int32_t action = SA_MULTIPLY_FADER_GAIN;
+            int32_t interpolation_type = MFT_LINEAR;
+            std::getline(fs, line);
+            while (!ParseEndBlock(line)) {
+                if (ParseParam("action", line, param, indent)) {
+                    action = std::stoi(param);
+                }
+                else if (ParseParam("pos", line, param, indent)) {
+                    movement.cue_pos = source.audio_start + std::stoll(param);
+                }
+                else if (ParseParam("value", line, param, indent)) {
+                    movement.control.gain = std::stof(param);
+                }
+                else if (ParseParam("type", line, param, indent)) {
+                    interpolation_type = std::stoi(param);
+                }
+                else if (ParseParam("threshold", line, param, indent)) {
+                    movement.threshold_percent = std::stof(param);
+                }
+                else if (ParseParam("transition", line, param, indent)) {
+                    movement.transition_samples = std::stoll(param);
+                }
+                std::getline(fs, line);
+            }
+            if (movement.cue_pos >= source.audio_start && movement.cue_pos < source.audio_end &&
+                LoadableMovement(action, interpolation_type)) {
+                movement.interpolation_type = static_cast<MixFadeType>(interpolation_type);
+                source.GetControl(static_cast<SourceAction>(action)).movements.Insert(movement);
+            }
+            std::getline(fs, line);
+        }
         ParseEndBlock(line);
     }
 
-    void Mixer::Load(const char* file_path) {
+    // Mix reads cue_starts[id - 1] whenever the deck has cues, so a sync id from a file has to land on one.
+    int ClampSyncCueId(const int cue_id, const WaveAudioSource& source) {
+        return nMath::Clamp(cue_id, 1, nMath::Max(static_cast<int>(source.cue_starts.size()), 1));
+    }
+
+    bool Mixer::Load(const char* file_path) {
+        if (IsBinaryProject(file_path)) {
+            return LoadBinary(file_path);
+        }
+        MS_TRACE_SCOPE("Mixer::Load");
         std::ifstream fs(file_path);
+        if (!fs) {
+            OutputDebugString("Failed to open project");
+            return false;
+        }
         std::string file_playing;
         std::string line;
         std::string param;
@@ -557,16 +1311,203 @@ namespace MixScript
         // TODO: Audio Source needs to be scoped. Reading all the cues into playing
         LoadAudioSource(fs, *playing.get());
         LoadAudioSource(fs, *incoming.get());
+        mix_sync.playing_cue_id = ClampSyncCueId(mix_sync.playing_cue_id, *playing.get());
+        mix_sync.incoming_cue_id = ClampSyncCueId(mix_sync.incoming_cue_id, *incoming.get());
+        RebuildShelfPrecompute(*playing.get());
+        RebuildShelfPrecompute(*incoming.get());
+        ReserveRecording(*playing.get());
+        ReserveRecording(*incoming.get());
+        return true;
+    }
+
+    void SaveBinaryAudioSource(const WaveAudioSource& source, const int32_t deck, ProjectWriter& writer) {
+        const ProjectDeck deck_record = { source.bpm, source.delay_beats, static_cast<int32_t>(source.tempo_mode),
+            static_cast<uint8_t>(source.playback_solo), static_cast<uint8_t>(source.playback_bypass_all), { 0, 0 } };
+        writer.Add(PST_DECK, deck, &deck_record, 1, sizeof(ProjectDeck));
+
+        std::vector<ProjectCue> cues;
+        cues.reserve(source.cue_starts.size());
+        for (const MixScript::Cue& cue : source.cue_starts) {
+            cues.push_back(ProjectCue{ cue.start - source.audio_start, static_cast<int32_t>(cue.type), 0 });
+        }
+        writer.Add(PST_CUES, deck, cues);
+
+        std::vector<ProjectTempoSegment> segments;
+        segments.reserve(source.tempo_map.Segments().size());
+        for (const TempoSegment& segment : source.tempo_map.Segments()) {
+            segments.push_back(ProjectTempoSegment{ segment.start_offset, segment.bytes_per_beat, segment.start_beat, 0 });
+        }
+        writer.Add(PST_TEMPO_SEGMENTS, deck, segments);
+
+        std::vector<ProjectMovement> movements;
+        for (const SourceAction action : kRecordableActions) {
+            for (const Movement& movement : source.GetControl(action).movements) {
+                movements.push_back(ProjectMovement{ movement.cue_pos - source.audio_start,
+                    movement.transition_samples, movement.control.gain, movement.threshold_percent,
+                    static_cast<int32_t>(action), static_cast<int32_t>(movement.interpolation_type),
+                    movement.precompute_index, 0 });
+            }
+        }
+        writer.Add(PST_MOVEMENTS, deck, movements);
+
+        for (const ProjectSectionTag tag : { PST_LP_SHELF_CACHE, PST_HP_SHELF_CACHE }) {
+            const MovementPrecomputeCacheShelf& precompute = tag == PST_LP_SHELF_CACHE ? source.lp_shelf_precomute :
+                source.hp_shelf_precomute;
+            std::vector<ProjectShelf> shelves;
+            shelves.reserve(precompute.cache.size());
+            for (const nMath::ShelfFilterParams& params : precompute.cache) {
+                shelves.push_back(ProjectShelf{ params.g, params.k, params.m0, params.m1, params.m2 });
+            }
+            writer.Add(tag, deck, shelves);
+        }
+    }
+
+    void Mixer::SaveBinary(const char* file_path) {
+        MS_TRACE_SCOPE("Mixer::SaveBinary");
+        ProjectWriter writer;
+        writer.Add(PST_PLAYING_PATH, -1, playing->file_name.data(), playing->file_name.size(), 1);
+        writer.Add(PST_INCOMING_PATH, -1, incoming->file_name.data(), incoming->file_name.size(), 1);
+        const ProjectSync sync = { mix_sync.playing_cue_id, mix_sync.incoming_cue_id };
+        writer.Add(PST_MIX_SYNC, -1, &sync, 1, sizeof(ProjectSync));
+        SaveBinaryAudioSource(*playing.get(), 0, writer);
+        SaveBinaryAudioSource(*incoming.get(), 1, writer);
+        if (!writer.Write(file_path)) {
+            OutputDebugString("Failed to write project");
+        }
+    }
+
+    std::string ProjectString(const ProjectReader& reader, const ProjectSectionTag tag) {
+        const ProjectRecords<char> records = reader.Records<char>(tag);
+        std::string value;
+        for (uint64_t i = 0; i < records.count; ++i) {
+            value.push_back(records[i]);
+        }
+        return value;
+    }
+
+    // Everything is checked against the loaded audio, a project written for a different file cannot point
+    // outside it. Cues out of order and records with an unknown type are dropped.
+    void LoadBinaryAudioSource(const ProjectReader& reader, const int32_t deck, WaveAudioSource& source) {
+        const int64_t audio_size = source.audio_end - source.audio_start;
+        const ProjectRecords<ProjectDeck> deck_records = reader.Records<ProjectDeck>(PST_DECK, deck);
+        if (deck_records.count > 0) {
+            const ProjectDeck& deck_record = deck_records[0];
+            source.bpm = deck_record.bpm;
+            source.delay_beats = deck_record.delay_beats;
+            source.tempo_mode = static_cast<DeckTempoMode>(nMath::Clamp<int32_t>(deck_record.tempo_mode, DTM_NONE,
+                DTM_VARISPEED));
+            source.playback_solo = deck_record.playback_solo != 0;
+            source.playback_bypass_all = deck_record.playback_bypass_all != 0;
+        }
+
+        if (reader.Has(PST_CUES, deck)) {
+            const ProjectRecords<ProjectCue> records = reader.Records<ProjectCue>(PST_CUES, deck);
+            std::vector<Cue> cue_starts;
+            cue_starts.reserve(static_cast<size_t>(records.count));
+            for (uint64_t i = 0; i < records.count; ++i) {
+                const ProjectCue& cue = records[i];
+                if (LoadableCue(source, cue_starts, cue.pos, cue.type)) {
+                    cue_starts.push_back({ source.audio_start + cue.pos, static_cast<CueType>(cue.type) });
+                }
+            }
+            source.cue_starts = std::move(cue_starts);
+        }
+
+        if (reader.Has(PST_TEMPO_SEGMENTS, deck)) {
+            const ProjectRecords<ProjectTempoSegment> records =
+                reader.Records<ProjectTempoSegment>(PST_TEMPO_SEGMENTS, deck);
+            std::vector<TempoSegment> segments;
+            segments.reserve(static_cast<size_t>(records.count));
+            for (uint64_t i = 0; i < records.count; ++i) {
+                const ProjectTempoSegment& segment = records[i];
+                const TempoSegment next = { segment.start_beat, segment.start_offset, segment.bytes_per_beat };
+                // Same rules as TempoMap::SetTempo, beats and offsets increase together at a playable tempo.
+                const bool ordered = segments.empty() || TempoMap::Follows(segments.back(), next);
+                if (ordered && next.bytes_per_beat >= source.MinBytesPerBeat() && isfinite(next.bytes_per_beat) &&
+                    isfinite(next.start_offset)) {
+                    segments.push_back(next);
+                }
+            }
+            source.tempo_map.SetSegments(std::move(segments));
+        }
+
+        if (!reader.Has(PST_MOVEMENTS, deck)) {
+            return;
+        }
+        for (const SourceAction action : kRecordableActions) {
+            source.GetControl(action).movements.clear();
+        }
+        for (const ProjectSectionTag tag : { PST_LP_SHELF_CACHE, PST_HP_SHELF_CACHE }) {
+            std::vector<nMath::ShelfFilterParams>& cache = tag == PST_LP_SHELF_CACHE ?
+                source.lp_shelf_precomute.cache : source.hp_shelf_precomute.cache;
+            const ProjectRecords<ProjectShelf> records = reader.Records<ProjectShelf>(tag, deck);
+            cache.clear();
+            cache.reserve(static_cast<size_t>(records.count));
+            for (uint64_t i = 0; i < records.count; ++i) {
+                cache.push_back(nMath::ShelfFilterParams{ records[i].g, records[i].k, records[i].m0, records[i].m1,
+                    records[i].m2 });
+            }
+        }
+        const ProjectRecords<ProjectMovement> records = reader.Records<ProjectMovement>(PST_MOVEMENTS, deck);
+        for (uint64_t i = 0; i < records.count; ++i) {
+            const ProjectMovement& record = records[i];
+            if (record.pos < 0 || record.pos >= audio_size ||
+                !LoadableMovement(record.action, record.interpolation_type)) {
+                continue;
+            }
+            const SourceAction action = static_cast<SourceAction>(record.action);
+            // Indices that do not fit the stored cache are rebuilt after the load.
+            const int32_t cache_size = static_cast<int32_t>(action == SA_MULTIPLY_LP_SHELF_GAIN ?
+                source.lp_shelf_precomute.cache.size() : (action == SA_MULTIPLY_HP_SHELF_GAIN ?
+                source.hp_shelf_precomute.cache.size() : 0));
+            const int precompute_index = record.precompute_index < cache_size ? record.precompute_index : -1;
+            source.GetControl(action).movements.Insert(Movement{ GainControl{ record.value },
+                static_cast<MixFadeType>(record.interpolation_type), record.threshold_percent,
+                record.transition_samples, source.audio_start + record.pos, precompute_index });
+        }
+    }
+
+    bool Mixer::LoadBinary(const char* file_path) {
+        MS_TRACE_SCOPE("Mixer::LoadBinary");
+        ProjectReader reader;
+        if (!reader.Open(file_path)) {
+            OutputDebugString("Not a MixScript binary project");
+            return false;
+        }
+        LoadPlayingFromFile(ProjectString(reader, PST_PLAYING_PATH).c_str());
+        LoadIncomingFromFile(ProjectString(reader, PST_INCOMING_PATH).c_str());
+        const ProjectRecords<ProjectSync> sync = reader.Records<ProjectSync>(PST_MIX_SYNC);
+        if (sync.count > 0) {
+            mix_sync.playing_cue_id = sync[0].playing_cue_id;
+            mix_sync.incoming_cue_id = sync[0].incoming_cue_id;
+        }
+        LoadBinaryAudioSource(reader, 0, *playing.get());
+        LoadBinaryAudioSource(reader, 1, *incoming.get());
+        mix_sync.playing_cue_id = ClampSyncCueId(mix_sync.playing_cue_id, *playing.get());
+        mix_sync.incoming_cue_id = ClampSyncCueId(mix_sync.incoming_cue_id, *incoming.get());
+        RebuildShelfPrecompute(*playing.get());
+        RebuildShelfPrecompute(*incoming.get());
+        ReserveRecording(*playing.get());
+        ReserveRecording(*incoming.get());
+        return true;
     }
 
     void PCMOutputWriter::WriteLeft(const float left_) {
-        source->Write(left_);
+        if (skip_frames == 0) {
+            source->Write(left_);
+        }
     }
     void PCMOutputWriter::WriteRight(const float right_) {
-        source->Write(right_);
+        if (skip_frames == 0) {
+            source->Write(right_);
+        }
+        else {
+            --skip_frames;
+        }
     }
 
     WaveAudioSource* Mixer::Render() {
+        MS_TRACE_SCOPE("Mixer::Render");
         const uint32_t playing_size = static_cast<uint32_t>(playing->audio_end - playing->audio_start);
         const uint32_t playing_offset = playing->cue_starts.size() ?
             static_cast<uint32_t>(playing->cue_starts.front().start - playing->audio_start) : 0;
@@ -583,8 +1524,24 @@ namespace MixScript
         MixScript::ResetToCue(playing, 0);
         MixScript::ResetToCue(incoming, 0);
 
-        PCMOutputWriter output_writer = { output_source };
-        Mix(output_writer, render_size / (playing->format.channels * playing->format.bit_rate / 8));
+        // Mix past the end by the limiter latency and drop as much from the start.
+        limiter.Reset();
+        playing->convolution.Reset();
+        incoming->convolution.Reset();
+        playing->delay.Reset();
+        incoming->delay.Reset();
+        const uint32_t latency = static_cast<uint32_t>(limiter.Latency());
+        PCMOutputWriter output_writer = { output_source, latency };
+        {
+            MS_TRACE_SCOPE("Mixer::Mix");
+            Mix(output_writer, render_size / (playing->format.channels * playing->format.bit_rate / 8) + latency);
+        }
+        limiter.Reset();
+        playing->convolution.Reset();
+        incoming->convolution.Reset();
+        playing->delay.Reset();
+        incoming->delay.Reset();
+        output_source->integrated_lufs = ComputeLoudness(*output_source);
 
         return output_source;
     }
@@ -651,7 +1608,11 @@ namespace MixScript
                 value *= 0.5f;
             }
             else if (selected_action == MixScript::SA_MULTIPLY_LP_SHELF_GAIN ||
-                selected_action == MixScript::SA_MULTIPLY_HP_SHELF_GAIN) {
+                selected_action == MixScript::SA_MULTIPLY_HP_SHELF_GAIN ||
+                selected_action == MixScript::SA_MULTIPLY_LOW_GAIN ||
+                selected_action == MixScript::SA_MULTIPLY_MID_GAIN ||
+                selected_action == MixScript::SA_MULTIPLY_HIGH_GAIN ||
+                selected_action == MixScript::SA_SWEEP_FILTER) {
                 value *= 0.5f;
             }
             ++i;
@@ -661,6 +1622,7 @@ namespace MixScript
 
     const uint8_t* ComputeWavePeaks(const WaveAudioSource& source, const uint32_t pixel_width, WavePeaks& peaks,
         const int zoom_factor) {
+        MS_TRACE_SCOPE("ComputeWavePeaks");
         const float zoom_amount = zoom_factor > 0 ? powf(2, -zoom_factor) : 1.f;
         const uint32_t delta = source.audio_end - source.audio_start;
         const uint32_t sample_count = static_cast<uint32_t>(zoom_amount * delta / ByteRate(source.format));
@@ -674,6 +1636,14 @@ namespace MixScript
         const float remainder_amount = samples_per_pixel - floorf(samples_per_pixel);
         int channel = 0;
         const int spp = static_cast<int>(samples_per_pixel);
+        // Zoomed out, the pyramid gives each pixel's peak without reading its samples. The derivative filter needs
+        // every sample so it keeps the sample loop.
+        bool filtered = false;
+        for (uint32_t c = 0; c < source.format.channels && c < WavePeaks::kMaxChannels; ++c) {
+            filtered = filtered || !peaks.filters[c].bypass;
+        }
+        const bool use_pyramid = !filtered && !source.peak_pyramid.levels.empty() &&
+            spp * source.format.channels >= 4 * PeakPyramid::kBlockSamples;
 
         for (WavePeaks::WavePeak& peak : peaks.peaks) {
             peak.max = -FLT_MAX;
@@ -687,6 +1657,18 @@ namespace MixScript
                     peak.max = peak.min = 0.f;
                 }
             }
+            if (use_pyramid) {
+                const uint64_t num_samples = static_cast<uint64_t>(spp - i) * source.format.channels;
+                const uint64_t first_sample = (read_pos - source.audio_start) / 2;
+                int16_t min = 0;
+                int16_t max = 0;
+                PeakRange(source, source.peak_pyramid, first_sample, first_sample + num_samples, min, max);
+                peak.min = min / 32768.f;
+                peak.max = max / 32768.f;
+                read_pos += num_samples * 2;
+                channel += spp - i;
+                i = spp;
+            }
             for (; i < spp; ++i, ++channel) {
                 for (uint32_t c = 0; c < source.format.channels; ++c) {
                     nMath::DerivativeFilter& active_filter = peaks.filters[channel % source.format.channels];
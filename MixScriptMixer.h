@@ -8,9 +8,15 @@
 #include <memory>
 
 #include "MixScriptAction.h"
+#include "MixScriptRealtime.h"
+#include "MixScriptRecorder.h"
 #include "MixScriptShared.h"
+#include "MixScriptStats.h"
 #include "WavAudioSource.h"
+#include "nDynamics.h"
+#include "nExchange.h"
 #include "nFilters.h"
+#include "nResampler.h"
 
 namespace MixScript
 {
@@ -30,6 +36,7 @@ namespace MixScript
 
     struct PCMOutputWriter {
         WaveAudioSource* source;
+        uint32_t skip_frames; // latency to drop from the start
 
         void WriteLeft(const float left_);
         void WriteRight(const float right_);
@@ -55,12 +62,28 @@ namespace MixScript
         template<class T>
         void Mix(T& output_writer, int samples_to_read);
         WaveAudioSource* Render();
+        // Paths ending in .mixb use the binary project, anything else the text format kept for import and export.
         void Save(const char* file_path);
-        void Load(const char* file_path);
+        // Returns false when the file cannot be opened, sync ids and cues from the file are clamped to the audio.
+        bool Load(const char* file_path);
+        void SaveBinary(const char* file_path);
+        // Returns false, leaving the mixer as it was, when the file is not a valid binary project.
+        bool LoadBinary(const char* file_path);
         void LoadPlaceholders();
         void LoadPlayingFromFile(const char* file_path);
         void LoadIncomingFromFile(const char* file_path);
+        // Takes a decoded source, runs the load analysis and seeds the automation.
+        void LoadPlaying(std::unique_ptr<WaveAudioSource> source);
+        void LoadIncoming(std::unique_ptr<WaveAudioSource> source);
         std::atomic_bool modifier_mono;
+        std::atomic<nMath::ResampleQuality> output_quality;
+        // Where load analysis is cached by content hash. Empty keeps a .msa file next to each wav.
+        std::string analysis_cache_directory;
+        std::atomic_bool limiter_bypass;
+        // Filled by the audio callback, deck cost is sampled inside Mix.
+        CallbackStats callback_stats;
+        // Default for SA_MATCH_LOUDNESS.
+        static constexpr float kLoudnessTarget = -14.f;
         MixSync mix_sync;
         int selected_track;
 
@@ -69,6 +92,26 @@ namespace MixScript
 
         void ResetToCue(const uint32_t cue_id);
 
+        // Mix runs at the playing deck's rate, the output stage converts it to the device rate.
+        void PrepareOutput(const double device_sample_rate, const int32_t max_block_size);
+        void MixOutput(FloatOutputWriter& output_writer, int samples_to_write);
+        // Body of the device callback, shared with the headless driver. Actions are applied and a non-zero cue is
+        // reset to before mixing, the output is left untouched when paused. Timing goes to callback_stats.
+        void AudioCallback(FloatOutputWriter& output_writer, const int32_t num_frames, const int32_t reset_cue_id,
+            const bool paused);
+        // Prefaults and locks the deck samples and the working buffers of the audio path, including those of decks
+        // loaded later, and nothing else of the process. The audio thread asks for real-time priority at its next
+        // callback and keeps it. Page faults inside the callback are counted in callback_stats while on. Returns
+        // false if any lock was refused.
+        bool SetRealtimeHardening(const bool enable);
+        bool RealtimeHardening() const { return realtime_hardening.load(); }
+        bool AudioThreadRealtime() const { return audio_thread_realtime.load(); }
+        uint32_t MixSampleRate() const { return mix_sample_rate; }
+        // Impulse response for the convolution send of both decks, at most kMaxImpulseResponseSeconds. Loading and
+        // fft preparation run on the calling thread while playback continues.
+        static constexpr float kMaxImpulseResponseSeconds = 10.f;
+        bool LoadImpulseResponse(const char* file_path);
+
         const WaveAudioSource* Playing() const { return playing.get(); }
         const WaveAudioSource* Incoming() const { return incoming.get(); }
 
@@ -80,11 +123,18 @@ namespace MixScript
         void SetSelectedMarker(int cue_id);
         void UpdateGainValue(WaveAudioSource& source, const float gain, const float interpolation_percent);
         void HandleAction(const SourceActionInfo& action_info);
+        // Controls a live recording captures.
+        static constexpr size_t kNumRecordableActions = 11;
+        // Control thread, regularly while recording. Allocates the room the audio thread asked for when a recorded
+        // point did not fit, the point waits for it rather than being dropped.
+        void GrowRecordingRoom();
         void ProcessActions();
         float FaderGainValue(float& interpolation_percent) const;
         void SetMixSync();
         void SeekSync();
         void AlignPlayingSyncToIncomingStart();
+        // Cross-correlates the decks around the sync and moves the playing sync to a marker at the best match.
+        void AutoAlignSync();
         void AddMarker();
         void DeleteMarker();
         void ClearImpliedMarkers();
@@ -98,17 +148,106 @@ namespace MixScript
         Region CurrentRegion() const;
         // When true, only adjust params on the selected marker.
         bool update_param_on_selected_marker;
+        // When true, control changes are live and recorded at block rate.
+        bool live_record;
+        AutomationRecorder recorder;
+        std::array<int32_t, 2> last_capture_pos;
 
         std::unique_ptr<WaveAudioSource> playing;
         std::unique_ptr<WaveAudioSource> incoming;
+        // Written by loads, read on the audio thread.
+        std::atomic<uint32_t> mix_sample_rate;
+        double device_sample_rate;
+        int32_t output_block_size;
+        // Mix rate to device rate, built and locked on the loading thread so a load never prepares it in the
+        // callback.
+        nMath::Exchange<nMath::StreamResampler> output_stage;
+        // Master bus, runs in real time and in Render.
+        nMath::LookaheadLimiter limiter;
+        std::unique_ptr<WaveAudioSource> impulse_response;
 
         ActionQueue actions;
         std::atomic<MixScript::SourceAction> selected_action;
+        std::atomic_bool realtime_hardening;
+        std::atomic_bool realtime_priority_requested;
+        std::atomic_bool audio_thread_realtime;
+        // Tempo, loudness, onsets and peaks of a loaded deck, from its analysis cache when it has a current one.
+        void AnalyseDeck(WaveAudioSource& source);
+        // Heap blocks of the audio path: the mixer, its queue and output stage, and each deck's WorkingMemory.
+        void WorkingMemory(MemoryRanges& ranges) const;
+        // WorkingMemory while hardening, empty otherwise. Taken before a load frees or replaces buffers.
+        MemoryRanges LockedMemory() const;
+        // Unlocks what was locked before a load, then locks the working memory now.
+        bool HardenMemory(const MemoryRanges& released);
         void DoAction(const SourceActionInfo& action_info);
+        void WriteMovement(WaveAudioSource& target, const GainControl& control, MixerControl& mixer_control,
+            const float interpolation_percent, const int precompute_index);
+        int AddShelfPrecompute(WaveAudioSource& target, const SourceAction action, const float db);
+        // The live slot while recording, so a ride does not grow the cache every tick. Recorded points get their
+        // entries as they are applied.
+        int ShelfPrecomputeIndex(WaveAudioSource& target, const SourceAction action, const float db);
+        // Shelf movements read from a project have no precompute yet.
+        void RebuildShelfPrecompute(WaveAudioSource& target);
+        // Movements each control and shelf cache can take from recording after a load without allocating.
+        static constexpr size_t kRecordReserve = 1024;
+        // Off the audio thread, before the deck plays or after a project fills it.
+        void ReserveRecording(WaveAudioSource& source);
+        void CaptureLiveControls();
+        void EndLiveRecord();
+        void ApplyRecordedMovements();
+        // False when the point does not fit in the reserve, room is then requested.
+        bool ApplyRecordedPoint(const AutomationPoint& point);
+
+        // Per deck, leaves of each recordable control's list and size of each shelf cache that is out of room, -1
+        // for those that still have some. Written by the audio thread before recording_room_requested is set.
+        struct RecordingRoomRequest {
+            std::array<std::array<int32_t, kNumRecordableActions>, 2> num_chunks;
+            std::array<int32_t, 2> lp_shelf_cache;
+            std::array<int32_t, 2> hp_shelf_cache;
+        };
+        // Larger buffers for the decks loaded when the request was served, moved in on the audio thread. The old
+        // buffers are left here and freed with the next room.
+        struct RecordingRoom {
+            std::array<const WaveAudioSource*, 2> decks;
+            std::array<std::array<MovementList<Movement>::Storage, kNumRecordableActions>, 2> movements;
+            std::array<std::vector<nMath::ShelfFilterParams>, 2> lp_shelf_cache;
+            std::array<std::vector<nMath::ShelfFilterParams>, 2> hp_shelf_cache;
+            bool adopted;
+
+            template <class Ranges>
+            void WorkingMemory(Ranges& ranges) const {
+                for (int32_t deck = 0; deck < 2; ++deck) {
+                    for (const MovementList<Movement>::Storage& storage : movements[deck]) {
+                        storage.WorkingMemory(ranges);
+                    }
+                    ranges.Add(lp_shelf_cache[deck]);
+                    ranges.Add(hp_shelf_cache[deck]);
+                }
+            }
+        };
+        RecordingRoomRequest recording_room_request;
+        std::atomic_bool recording_room_requested;
+        nMath::Exchange<RecordingRoom> recording_room;
+        // Audio thread only, the recorded point waiting for room.
+        AutomationPoint held_point;
+        bool holding_point;
+        void RequestRecordingRoom();
+        void AdoptRecordingRoom();
+        // Rate of the incoming deck so its tempo follows the playing deck.
+        void UpdateDeckTempo();
+        // Delay time of each deck from its tempo, after UpdateDeckTempo.
+        void UpdateDeckDelays();
+        // Called after a deck loads. Republishes convolvers and the output stage only for a new deck or a new rate.
+        void UpdateMixSampleRate();
+        // Publishes an output resampler for the mix and device rates unless the published one already fits.
+        void PrepareOutputStage();
+        // Publishes a convolver for the impulse response at the mix rate.
+        void PrepareConvolution(WaveAudioSource& source);
     };
 
-    template void Mixer::Mix<FloatOutputWriter>(FloatOutputWriter& output_writer, int samples_to_read);
-    template void Mixer::Mix<PCMOutputWriter>(PCMOutputWriter& output_writer, int samples_to_read);
+    // Instantiated in MixScriptMixer.cpp.
+    extern template void Mixer::Mix<FloatOutputWriter>(FloatOutputWriter& output_writer, int samples_to_read);
+    extern template void Mixer::Mix<PCMOutputWriter>(PCMOutputWriter& output_writer, int samples_to_read);
 
     struct AmplitudeAutomation {
         std::atomic_bool dirty;
@@ -0,0 +1,386 @@
+// MixScriptMovementList - sorted automation storage
+// Author - Nic Taylor
+
+#pragma once
+#include <array>
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <algorithm>
+#include <stdint.h>
+#include <assert.h>
+
+#include "nMath.h"
+
+namespace MixScript {
+    // Two level B+-tree of movements ordered by cue_pos. Leaves hold up to kChunkSize movements and the index keeps
+    // the first cue_pos of every leaf, so find is two binary searches and insert/erase only shift within a leaf.
+    // Emptied leaves are recycled and Reserve preallocates leaves, spares and index, so edits that stay within the
+    // reserve do not allocate.
+    template <typename T>
+    class MovementList {
+    public:
+        static constexpr int32_t kChunkSize = 64;
+
+    private:
+        struct Chunk {
+            std::array<T, kChunkSize> items;
+            int32_t count;
+        };
+
+        template <bool kConst>
+        class Iterator {
+        public:
+            typedef std::bidirectional_iterator_tag iterator_category;
+            typedef T value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef typename std::conditional<kConst, const T*, T*>::type pointer;
+            typedef typename std::conditional<kConst, const T&, T&>::type reference;
+            typedef typename std::conditional<kConst, const MovementList*, MovementList*>::type list_pointer;
+
+            Iterator() : list(nullptr), chunk(0), index(0) {}
+            Iterator(list_pointer list_, const int32_t chunk_, const int32_t index_) :
+                list(list_), chunk(chunk_), index(index_) {}
+            operator Iterator<true>() const { return Iterator<true>(list, chunk, index); }
+
+            reference operator*() const { return list->chunks[chunk]->items[index]; }
+            pointer operator->() const { return &list->chunks[chunk]->items[index]; }
+
+            Iterator& operator++() {
+                if (++index >= list->chunks[chunk]->count) {
+                    ++chunk;
+                    index = 0;
+                }
+                return *this;
+            }
+            Iterator operator++(int) { Iterator it = *this; ++(*this); return it; }
+            Iterator& operator--() {
+                if (index == 0) {
+                    --chunk;
+                    index = list->chunks[chunk]->count - 1;
+                }
+                else {
+                    --index;
+                }
+                return *this;
+            }
+            Iterator operator--(int) { Iterator it = *this; --(*this); return it; }
+
+            bool operator==(const Iterator& rhs) const { return chunk == rhs.chunk && index == rhs.index; }
+            bool operator!=(const Iterator& rhs) const { return !(*this == rhs); }
+
+        private:
+            friend class MovementList;
+            list_pointer list;
+            int32_t chunk;
+            int32_t index;
+        };
+
+    public:
+        typedef Iterator<false> iterator;
+        typedef Iterator<true> const_iterator;
+
+        MovementList() : count(0) {}
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+
+        T& front() { return chunks.front()->items[0]; }
+        const T& front() const { return chunks.front()->items[0]; }
+        T& back() { return chunks.back()->items[chunks.back()->count - 1]; }
+        const T& back() const { return chunks.back()->items[chunks.back()->count - 1]; }
+
+        iterator begin() { return iterator(this, 0, 0); }
+        iterator end() { return iterator(this, static_cast<int32_t>(chunks.size()), 0); }
+        const_iterator begin() const { return const_iterator(this, 0, 0); }
+        const_iterator end() const { return const_iterator(this, static_cast<int32_t>(chunks.size()), 0); }
+
+        // Preallocate so that up to num_movements appended in order can be stored without allocating. Appending
+        // splits a full leaf in half, so that is twice the leaves of a packed list. The spare list has room for
+        // every leaf so recycling one does not allocate either.
+        void Reserve(const size_t num_movements) {
+            const size_t num_chunks = 2 * ((num_movements + kChunkSize - 1) / kChunkSize) + 1;
+            chunks.reserve(num_chunks);
+            chunk_starts.reserve(num_chunks);
+            spare.reserve(num_chunks);
+            while (chunks.size() + spare.size() < num_chunks) {
+                spare.emplace_back(new Chunk());
+            }
+        }
+
+        // First movement with cue_pos >= position.
+        const_iterator LowerBound(uint8_t const * const position) const {
+            return Bound<true>(this, position);
+        }
+        iterator LowerBound(uint8_t const * const position) {
+            return Bound<true>(this, position);
+        }
+
+        // First movement with cue_pos > position.
+        const_iterator UpperBound(uint8_t const * const position) const {
+            return Bound<false>(this, position);
+        }
+        iterator UpperBound(uint8_t const * const position) {
+            return Bound<false>(this, position);
+        }
+
+        const T* Find(uint8_t const * const position) const {
+            const const_iterator it = LowerBound(position);
+            return it != end() && it->cue_pos == position ? &(*it) : nullptr;
+        }
+        T* Find(uint8_t const * const position) {
+            const iterator it = LowerBound(position);
+            return it != end() && it->cue_pos == position ? &(*it) : nullptr;
+        }
+
+        // Inserts after any movement at the same position. References are only valid until the next edit.
+        T& Insert(const T& movement) {
+            if (chunks.empty()) {
+                chunks.emplace_back(NewChunk());
+                chunk_starts.push_back(movement.cue_pos);
+            }
+            iterator it = UpperBound(movement.cue_pos);
+            int32_t chunk = it.chunk;
+            int32_t index = it.index;
+            // Prefer appending to the previous leaf so the index only changes on splits.
+            if (index == 0 && chunk > 0) {
+                --chunk;
+                index = chunks[chunk]->count;
+            }
+            if (chunks[chunk]->count == kChunkSize) {
+                Split(chunk);
+                if (index > chunks[chunk]->count) {
+                    index -= chunks[chunk]->count;
+                    ++chunk;
+                }
+            }
+            Chunk& leaf = *chunks[chunk];
+            std::move_backward(leaf.items.begin() + index, leaf.items.begin() + leaf.count,
+                leaf.items.begin() + leaf.count + 1);
+            leaf.items[index] = movement;
+            ++leaf.count;
+            ++count;
+            chunk_starts[chunk] = leaf.items[0].cue_pos;
+            return leaf.items[index];
+        }
+
+        // Removes movements in [first, last).
+        void Erase(const_iterator first, const_iterator last) {
+            if (first == last) {
+                return;
+            }
+            int32_t first_chunk = first.chunk;
+            const int32_t last_chunk = last.chunk;
+            if (first_chunk == last_chunk) {
+                Chunk& leaf = *chunks[first_chunk];
+                std::move(leaf.items.begin() + last.index, leaf.items.begin() + leaf.count,
+                    leaf.items.begin() + first.index);
+                const int32_t removed = last.index - first.index;
+                leaf.count -= removed;
+                count -= removed;
+            }
+            else {
+                Chunk& head = *chunks[first_chunk];
+                count -= head.count - first.index;
+                head.count = first.index;
+                for (int32_t chunk = first_chunk + 1; chunk < last_chunk; ++chunk) {
+                    count -= chunks[chunk]->count;
+                    chunks[chunk]->count = 0;
+                }
+                if (last_chunk < (int32_t)chunks.size() && last.index > 0) {
+                    Chunk& tail = *chunks[last_chunk];
+                    std::move(tail.items.begin() + last.index, tail.items.begin() + tail.count, tail.items.begin());
+                    tail.count -= last.index;
+                    count -= last.index;
+                }
+            }
+            const int32_t end_chunk = nMath::Min(last_chunk + 1, static_cast<int32_t>(chunks.size()));
+            RemoveEmpty(first_chunk, end_chunk);
+            // Keep leaves from fragmenting when clearing many small ranges.
+            first_chunk = nMath::Min(first_chunk, static_cast<int32_t>(chunks.size()) - 1);
+            if (first_chunk > 0) {
+                --first_chunk;
+            }
+            TryMerge(first_chunk);
+        }
+
+        // Removes movements with start < cue_pos <= end.
+        void EraseRange(uint8_t const * const start, uint8_t const * const end) {
+            if (empty() || end <= start) {
+                return;
+            }
+            Erase(UpperBound(start), UpperBound(end));
+        }
+
+        // Hands the leaves, spares and index to ranges.Add so edits from the audio thread do not fault.
+        template <class Ranges>
+        void WorkingMemory(Ranges& ranges) const {
+            ranges.Add(chunks);
+            ranges.Add(chunk_starts);
+            ranges.Add(spare);
+            for (const std::vector<std::unique_ptr<Chunk>>* list : { &chunks, &spare }) {
+                for (const std::unique_ptr<Chunk>& chunk : *list) {
+                    ranges.Add(chunk.get(), sizeof(Chunk));
+                }
+            }
+        }
+
+        // True when an insert cannot allocate, a split would take a spare leaf and fit the index.
+        bool HasReservedRoom() const {
+            return !spare.empty() && chunks.size() < chunks.capacity() && chunk_starts.size() < chunk_starts.capacity();
+        }
+
+        // Larger buffers for a list, allocated off the audio thread and moved in by Adopt.
+        struct Storage {
+            std::vector<std::unique_ptr<Chunk>> chunks;
+            std::vector<uint8_t const *> chunk_starts;
+            std::vector<std::unique_ptr<Chunk>> spare;
+
+            template <class Ranges>
+            void WorkingMemory(Ranges& ranges) const {
+                ranges.Add(chunks);
+                ranges.Add(chunk_starts);
+                ranges.Add(spare);
+                for (const std::unique_ptr<Chunk>& chunk : spare) {
+                    ranges.Add(chunk.get(), sizeof(Chunk));
+                }
+            }
+        };
+
+        // Leaves in use and spare, what Storage is sized from.
+        size_t NumChunks() const { return chunks.size() + spare.size(); }
+
+        // Room for num_movements more appended in order to a list of num_chunks leaves, as Reserve would leave.
+        static Storage ReserveStorage(const size_t num_chunks, const size_t num_movements) {
+            Storage storage;
+            const size_t num_new_chunks = 2 * ((num_movements + kChunkSize - 1) / kChunkSize) + 1;
+            storage.chunks.reserve(num_chunks + num_new_chunks);
+            storage.chunk_starts.reserve(num_chunks + num_new_chunks);
+            storage.spare.reserve(num_chunks + num_new_chunks);
+            while (storage.spare.size() < num_new_chunks) {
+                storage.spare.emplace_back(new Chunk());
+            }
+            return storage;
+        }
+
+        // Moves the list into storage's buffers without allocating, so it can run on the audio thread. The old
+        // buffers are left in storage for its owner to free. False, and nothing moved, if the list has outgrown it.
+        bool Adopt(Storage& storage) {
+            const size_t num_chunks = NumChunks() + storage.spare.size();
+            if (!storage.chunks.empty() || num_chunks > storage.chunks.capacity() ||
+                num_chunks > storage.chunk_starts.capacity() || num_chunks > storage.spare.capacity()) {
+                return false;
+            }
+            for (std::unique_ptr<Chunk>& chunk : chunks) {
+                storage.chunks.push_back(std::move(chunk));
+            }
+            storage.chunk_starts.assign(chunk_starts.begin(), chunk_starts.end());
+            for (std::unique_ptr<Chunk>& chunk : spare) {
+                storage.spare.push_back(std::move(chunk));
+            }
+            chunks.swap(storage.chunks);
+            chunk_starts.swap(storage.chunk_starts);
+            spare.swap(storage.spare);
+            storage.chunks.clear();
+            storage.spare.clear();
+            return true;
+        }
+
+        void clear() {
+            for (std::unique_ptr<Chunk>& chunk : chunks) {
+                chunk->count = 0;
+                spare.emplace_back(std::move(chunk));
+            }
+            chunks.clear();
+            chunk_starts.clear();
+            count = 0;
+        }
+
+    private:
+        std::vector<std::unique_ptr<Chunk>> chunks;
+        std::vector<uint8_t const *> chunk_starts;
+        std::vector<std::unique_ptr<Chunk>> spare;
+        size_t count;
+
+        template <bool kLower, typename List>
+        static auto Bound(List* list, uint8_t const * const position) -> decltype(list->begin()) {
+            typedef decltype(list->begin()) iterator_type;
+            const auto& starts = list->chunk_starts;
+            // Leaf after the one that can hold the bound.
+            const auto next_chunk = kLower ? std::lower_bound(starts.begin(), starts.end(), position) :
+                std::upper_bound(starts.begin(), starts.end(), position);
+            const int32_t chunk = static_cast<int32_t>(next_chunk - starts.begin());
+            if (chunk == 0) {
+                return iterator_type(list, 0, 0);
+            }
+            const Chunk& leaf = *list->chunks[chunk - 1];
+            const auto leaf_end = leaf.items.begin() + leaf.count;
+            const auto it = kLower ?
+                std::lower_bound(leaf.items.begin(), leaf_end, position,
+                    [](const T& lhs, uint8_t const * const rhs) { return lhs.cue_pos < rhs; }) :
+                std::upper_bound(leaf.items.begin(), leaf_end, position,
+                    [](uint8_t const * const lhs, const T& rhs) { return lhs < rhs.cue_pos; });
+            if (it != leaf_end) {
+                return iterator_type(list, chunk - 1, static_cast<int32_t>(it - leaf.items.begin()));
+            }
+            return iterator_type(list, chunk, 0);
+        }
+
+        std::unique_ptr<Chunk> NewChunk() {
+            if (spare.empty()) {
+                std::unique_ptr<Chunk> chunk(new Chunk());
+                chunk->count = 0;
+                return chunk;
+            }
+            std::unique_ptr<Chunk> chunk = std::move(spare.back());
+            spare.pop_back();
+            chunk->count = 0;
+            return chunk;
+        }
+
+        void Split(const int32_t chunk) {
+            std::unique_ptr<Chunk> upper = NewChunk();
+            Chunk& lower = *chunks[chunk];
+            const int32_t half = lower.count / 2;
+            std::move(lower.items.begin() + half, lower.items.begin() + lower.count, upper->items.begin());
+            upper->count = lower.count - half;
+            lower.count = half;
+            chunk_starts.insert(chunk_starts.begin() + chunk + 1, upper->items[0].cue_pos);
+            chunks.insert(chunks.begin() + chunk + 1, std::move(upper));
+        }
+
+        void RemoveEmpty(const int32_t first_chunk, const int32_t end_chunk) {
+            int32_t write = first_chunk;
+            for (int32_t read = first_chunk; read < end_chunk; ++read) {
+                if (chunks[read]->count == 0) {
+                    spare.emplace_back(std::move(chunks[read]));
+                    continue;
+                }
+                if (write != read) {
+                    chunks[write] = std::move(chunks[read]);
+                }
+                chunk_starts[write] = chunks[write]->items[0].cue_pos;
+                ++write;
+            }
+            if (write != end_chunk) {
+                chunks.erase(chunks.begin() + write, chunks.begin() + end_chunk);
+                chunk_starts.erase(chunk_starts.begin() + write, chunk_starts.begin() + end_chunk);
+            }
+        }
+
+        void TryMerge(const int32_t chunk) {
+            if (chunk < 0 || chunk + 1 >= (int32_t)chunks.size()) {
+                return;
+            }
+            Chunk& lower = *chunks[chunk];
+            Chunk& upper = *chunks[chunk + 1];
+            if (lower.count + upper.count > kChunkSize / 2) {
+                return;
+            }
+            std::move(upper.items.begin(), upper.items.begin() + upper.count, lower.items.begin() + lower.count);
+            lower.count += upper.count;
+            upper.count = 0;
+            RemoveEmpty(chunk + 1, chunk + 2);
+        }
+    };
+}
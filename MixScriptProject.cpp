@@ -0,0 +1,153 @@
+// MixScriptProject - binary project layout and file mapping
+// Author - Nic Taylor
+
+#include "MixScriptProject.h"
+
+#ifdef _WIN32
+#undef UNICODE
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <string.h>
+#include <fstream>
+
+namespace MixScript
+{
+    namespace {
+        constexpr size_t kSectionAlignment = 8;
+    }
+
+    bool MappedFile::Open(const char* file_path) {
+        Close();
+#ifdef _WIN32
+        HANDLE file_handle = CreateFile(file_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file_handle == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0) {
+            CloseHandle(file_handle);
+            return false;
+        }
+        HANDLE mapping_handle = CreateFileMapping(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(file_handle);
+        if (mapping_handle == NULL) {
+            return false;
+        }
+        void* view = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+        if (view == NULL) {
+            CloseHandle(mapping_handle);
+            return false;
+        }
+        mapping = mapping_handle;
+        data = static_cast<const uint8_t*>(view);
+        size = static_cast<size_t>(file_size.QuadPart);
+#else
+        const int fd = open(file_path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+            close(fd);
+            return false;
+        }
+        void* view = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (view == MAP_FAILED) {
+            return false;
+        }
+        data = static_cast<const uint8_t*>(view);
+        size = static_cast<size_t>(file_stat.st_size);
+#endif
+        return true;
+    }
+
+    void MappedFile::Close() {
+        if (data == nullptr) {
+            return;
+        }
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle(mapping);
+#else
+        munmap(const_cast<uint8_t*>(data), size);
+#endif
+        data = nullptr;
+        size = 0;
+        mapping = nullptr;
+    }
+
+    bool ProjectReader::Open(const char* file_path, const char (&magic)[4], const uint32_t version) {
+        sections = nullptr;
+        num_sections = 0;
+        if (!file.Open(file_path) || file.Size() < sizeof(ProjectHeader)) {
+            return false;
+        }
+        const ProjectHeader& header = *reinterpret_cast<const ProjectHeader*>(file.Data());
+        if (memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version ||
+            header.endian_check != kProjectEndianCheck || header.file_size != file.Size() ||
+            header.num_sections > (file.Size() - sizeof(ProjectHeader)) / sizeof(ProjectSection)) {
+            return false;
+        }
+        const ProjectSection* table = reinterpret_cast<const ProjectSection*>(file.Data() + sizeof(ProjectHeader));
+        for (uint32_t i = 0; i < header.num_sections; ++i) {
+            const ProjectSection& section = table[i];
+            // Overflow safe form of offset + count * stride <= size.
+            if (section.offset % kSectionAlignment != 0 || section.offset > file.Size() || section.stride == 0 ||
+                section.count > (file.Size() - section.offset) / section.stride) {
+                return false;
+            }
+        }
+        sections = table;
+        num_sections = header.num_sections;
+        return true;
+    }
+
+    const ProjectSection* ProjectReader::Find(const uint32_t tag, const int32_t index) const {
+        for (uint32_t i = 0; i < num_sections; ++i) {
+            if (sections[i].tag == tag && sections[i].index == index) {
+                return &sections[i];
+            }
+        }
+        return nullptr;
+    }
+
+    void ProjectWriter::Add(const uint32_t tag, const int32_t index, const void* records, const size_t count,
+        const uint32_t stride) {
+        payload.resize((payload.size() + kSectionAlignment - 1) / kSectionAlignment * kSectionAlignment, 0);
+        // Offsets are made absolute in Write once the size of the table is known.
+        sections.push_back(ProjectSection{ tag, index, stride, 0, payload.size(), count });
+        const uint8_t* bytes = static_cast<const uint8_t*>(records);
+        payload.insert(payload.end(), bytes, bytes + count * stride);
+    }
+
+    bool ProjectWriter::Write(const char* file_path, const char (&magic)[4], const uint32_t version) const {
+        const uint64_t data_offset = sizeof(ProjectHeader) + sections.size() * sizeof(ProjectSection);
+        ProjectHeader header = {};
+        memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.endian_check = kProjectEndianCheck;
+        header.num_sections = static_cast<uint32_t>(sections.size());
+        header.file_size = data_offset + payload.size();
+        std::vector<ProjectSection> table = sections;
+        for (ProjectSection& section : table) {
+            section.offset += data_offset;
+        }
+
+        std::ofstream fs(file_path, std::ios::binary | std::ios::trunc);
+        if (!fs.is_open()) {
+            return false;
+        }
+        fs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        fs.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(ProjectSection));
+        fs.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+        return fs.good();
+    }
+}
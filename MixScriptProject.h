@@ -0,0 +1,175 @@
+// MixScriptProject - binary project layout and file mapping
+// Author - Nic Taylor
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace MixScript
+{
+    // A .mixb project is a header, a table of sections and the section data. Every section is a flat array of
+    // fixed size records at an 8 byte aligned offset, so the file is mapped and read in place with no parsing.
+    // Values are in host order, every target is little-endian, endian_check rejects a file that is not.
+    //
+    // Records only grow at the end. A reader takes the stride from the section and ignores fields past the ones it
+    // knows, and sections with an unknown tag are skipped, so older builds open newer files of the same version.
+    // Other binary files, like the analysis cache, use the same container with their own magic and tags.
+    constexpr char kProjectMagic[4] = { 'M', 'S', 'P', 'B' };
+    constexpr uint32_t kProjectVersion = 1;
+    constexpr uint32_t kProjectEndianCheck = 0x01020304;
+
+    enum ProjectSectionTag : uint32_t {
+        PST_PLAYING_PATH = 1, // char
+        PST_INCOMING_PATH,    // char
+        PST_MIX_SYNC,         // ProjectSync
+        PST_DECK,             // ProjectDeck, per deck
+        PST_CUES,             // ProjectCue, per deck
+        PST_TEMPO_SEGMENTS,   // ProjectTempoSegment, per deck
+        PST_MOVEMENTS,        // ProjectMovement, per deck, sorted by action then pos
+        PST_LP_SHELF_CACHE,   // ProjectShelf, per deck, indexed by ProjectMovement::precompute_index
+        PST_HP_SHELF_CACHE,   // ProjectShelf, per deck
+    };
+
+    struct ProjectHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t endian_check;
+        uint32_t num_sections;
+        uint64_t file_size;
+    };
+
+    struct ProjectSection {
+        uint32_t tag;
+        int32_t index; // deck of a project section, -1 for the mix
+        uint32_t stride;
+        uint32_t reserved;
+        uint64_t offset;
+        uint64_t count;
+    };
+
+    struct ProjectSync {
+        int32_t playing_cue_id;
+        int32_t incoming_cue_id;
+    };
+
+    struct ProjectDeck {
+        float bpm;
+        float delay_beats;
+        int32_t tempo_mode;
+        uint8_t playback_solo;
+        uint8_t playback_bypass_all;
+        uint8_t reserved[2];
+    };
+
+    // Positions are bytes from audio_start, the same as the text format.
+    struct ProjectCue {
+        int64_t pos;
+        int32_t type;
+        int32_t reserved;
+    };
+
+    struct ProjectTempoSegment {
+        double start_offset;
+        double bytes_per_beat;
+        int32_t start_beat;
+        int32_t reserved;
+    };
+
+    struct ProjectMovement {
+        int64_t pos;
+        int64_t transition_samples;
+        float value;
+        float threshold_percent;
+        int32_t action;
+        int32_t interpolation_type;
+        int32_t precompute_index;
+        int32_t reserved;
+    };
+
+    struct ProjectShelf {
+        float g, k;
+        float m0, m1, m2;
+    };
+
+    static_assert(sizeof(ProjectHeader) == 24 && sizeof(ProjectSection) == 32 && sizeof(ProjectDeck) == 16 &&
+        sizeof(ProjectCue) == 16 && sizeof(ProjectTempoSegment) == 24 && sizeof(ProjectMovement) == 40 &&
+        sizeof(ProjectShelf) == 20, "Project records are part of the file format");
+
+    // Read only view of a whole file, unmapped on destruction.
+    class MappedFile {
+    public:
+        MappedFile() : data(nullptr), size(0), mapping(nullptr) {}
+        ~MappedFile() { Close(); }
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool Open(const char* file_path);
+        void Close();
+        const uint8_t* Data() const { return data; }
+        size_t Size() const { return size; }
+
+    private:
+        const uint8_t* data;
+        size_t size;
+        void* mapping; // file mapping handle on Windows
+    };
+
+    // Records of one section, read from wherever the section is mapped.
+    template <class T>
+    struct ProjectRecords {
+        const uint8_t* data;
+        uint64_t count;
+        uint32_t stride;
+
+        const T& operator[](const uint64_t index) const {
+            return *reinterpret_cast<const T*>(data + index * stride);
+        }
+    };
+
+    class ProjectReader {
+    public:
+        ProjectReader() : sections(nullptr), num_sections(0) {}
+
+        // Maps the file and checks the header and that every section lies inside it.
+        bool Open(const char* file_path, const char (&magic)[4] = kProjectMagic,
+            const uint32_t version = kProjectVersion);
+
+        bool Has(const uint32_t tag, const int32_t index = -1) const {
+            return Find(tag, index) != nullptr;
+        }
+        // Empty when the section is missing or its records are shorter than T.
+        template <class T>
+        ProjectRecords<T> Records(const uint32_t tag, const int32_t index = -1) const {
+            const ProjectSection* section = Find(tag, index);
+            if (section == nullptr || section->stride < sizeof(T)) {
+                return ProjectRecords<T>{ nullptr, 0, static_cast<uint32_t>(sizeof(T)) };
+            }
+            return ProjectRecords<T>{ file.Data() + section->offset, section->count, section->stride };
+        }
+
+    private:
+        MappedFile file;
+        const ProjectSection* sections;
+        uint32_t num_sections;
+
+        const ProjectSection* Find(const uint32_t tag, const int32_t index) const;
+    };
+
+    // Collects sections in memory and writes the file in one go.
+    class ProjectWriter {
+    public:
+        template <class T>
+        void Add(const uint32_t tag, const int32_t index, const std::vector<T>& records) {
+            Add(tag, index, records.data(), records.size(), sizeof(T));
+        }
+        void Add(const uint32_t tag, const int32_t index, const void* records, const size_t count,
+            const uint32_t stride);
+        bool Write(const char* file_path, const char (&magic)[4] = kProjectMagic,
+            const uint32_t version = kProjectVersion) const;
+
+    private:
+        std::vector<ProjectSection> sections;
+        std::vector<uint8_t> payload;
+    };
+}
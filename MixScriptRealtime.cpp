@@ -0,0 +1,128 @@
+// MixScriptRealtime - memory locking, thread priority and page fault counts for the audio path
+// Author - Nic Taylor
+
+#include "MixScriptRealtime.h"
+
+#ifdef _WIN32
+#undef UNICODE
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+namespace MixScript
+{
+    namespace {
+        constexpr size_t kPageSize = 4096; // smallest page size of the targets, larger pages are touched repeatedly
+
+        void Prefault(const void* start, const size_t num_bytes) {
+            const volatile uint8_t* bytes = static_cast<const volatile uint8_t*>(start);
+            uint8_t sum = 0;
+            for (size_t offset = 0; offset < num_bytes; offset += kPageSize) {
+                sum += bytes[offset];
+            }
+            sum += bytes[num_bytes - 1];
+            (void)sum;
+        }
+
+        bool Lock(const void* start, const size_t num_bytes) {
+#ifdef _WIN32
+            return VirtualLock(const_cast<void*>(start), num_bytes) != 0;
+#else
+            return mlock(start, num_bytes) == 0;
+#endif
+        }
+
+        // VirtualLock is limited by the minimum working set, it is grown by what is about to be locked first.
+        bool GrowWorkingSet(const size_t num_bytes) {
+#ifdef _WIN32
+            SIZE_T minimum = 0;
+            SIZE_T maximum = 0;
+            HANDLE process = GetCurrentProcess();
+            return GetProcessWorkingSetSize(process, &minimum, &maximum) &&
+                SetProcessWorkingSetSize(process, minimum + num_bytes, maximum + num_bytes);
+#else
+            (void)num_bytes;
+            return true;
+#endif
+        }
+    }
+
+    bool PrefaultAndLock(const void* start, const size_t num_bytes) {
+        if (start == nullptr || num_bytes == 0) {
+            return true;
+        }
+        Prefault(start, num_bytes);
+        return GrowWorkingSet(num_bytes) && Lock(start, num_bytes);
+    }
+
+    bool PrefaultAndLock(const MemoryRanges& ranges) {
+        size_t total = 0;
+        for (const MemoryRange& range : ranges.Ranges()) {
+            Prefault(range.start, range.num_bytes);
+            // Small ranges still lock whole pages.
+            total += (range.num_bytes + 2 * kPageSize - 1) / kPageSize * kPageSize;
+        }
+        if (!GrowWorkingSet(total)) {
+            return false;
+        }
+        bool locked = true;
+        for (const MemoryRange& range : ranges.Ranges()) {
+            locked = Lock(range.start, range.num_bytes) && locked;
+        }
+        return locked;
+    }
+
+    void UnlockMemory(const void* start, const size_t num_bytes) {
+        if (start == nullptr || num_bytes == 0) {
+            return;
+        }
+#ifdef _WIN32
+        VirtualUnlock(const_cast<void*>(start), num_bytes);
+#else
+        munlock(start, num_bytes);
+#endif
+    }
+
+    void UnlockMemory(const MemoryRanges& ranges) {
+        for (const MemoryRange& range : ranges.Ranges()) {
+            UnlockMemory(range.start, range.num_bytes);
+        }
+    }
+
+    bool SetRealtimePriority() {
+#ifdef _WIN32
+        return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#else
+        // Below the top so the kernel's own real-time threads still preempt the mix.
+        sched_param param = {};
+        param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 10;
+        return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#endif
+    }
+
+    uint64_t PageFaultCount() {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+            return 0;
+        }
+        return counters.PageFaultCount;
+#else
+#ifdef RUSAGE_THREAD
+        const int who = RUSAGE_THREAD;
+#else
+        const int who = RUSAGE_SELF;
+#endif
+        rusage usage;
+        if (getrusage(who, &usage) != 0) {
+            return 0;
+        }
+        return static_cast<uint64_t>(usage.ru_minflt + usage.ru_majflt);
+#endif
+    }
+}
@@ -0,0 +1,45 @@
+// MixScriptRealtime - memory locking, thread priority and page fault counts for the audio path
+// Author - Nic Taylor
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace MixScript
+{
+    struct MemoryRange {
+        const void* start;
+        size_t num_bytes;
+    };
+
+    // Heap blocks the audio thread reads or writes, collected from each object that owns some through its
+    // WorkingMemory. Vectors count to their capacity so growing into reserved space stays locked.
+    class MemoryRanges {
+    public:
+        void Add(const void* start, const size_t num_bytes) {
+            if (start != nullptr && num_bytes > 0) {
+                ranges.push_back(MemoryRange{ start, num_bytes });
+            }
+        }
+        template <class T>
+        void Add(const std::vector<T>& values) {
+            Add(values.data(), values.capacity() * sizeof(T));
+        }
+        const std::vector<MemoryRange>& Ranges() const { return ranges; }
+
+    private:
+        std::vector<MemoryRange> ranges;
+    };
+
+    // Touches every page of the range so the first read in the callback does not fault, then locks it in memory.
+    // Returns false when the lock is not permitted, the range is still prefaulted.
+    bool PrefaultAndLock(const void* start, const size_t num_bytes);
+    void UnlockMemory(const void* start, const size_t num_bytes);
+    bool PrefaultAndLock(const MemoryRanges& ranges);
+    void UnlockMemory(const MemoryRanges& ranges);
+    // Real-time scheduling for the calling thread. Returns false when not permitted.
+    bool SetRealtimePriority();
+    // Minor and major faults of the calling thread. Windows and macOS only count for the whole process.
+    uint64_t PageFaultCount();
+}
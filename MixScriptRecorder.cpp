@@ -0,0 +1,179 @@
+// MixScriptRecorder - records continuous control rides and thins them into movements
+// Author - Nic Taylor
+
+#include "MixScriptRecorder.h"
+#include "nMath.h"
+
+#include <assert.h>
+#include <math.h>
+#include <chrono>
+
+namespace MixScript {
+    namespace {
+        inline float GainToDbFloor(const float gain) {
+            return gain > 0.f ? nMath::Max(20.f * log10f(gain), -96.f) : -96.f;
+        }
+    }
+
+    void SimplifyAutomation(const std::vector<AutomationPoint>& points, const float tolerance_db,
+        std::vector<int32_t>& kept, std::vector<std::pair<int32_t, int32_t>>& segments) {
+        const int32_t num_points = static_cast<int32_t>(points.size());
+        if (num_points == 0) {
+            return;
+        }
+        kept.push_back(0);
+        if (num_points == 1) {
+            return;
+        }
+        // Depth first with the left half on top of the stack so kept indices come out sorted.
+        segments.clear();
+        segments.emplace_back(0, num_points - 1);
+        while (!segments.empty()) {
+            const std::pair<int32_t, int32_t> segment = segments.back();
+            segments.pop_back();
+            const AutomationPoint& start = points[segment.first];
+            const AutomationPoint& end = points[segment.second];
+            const float duration = static_cast<float>(end.position - start.position);
+            float max_error = 0.f;
+            int32_t max_index = -1;
+            for (int32_t i = segment.first + 1; i < segment.second; ++i) {
+                const float ratio = (points[i].position - start.position) / duration;
+                const float interpolated = start.value + (end.value - start.value) * ratio;
+                const float error = fabsf(GainToDbFloor(interpolated) - GainToDbFloor(points[i].value));
+                if (error > max_error) {
+                    max_error = error;
+                    max_index = i;
+                }
+            }
+            if (max_error > tolerance_db) {
+                segments.emplace_back(max_index, segment.second);
+                segments.emplace_back(segment.first, max_index);
+            }
+            else {
+                kept.push_back(segment.second);
+            }
+        }
+    }
+
+    AutomationRecorder::AutomationRecorder() : tolerance_db(0.5f), state(0), shutdown(false) {
+        rides.reserve(8);
+        pending_output.reserve(kQueueSize);
+        kept.reserve(kSimplifyWindow);
+        segments.reserve(kSimplifyWindow);
+    }
+
+    AutomationRecorder::~AutomationRecorder() {
+        shutdown = true;
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    void AutomationRecorder::Start() {
+        uint32_t current = state.load();
+        while (!state.compare_exchange_weak(current, (current + kStarted + kOpenRecording) | kWorkerRunning)) {
+        }
+        // A running worker carries on, only one that has returned needs replacing.
+        if ((current & kWorkerRunning) != 0) {
+            return;
+        }
+        if (worker.joinable()) {
+            worker.join();
+        }
+        worker = std::thread([this]() { Run(); });
+    }
+
+    void AutomationRecorder::Finish() {
+        assert((state.load() & kOpenMask) != 0);
+        state.fetch_sub(kOpenRecording);
+    }
+
+    void AutomationRecorder::Capture(const int32_t target, const SourceAction action, const int32_t position,
+        const float value) {
+        captured.Push(AutomationPoint{ target, action, position, position, value, false });
+    }
+
+    void AutomationRecorder::EndRide(const int32_t target, const SourceAction action) {
+        captured.Push(AutomationPoint{ target, action, 0, 0, 0.f, true });
+    }
+
+    bool AutomationRecorder::ReadSimplified(AutomationPoint& point) {
+        return simplified.Pop(point);
+    }
+
+    AutomationRecorder::Ride& AutomationRecorder::FindRide(const int32_t target, const SourceAction action) {
+        for (Ride& ride : rides) {
+            if (ride.target == target && ride.action == action) {
+                return ride;
+            }
+        }
+        rides.push_back(Ride{ target, action, -1, {} });
+        rides.back().points.reserve(kSimplifyWindow + 1);
+        return rides.back();
+    }
+
+    void AutomationRecorder::Simplify(Ride& ride, const bool end_of_ride) {
+        if (ride.points.empty()) {
+            return;
+        }
+        kept.clear();
+        SimplifyAutomation(ride.points, tolerance_db.load(), kept, segments);
+        // The last kept point anchors the next window unless the ride is over.
+        const size_t emit_count = end_of_ride ? kept.size() : kept.size() - 1;
+        for (size_t i = 0; i < emit_count; ++i) {
+            AutomationPoint point = ride.points[kept[i]];
+            point.erase_from = ride.last_emitted >= 0 ? ride.last_emitted : point.position - 1;
+            point.end_of_ride = end_of_ride && i + 1 == emit_count;
+            pending_output.push_back(point);
+            ride.last_emitted = point.position;
+        }
+        if (end_of_ride) {
+            ride.points.clear();
+            ride.last_emitted = -1;
+        }
+        else {
+            const AutomationPoint anchor = ride.points[kept.back()];
+            ride.points.clear();
+            ride.points.push_back(anchor);
+        }
+    }
+
+    void AutomationRecorder::Run() {
+        while (!shutdown.load()) {
+            // Read before draining, so a finish seen here comes after every point it has to wait for.
+            const uint32_t observed = state.load();
+            const bool finishing = (observed & kOpenMask) == 0;
+            AutomationPoint point;
+            while (captured.Pop(point)) {
+                Ride& ride = FindRide(point.target, point.action);
+                if (point.end_of_ride) {
+                    Simplify(ride, true);
+                    continue;
+                }
+                // A seek ends the ride, movements must stay sorted.
+                if (!ride.points.empty() && point.position <= ride.points.back().position) {
+                    Simplify(ride, true);
+                }
+                ride.points.push_back(point);
+                if (ride.points.size() >= kSimplifyWindow) {
+                    Simplify(ride, false);
+                }
+            }
+
+            size_t written = 0;
+            while (written < pending_output.size() && simplified.Push(pending_output[written])) {
+                ++written;
+            }
+            pending_output.erase(pending_output.begin(), pending_output.begin() + written);
+
+            // Any Start since the read changed the state, even if that recording is finished too, and the worker keeps
+            // going for its points.
+            uint32_t expected = observed;
+            if (finishing && pending_output.empty() &&
+                state.compare_exchange_strong(expected, observed & ~kWorkerRunning)) {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+}
@@ -0,0 +1,114 @@
+// MixScriptRecorder - records continuous control rides and thins them into movements
+// Author - Nic Taylor
+
+#pragma once
+#include <array>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <stdint.h>
+
+#include "MixScriptAction.h"
+
+namespace MixScript {
+    // Lock-free ring for exactly one producer thread and one consumer thread.
+    template <typename T, uint32_t kSize>
+    class SPSCQueue {
+        static_assert((kSize & (kSize - 1)) == 0, "kSize must be a power of 2.");
+    public:
+        SPSCQueue() : read_index(0), write_index(0) {}
+
+        bool Push(const T& value) {
+            const uint32_t write = write_index.load(std::memory_order_relaxed);
+            if (write - read_index.load(std::memory_order_acquire) >= kSize) {
+                return false;
+            }
+            buffer[write & (kSize - 1)] = value;
+            write_index.store(write + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool Pop(T& value) {
+            const uint32_t read = read_index.load(std::memory_order_relaxed);
+            if (read == write_index.load(std::memory_order_acquire)) {
+                return false;
+            }
+            value = buffer[read & (kSize - 1)];
+            read_index.store(read + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        std::array<T, kSize> buffer;
+        std::atomic<uint32_t> read_index;
+        std::atomic<uint32_t> write_index;
+    };
+
+    struct AutomationPoint {
+        int32_t target; // 0 playing, 1 incoming
+        SourceAction action; // control the point belongs to
+        int32_t position; // bytes from audio_start
+        int32_t erase_from; // simplified points replace movements in (erase_from, position]
+        float value;
+        bool end_of_ride;
+    };
+
+    // Captures control values at block rate on the audio thread and simplifies them on a worker thread with
+    // Ramer-Douglas-Peucker, measured in dB, so a fader ride becomes a few linear movements. The worker only runs
+    // from Start until it has passed on everything captured before Finish.
+    class AutomationRecorder {
+    public:
+        AutomationRecorder();
+        ~AutomationRecorder();
+
+        // Control thread, each time recording is turned on. Starts the worker unless it is still running.
+        void Start();
+        // Audio thread.
+        void Capture(const int32_t target, const SourceAction action, const int32_t position, const float value);
+        void EndRide(const int32_t target, const SourceAction action);
+        // Once for each Start, after the last EndRide of its recording. The worker stops once every started
+        // recording is finished and its rides are simplified and handed over.
+        void Finish();
+        bool ReadSimplified(AutomationPoint& point);
+
+        std::atomic<float> tolerance_db;
+
+    private:
+        static constexpr uint32_t kQueueSize = 4096;
+        static constexpr size_t kSimplifyWindow = 256;
+
+        struct Ride {
+            int32_t target;
+            SourceAction action;
+            int32_t last_emitted;
+            std::vector<AutomationPoint> points;
+        };
+
+        SPSCQueue<AutomationPoint, kQueueSize> captured;
+        SPSCQueue<AutomationPoint, kQueueSize> simplified;
+
+        // Worker thread state.
+        std::vector<Ride> rides;
+        std::vector<AutomationPoint> pending_output;
+        std::vector<int32_t> kept;
+        std::vector<std::pair<int32_t, int32_t>> segments;
+        // Bit 0 is set while the worker runs, the next 15 bits count recordings started and not finished, and the
+        // rest count Starts so the worker never stops on a state it read before a recording came and went.
+        static constexpr uint32_t kWorkerRunning = 1;
+        static constexpr uint32_t kOpenRecording = 2;
+        static constexpr uint32_t kOpenMask = 0xFFFE;
+        static constexpr uint32_t kStarted = 0x10000;
+        std::atomic<uint32_t> state;
+        std::atomic_bool shutdown;
+        std::thread worker;
+
+        void Run();
+        Ride& FindRide(const int32_t target, const SourceAction action);
+        void Simplify(Ride& ride, const bool end_of_ride);
+    };
+
+    // Appends the indices of points to keep so that linear gain interpolation between them stays within
+    // tolerance_db of every dropped point. First and last points are always kept.
+    void SimplifyAutomation(const std::vector<AutomationPoint>& points, const float tolerance_db,
+        std::vector<int32_t>& kept, std::vector<std::pair<int32_t, int32_t>>& segments);
+}
@@ -3,8 +3,18 @@
 
 #pragma once
 #include <stdint.h>
+#ifndef _WIN32
+#include <stdio.h>
+#endif
 
 namespace MixScript {
+#ifndef _WIN32
+    // Headless builds log to stderr.
+    inline void OutputDebugString(const char* message) {
+        fprintf(stderr, "%s\n", message);
+    }
+#endif
+
     struct WaveAudioFormat {
         uint32_t channels;
         uint32_t sample_rate;
@@ -0,0 +1,202 @@
+// MixScriptStats - audio callback timing against the device deadline
+// Author - Nic Taylor
+
+#include "MixScriptStats.h"
+#include "MixScriptRealtime.h"
+#include "nMath.h"
+
+#include <chrono>
+#include <fstream>
+
+namespace MixScript
+{
+    float CallbackStatsSnapshot::MeanLoadPercent() const {
+        return audio_time ? static_cast<float>(100.0 * callback_time / audio_time) : 0.f;
+    }
+
+    float CallbackStatsSnapshot::LoadPercentile(const float percentile) const {
+        if (callbacks == 0) {
+            return 0.f;
+        }
+        const uint64_t rank = static_cast<uint64_t>(nMath::Clamp(percentile, 0.f, 1.f) * (callbacks - 1));
+        uint64_t count = 0;
+        for (int32_t bucket = 0; bucket < kLoadBuckets; ++bucket) {
+            count += load_histogram[bucket];
+            if (count > rank) {
+                return kLoadBucketPercent * (bucket + 1);
+            }
+        }
+        return kLoadBucketPercent * kLoadBuckets;
+    }
+
+    float CallbackStatsSnapshot::DeckShare(const DeckIndex deck) const {
+        return deck_sampled_time ? deck_time[deck] / static_cast<float>(deck_sampled_time) : 0.f;
+    }
+
+    CallbackStats::CallbackStats() : period_per_frame(0.0), reset_requested(false), count_page_faults(false),
+        last_callback_start(0), last_period(0.0), callback_frames(0), counting_page_faults(false),
+        callback_page_faults(0), callback_index(0), sampling_decks(false) {
+        Clear();
+    }
+
+    int64_t CallbackStats::Now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void CallbackStats::Prepare(const double device_sample_rate) {
+        period_per_frame = device_sample_rate > 0.0 ? 1e9 / device_sample_rate : 0.0;
+        Reset();
+    }
+
+    void CallbackStats::Clear() {
+        for (std::atomic<uint64_t>* counter : { &callbacks, &frames, &audio_time, &overruns, &late_callbacks,
+            &callback_time, &actions_time, &mix_time, &max_callback_time, &deck_sampled_callbacks,
+            &deck_sampled_time, &page_faults, &faulting_callbacks }) {
+            counter->store(0, std::memory_order_relaxed);
+        }
+        max_load_percent.store(0.f, std::memory_order_relaxed);
+        for (std::atomic<uint64_t>& counter : deck_time) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (std::atomic<uint64_t>& counter : load_histogram) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        last_callback_start = 0;
+        pending_deck_time.fill(0);
+    }
+
+    void CallbackStats::BeginCallback(const int32_t num_frames) {
+        if (reset_requested.exchange(false, std::memory_order_acquire)) {
+            Clear();
+        }
+        counting_page_faults = count_page_faults.load(std::memory_order_relaxed);
+        if (counting_page_faults) {
+            callback_page_faults = PageFaultCount();
+        }
+        callback_start = Now();
+        actions_end = callback_start;
+        callback_frames = num_frames;
+        // The gap is judged against the period of the previous callback, the one the device had buffered.
+        if (last_callback_start != 0 && last_period > 0.0 &&
+            callback_start - last_callback_start > 2.0 * last_period) {
+            Add(late_callbacks, 1);
+        }
+        last_callback_start = callback_start;
+        last_period = period_per_frame.load(std::memory_order_relaxed) * num_frames;
+        sampling_decks = callback_index++ % kDeckSampleInterval == 0;
+        pending_deck_time.fill(0);
+    }
+
+    void CallbackStats::EndActions() {
+        actions_end = Now();
+    }
+
+    void CallbackStats::EndCallback() {
+        const int64_t callback_end = Now();
+        const uint64_t elapsed = static_cast<uint64_t>(callback_end - callback_start);
+        Add(callbacks, 1);
+        Add(frames, static_cast<uint64_t>(callback_frames));
+        Add(callback_time, elapsed);
+        Add(actions_time, static_cast<uint64_t>(actions_end - callback_start));
+        Add(mix_time, static_cast<uint64_t>(callback_end - actions_end));
+        if (elapsed > max_callback_time.load(std::memory_order_relaxed)) {
+            max_callback_time.store(elapsed, std::memory_order_relaxed);
+        }
+
+        if (last_period > 0.0) {
+            Add(audio_time, static_cast<uint64_t>(last_period));
+            const float load_percent = static_cast<float>(100.0 * elapsed / last_period);
+            const int32_t bucket = nMath::Min(
+                static_cast<int32_t>(load_percent / CallbackStatsSnapshot::kLoadBucketPercent),
+                CallbackStatsSnapshot::kLoadBuckets - 1);
+            Add(load_histogram[bucket], 1);
+            if (load_percent > max_load_percent.load(std::memory_order_relaxed)) {
+                max_load_percent.store(load_percent, std::memory_order_relaxed);
+            }
+            if (elapsed > last_period) {
+                Add(overruns, 1);
+            }
+        }
+
+        if (counting_page_faults) {
+            const uint64_t faults = PageFaultCount() - callback_page_faults;
+            if (faults > 0) {
+                Add(page_faults, faults);
+                Add(faulting_callbacks, 1);
+            }
+        }
+
+        if (sampling_decks) {
+            Add(deck_sampled_callbacks, 1);
+            Add(deck_sampled_time, elapsed);
+            for (int32_t deck = 0; deck < DI_COUNT; ++deck) {
+                Add(deck_time[deck], static_cast<uint64_t>(pending_deck_time[deck]));
+            }
+            sampling_decks = false;
+        }
+    }
+
+    CallbackStatsSnapshot CallbackStats::Snapshot() const {
+        CallbackStatsSnapshot snapshot;
+        snapshot.callbacks = callbacks.load(std::memory_order_relaxed);
+        snapshot.frames = frames.load(std::memory_order_relaxed);
+        snapshot.audio_time = audio_time.load(std::memory_order_relaxed);
+        snapshot.overruns = overruns.load(std::memory_order_relaxed);
+        snapshot.late_callbacks = late_callbacks.load(std::memory_order_relaxed);
+        snapshot.callback_time = callback_time.load(std::memory_order_relaxed);
+        snapshot.actions_time = actions_time.load(std::memory_order_relaxed);
+        snapshot.mix_time = mix_time.load(std::memory_order_relaxed);
+        snapshot.max_callback_time = max_callback_time.load(std::memory_order_relaxed);
+        snapshot.max_load_percent = max_load_percent.load(std::memory_order_relaxed);
+        snapshot.deck_sampled_callbacks = deck_sampled_callbacks.load(std::memory_order_relaxed);
+        snapshot.deck_sampled_time = deck_sampled_time.load(std::memory_order_relaxed);
+        snapshot.page_faults = page_faults.load(std::memory_order_relaxed);
+        snapshot.faulting_callbacks = faulting_callbacks.load(std::memory_order_relaxed);
+        for (int32_t deck = 0; deck < DI_COUNT; ++deck) {
+            snapshot.deck_time[deck] = deck_time[deck].load(std::memory_order_relaxed);
+        }
+        for (int32_t bucket = 0; bucket < CallbackStatsSnapshot::kLoadBuckets; ++bucket) {
+            snapshot.load_histogram[bucket] = load_histogram[bucket].load(std::memory_order_relaxed);
+        }
+        return snapshot;
+    }
+
+    bool CallbackStats::Dump(const char* file_path) const {
+        std::ofstream fs(file_path);
+        if (!fs.is_open()) {
+            return false;
+        }
+        const CallbackStatsSnapshot snapshot = Snapshot();
+        const double callbacks_ = static_cast<double>(nMath::Max(snapshot.callbacks, (uint64_t)1));
+        fs << "callbacks: " << snapshot.callbacks << "\n";
+        fs << "frames: " << snapshot.frames << "\n";
+        fs << "overruns: " << snapshot.overruns << "\n";
+        fs << "late_callbacks: " << snapshot.late_callbacks << "\n";
+        fs << "mean_callback_us: " << snapshot.callback_time / callbacks_ / 1000.0 << "\n";
+        fs << "max_callback_us: " << snapshot.max_callback_time / 1000.0 << "\n";
+        fs << "mean_actions_us: " << snapshot.actions_time / callbacks_ / 1000.0 << "\n";
+        fs << "mean_mix_us: " << snapshot.mix_time / callbacks_ / 1000.0 << "\n";
+        fs << "page_faults: " << snapshot.page_faults << "\n";
+        fs << "faulting_callbacks: " << snapshot.faulting_callbacks << "\n";
+        fs << "load_percent {\n";
+        fs << "  mean: " << snapshot.MeanLoadPercent() << "\n";
+        fs << "  p50: " << snapshot.LoadPercentile(0.5f) << "\n";
+        fs << "  p99: " << snapshot.LoadPercentile(0.99f) << "\n";
+        fs << "  max: " << snapshot.max_load_percent << "\n";
+        fs << "}\n";
+        fs << "deck_share {\n";
+        fs << "  playing: " << snapshot.DeckShare(DI_PLAYING) << "\n";
+        fs << "  incoming: " << snapshot.DeckShare(DI_INCOMING) << "\n";
+        fs << "}\n";
+        fs << "load_histogram {\n";
+        for (int32_t bucket = 0; bucket < CallbackStatsSnapshot::kLoadBuckets; ++bucket) {
+            if (snapshot.load_histogram[bucket] != 0) {
+                fs << "  " << bucket * CallbackStatsSnapshot::kLoadBucketPercent << ": " <<
+                    snapshot.load_histogram[bucket] << "\n";
+            }
+        }
+        fs << "}\n";
+        return true;
+    }
+}
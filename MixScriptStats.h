@@ -0,0 +1,114 @@
+// MixScriptStats - audio callback timing against the device deadline
+// Author - Nic Taylor
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <stdint.h>
+
+namespace MixScript
+{
+    enum DeckIndex : int {
+        DI_PLAYING,
+        DI_INCOMING,
+        DI_COUNT
+    };
+
+    // Copy of the counters at one point in time, times in nanoseconds.
+    struct CallbackStatsSnapshot {
+        static constexpr int32_t kLoadBuckets = 41;
+        static constexpr float kLoadBucketPercent = 5.f; // last bucket is everything past 200%
+
+        uint64_t callbacks;
+        uint64_t frames;
+        uint64_t audio_time; // duration of the frames at the device rate
+        uint64_t overruns; // callbacks that took longer than the audio they produced
+        uint64_t late_callbacks; // gaps between callbacks of more than twice the period
+        uint64_t callback_time;
+        uint64_t actions_time;
+        uint64_t mix_time;
+        uint64_t max_callback_time;
+        float max_load_percent;
+        // Deck time is measured on one in kDeckSampleInterval callbacks.
+        uint64_t deck_sampled_callbacks;
+        uint64_t deck_sampled_time;
+        // Only counted while SetCountPageFaults is on.
+        uint64_t page_faults;
+        uint64_t faulting_callbacks;
+        std::array<uint64_t, DI_COUNT> deck_time;
+        std::array<uint64_t, kLoadBuckets> load_histogram;
+
+        float MeanLoadPercent() const;
+        // Upper edge of the bucket holding the percentile, 0 to 1.
+        float LoadPercentile(const float percentile) const;
+        // Share of sampled callback time spent in the deck.
+        float DeckShare(const DeckIndex deck) const;
+    };
+
+    // Lock-free counters written only by the audio thread and read by any thread. Costs a few clock reads per
+    // callback, plus two per frame on the callbacks that sample deck cost.
+    class CallbackStats {
+    public:
+        static constexpr uint32_t kDeckSampleInterval = 64;
+
+        CallbackStats();
+
+        static int64_t Now(); // steady clock nanoseconds
+
+        // Any thread.
+        void Prepare(const double device_sample_rate);
+        // Takes effect at the start of the next callback so the audio thread stays the only writer.
+        void Reset() { reset_requested.store(true, std::memory_order_release); }
+        // Reads the fault counter around every callback, two system calls each.
+        void SetCountPageFaults(const bool count) { count_page_faults.store(count, std::memory_order_relaxed); }
+        CallbackStatsSnapshot Snapshot() const;
+        bool Dump(const char* file_path) const;
+
+        // Audio thread.
+        void BeginCallback(const int32_t num_frames);
+        void EndActions();
+        void EndCallback();
+        bool SamplingDecks() const { return sampling_decks; }
+        void AddDeckTime(const DeckIndex deck, const int64_t nanoseconds) { pending_deck_time[deck] += nanoseconds; }
+
+    private:
+        std::atomic<double> period_per_frame; // nanoseconds
+        std::atomic_bool reset_requested;
+        std::atomic_bool count_page_faults;
+
+        std::atomic<uint64_t> callbacks;
+        std::atomic<uint64_t> frames;
+        std::atomic<uint64_t> audio_time;
+        std::atomic<uint64_t> overruns;
+        std::atomic<uint64_t> late_callbacks;
+        std::atomic<uint64_t> callback_time;
+        std::atomic<uint64_t> actions_time;
+        std::atomic<uint64_t> mix_time;
+        std::atomic<uint64_t> max_callback_time;
+        std::atomic<float> max_load_percent;
+        std::atomic<uint64_t> deck_sampled_callbacks;
+        std::atomic<uint64_t> deck_sampled_time;
+        std::atomic<uint64_t> page_faults;
+        std::atomic<uint64_t> faulting_callbacks;
+        std::array<std::atomic<uint64_t>, DI_COUNT> deck_time;
+        std::array<std::atomic<uint64_t>, CallbackStatsSnapshot::kLoadBuckets> load_histogram;
+
+        // Current callback, audio thread only.
+        int64_t callback_start;
+        int64_t actions_end;
+        int64_t last_callback_start;
+        double last_period;
+        int32_t callback_frames;
+        bool counting_page_faults;
+        uint64_t callback_page_faults; // count at the start of the callback
+        uint32_t callback_index;
+        bool sampling_decks;
+        std::array<int64_t, DI_COUNT> pending_deck_time;
+
+        void Clear();
+        // Single writer, so a relaxed load and store is enough.
+        static void Add(std::atomic<uint64_t>& counter, const uint64_t value) {
+            counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+    };
+}
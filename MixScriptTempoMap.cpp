@@ -0,0 +1,98 @@
+// MixScriptTempoMap - beat grid as piecewise constant tempo segments
+// Author - Nic Taylor
+
+#include "MixScriptTempoMap.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+
+namespace MixScript {
+    namespace {
+        // Recomputed offsets of the same beat can differ by rounding.
+        constexpr double kOffsetTolerance = 1e-3; // bytes
+    }
+
+    void TempoMap::Reset(const double anchor_offset, const double bytes_per_beat) {
+        assert(bytes_per_beat > 0.0);
+        segments.clear();
+        segments.push_back(TempoSegment{ 0, anchor_offset, bytes_per_beat });
+    }
+
+    size_t TempoMap::SegmentForBeat(const double beat) const {
+        const auto next = std::upper_bound(segments.begin(), segments.end(), beat,
+            [](const double lhs, const TempoSegment& rhs) { return lhs < rhs.start_beat; });
+        return next == segments.begin() ? 0 : static_cast<size_t>(next - segments.begin()) - 1;
+    }
+
+    size_t TempoMap::SegmentForOffset(const double offset) const {
+        const auto next = std::upper_bound(segments.begin(), segments.end(), offset,
+            [](const double lhs, const TempoSegment& rhs) { return lhs < rhs.start_offset; });
+        return next == segments.begin() ? 0 : static_cast<size_t>(next - segments.begin()) - 1;
+    }
+
+    bool TempoMap::Follows(const TempoSegment& previous, const TempoSegment& next) {
+        const double end_offset = previous.start_offset +
+            (static_cast<double>(next.start_beat) - previous.start_beat) * previous.bytes_per_beat;
+        return next.start_beat > previous.start_beat && next.start_offset + kOffsetTolerance >= end_offset;
+    }
+
+    size_t TempoMap::Split(const int32_t beat) {
+        const size_t index = SegmentForBeat(beat);
+        const TempoSegment& segment = segments[index];
+        if (segment.start_beat == beat) {
+            return index;
+        }
+        const TempoSegment split{ beat, BeatToOffset(beat), segment.bytes_per_beat };
+        const size_t split_index = beat < segment.start_beat ? index : index + 1;
+        segments.insert(segments.begin() + split_index, split);
+        return split_index;
+    }
+
+    bool TempoMap::SetTempo(const int32_t begin_beat, const int32_t end_beat, const int32_t pinned_beat,
+        const double bytes_per_beat) {
+        assert(!Empty() && begin_beat < end_beat);
+        if (!(bytes_per_beat > 0.0) || !isfinite(bytes_per_beat)) {
+            return false;
+        }
+        const std::vector<TempoSegment> previous = segments;
+        const double pinned_offset = BeatToOffset(pinned_beat);
+        const size_t begin_index = begin_beat == kOpenBegin ? 0 : Split(begin_beat);
+        const size_t end_index = end_beat == kOpenEnd ? segments.size() : Split(end_beat);
+        if (end_index > begin_index + 1) {
+            segments.erase(segments.begin() + begin_index + 1, segments.begin() + end_index);
+        }
+        TempoSegment& segment = segments[begin_index];
+        segment.bytes_per_beat = bytes_per_beat;
+        segment.start_offset = pinned_offset - (pinned_beat - segment.start_beat) * bytes_per_beat;
+        // SegmentForOffset searches start offsets, an overlap would hand beats to the wrong segment.
+        if ((begin_index > 0 && !Follows(segments[begin_index - 1], segment)) ||
+            (begin_index + 1 < segments.size() && !Follows(segment, segments[begin_index + 1]))) {
+            segments = previous;
+            return false;
+        }
+        return true;
+    }
+
+    double TempoMap::BeatToOffset(const double beat) const {
+        const TempoSegment& segment = segments[SegmentForBeat(beat)];
+        return segment.start_offset + (beat - segment.start_beat) * segment.bytes_per_beat;
+    }
+
+    double TempoMap::OffsetToBeat(const double offset) const {
+        const size_t index = SegmentForOffset(offset);
+        const TempoSegment& segment = segments[index];
+        const double beat = segment.start_beat + (offset - segment.start_offset) / segment.bytes_per_beat;
+        // Offsets between a segment's end and the next segment sit on the next segment's first beat.
+        return index + 1 < segments.size() ? std::min(beat, static_cast<double>(segments[index + 1].start_beat)) :
+            beat;
+    }
+
+    double TempoMap::BytesPerBeat(const double offset) const {
+        return segments[SegmentForOffset(offset)].bytes_per_beat;
+    }
+
+    float TempoMap::Bpm(const WaveAudioFormat& format, const double offset) const {
+        return BytesPerBeatToBpm(format, BytesPerBeat(offset));
+    }
+}
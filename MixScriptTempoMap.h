@@ -0,0 +1,62 @@
+// MixScriptTempoMap - beat grid as piecewise constant tempo segments
+// Author - Nic Taylor
+
+#pragma once
+#include <vector>
+#include <limits>
+#include <utility>
+#include <stdint.h>
+
+#include "MixScriptShared.h"
+
+namespace MixScript {
+    // Segment covers beats from start_beat until the next segment. Segments keep their own offset so editing one
+    // does not move the beats of another, the same way a region marker pins the implied markers around it.
+    struct TempoSegment {
+        int32_t start_beat;
+        double start_offset; // bytes from audio_start
+        double bytes_per_beat;
+    };
+
+    class TempoMap {
+    public:
+        static constexpr int32_t kOpenBegin = std::numeric_limits<int32_t>::min();
+        static constexpr int32_t kOpenEnd = std::numeric_limits<int32_t>::max();
+
+        bool Empty() const { return segments.empty(); }
+        void Clear() { segments.clear(); }
+        const std::vector<TempoSegment>& Segments() const { return segments; }
+        // Segments ordered by start_beat, each following the last, as returned by Segments.
+        void SetSegments(std::vector<TempoSegment> segments_) { segments = std::move(segments_); }
+        // True when next starts after previous and no earlier than the offset previous reaches by then.
+        static bool Follows(const TempoSegment& previous, const TempoSegment& next);
+
+        // Single tempo with beat zero at anchor_offset.
+        void Reset(const double anchor_offset, const double bytes_per_beat);
+        // Constant tempo for beats in [begin_beat, end_beat) keeping pinned_beat where it is. Beats outside the
+        // range are untouched. Returns false, leaving the map as it was, for a tempo that is not positive and finite
+        // or that would run the range into a neighbouring segment.
+        bool SetTempo(const int32_t begin_beat, const int32_t end_beat, const int32_t pinned_beat,
+            const double bytes_per_beat);
+
+        // O(log segments). Beats outside the map extrapolate from the first or last segment. Offsets increase with
+        // beats, a segment may end short of the next one but never past it.
+        double BeatToOffset(const double beat) const;
+        double OffsetToBeat(const double offset) const;
+        double BytesPerBeat(const double offset) const;
+        float Bpm(const WaveAudioFormat& format, const double offset) const;
+
+    private:
+        std::vector<TempoSegment> segments;
+
+        size_t SegmentForBeat(const double beat) const;
+        size_t SegmentForOffset(const double offset) const;
+        // Index of the segment starting at beat, splitting if needed.
+        size_t Split(const int32_t beat);
+    };
+
+    inline float BytesPerBeatToBpm(const WaveAudioFormat& format, const double bytes_per_beat) {
+        const double samples_per_beat = bytes_per_beat / (format.channels * ByteRate(format));
+        return static_cast<float>(60.0 * format.sample_rate / samples_per_beat);
+    }
+}
@@ -0,0 +1,149 @@
+// MixScriptTimeStretch - key locked tempo change read straight from track memory
+// Author - Nic Taylor
+
+#include "MixScriptTimeStretch.h"
+#include "nMath.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <xmmintrin.h>
+
+namespace MixScript
+{
+    namespace {
+        constexpr int32_t kDecimation = 4;
+        constexpr int32_t kOverlapFrames = TimeStretcher::kHopFrames;
+
+        float Dot(float const * const lhs, float const * const rhs, const int32_t count) {
+            __m128 sum = _mm_setzero_ps();
+            int32_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(lhs + i), _mm_loadu_ps(rhs + i)));
+            }
+            float lanes[4];
+            _mm_storeu_ps(lanes, sum);
+            float result = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            for (; i < count; ++i) {
+                result += lhs[i] * rhs[i];
+            }
+            return result;
+        }
+
+        // Offset within candidates whose normalised correlation with target is highest, searching first to last
+        // in steps of step.
+        int32_t BestOffset(float const * const target, float const * const candidates, const int32_t length,
+            const int32_t first, const int32_t last, const int32_t step) {
+            int32_t best_offset = first;
+            float best_score = -FLT_MAX;
+            for (int32_t offset = first; offset <= last; offset += step) {
+                const float energy = Dot(candidates + offset, candidates + offset, length);
+                const float score = Dot(target, candidates + offset, length) / sqrtf(energy + 1e-9f);
+                if (score > best_score) {
+                    best_score = score;
+                    best_offset = offset;
+                }
+            }
+            return best_offset;
+        }
+    }
+
+    TimeStretcher::TimeStretcher() : samples(nullptr), num_frames(0), channels(2), rate(1.f), grain_rate(1.f),
+        nominal(0.0), grain_start(0), output_index(kHopFrames) {}
+
+    void TimeStretcher::Prepare(uint8_t const * const audio_start, uint8_t const * const audio_end,
+        const uint32_t channels_) {
+        samples = reinterpret_cast<const int16_t*>(audio_start);
+        channels = channels_;
+        num_frames = channels > 0 ? (audio_end - audio_start) / (2 * channels) : 0;
+
+        window.resize(2 * kHopFrames);
+        for (int32_t i = 0; i < 2 * kHopFrames; ++i) {
+            // Periodic so overlapping halves sum to one.
+            window[i] = 0.5f - 0.5f * cosf((float)M_PI * i / kHopFrames);
+        }
+        accumulator.assign(2 * 2 * kHopFrames, 0.f);
+        target.resize(kOverlapFrames);
+        candidates.resize(kOverlapFrames + 2 * kSearchFrames);
+        decimated_target.resize(kOverlapFrames / kDecimation);
+        decimated_candidates.resize(candidates.size() / kDecimation);
+    }
+
+    void TimeStretcher::SetRate(const float rate_) {
+        rate = nMath::Clamp(rate_, kMinRate, kMaxRate);
+    }
+
+    float TimeStretcher::Sample(const int64_t frame, const uint32_t channel) const {
+        if (frame < 0 || frame >= num_frames) {
+            return 0.f;
+        }
+        return samples[frame * channels + nMath::Min(channel, channels - 1)] * (1.f / 32768.f);
+    }
+
+    float TimeStretcher::Mono(const int64_t frame) const {
+        return 0.5f * (Sample(frame, 0) + Sample(frame, 1));
+    }
+
+    void TimeStretcher::AddGrain(const int64_t start) {
+        grain_start = start;
+        for (int32_t i = 0; i < 2 * kHopFrames; ++i) {
+            accumulator[2 * i] += window[i] * Sample(start + i, 0);
+            accumulator[2 * i + 1] += window[i] * Sample(start + i, 1);
+        }
+    }
+
+    void TimeStretcher::ShiftHop() {
+        std::copy(accumulator.begin() + 2 * kHopFrames, accumulator.end(), accumulator.begin());
+        std::fill(accumulator.begin() + 2 * kHopFrames, accumulator.end(), 0.f);
+    }
+
+    int64_t TimeStretcher::FindGrain(const double grain_nominal) {
+        // Match the natural continuation of the last grain, coarse on every fourth frame then to the frame.
+        const int64_t continuation = grain_start + kHopFrames;
+        const int64_t search_start = static_cast<int64_t>(floor(grain_nominal)) - kSearchFrames;
+        for (int32_t i = 0; i < kOverlapFrames; ++i) {
+            target[i] = Mono(continuation + i);
+        }
+        for (int32_t i = 0; i < (int32_t)candidates.size(); ++i) {
+            candidates[i] = Mono(search_start + i);
+        }
+        for (int32_t i = 0; i < (int32_t)decimated_target.size(); ++i) {
+            decimated_target[i] = target[i * kDecimation];
+        }
+        for (int32_t i = 0; i < (int32_t)decimated_candidates.size(); ++i) {
+            decimated_candidates[i] = candidates[i * kDecimation];
+        }
+        const int32_t coarse = kDecimation * BestOffset(&decimated_target[0], &decimated_candidates[0],
+            (int32_t)decimated_target.size(), 0, 2 * kSearchFrames / kDecimation, 1);
+        const int32_t fine = BestOffset(&target[0], &candidates[0], kOverlapFrames,
+            nMath::Max(coarse - kDecimation + 1, 0), nMath::Min(coarse + kDecimation - 1, 2 * kSearchFrames), 1);
+        return search_start + fine;
+    }
+
+    void TimeStretcher::Reset(const double frame) {
+        std::fill(accumulator.begin(), accumulator.end(), 0.f);
+        grain_rate = rate;
+        // A primer grain a hop back so the first hop out is fully overlapped instead of fading in.
+        const int64_t start = static_cast<int64_t>(floor(frame));
+        AddGrain(start - kHopFrames);
+        ShiftHop();
+        nominal = frame;
+        AddGrain(start);
+        output_index = 0;
+    }
+
+    void TimeStretcher::Next(float& left, float& right) {
+        if (output_index == kHopFrames) {
+            ShiftHop();
+            nominal += kHopFrames * grain_rate;
+            grain_rate = rate;
+            AddGrain(FindGrain(nominal));
+            output_index = 0;
+        }
+        left = accumulator[2 * output_index];
+        right = accumulator[2 * output_index + 1];
+        ++output_index;
+    }
+}
@@ -0,0 +1,63 @@
+// MixScriptTimeStretch - key locked tempo change read straight from track memory
+// Author - Nic Taylor
+
+#pragma once
+#include <vector>
+#include <stdint.h>
+
+namespace MixScript
+{
+    // WSOLA on 16 bit interleaved PCM. Each grain is two hops of Hann window, placed within kSearchFrames of its
+    // nominal position where it best continues the previous grain. Buffers are sized in Prepare so Next never
+    // allocates.
+    class TimeStretcher {
+    public:
+        static constexpr int32_t kHopFrames = 512;
+        static constexpr int32_t kSearchFrames = 256;
+        static constexpr float kMinRate = 0.5f;
+        static constexpr float kMaxRate = 2.f;
+
+        TimeStretcher();
+
+        void Prepare(uint8_t const * const audio_start, uint8_t const * const audio_end, const uint32_t channels);
+        // Restarts output at a source frame.
+        void Reset(const double frame);
+        // Source frames consumed per output frame, applied from the next grain.
+        void SetRate(const float rate_);
+        float Rate() const { return rate; }
+
+        void Next(float& left, float& right);
+        // Source frame of the next output frame.
+        double Position() const { return nominal + output_index * grain_rate; }
+        template <class Ranges>
+        void WorkingMemory(Ranges& ranges) const {
+            for (const std::vector<float>* buffer : { &window, &accumulator, &target, &candidates, &decimated_target,
+                &decimated_candidates }) {
+                ranges.Add(*buffer);
+            }
+        }
+
+    private:
+        const int16_t* samples;
+        int64_t num_frames;
+        uint32_t channels;
+        float rate;
+        float grain_rate;
+        double nominal;
+        int64_t grain_start;
+        int32_t output_index;
+
+        std::vector<float> window;
+        std::vector<float> accumulator; // two hops of interleaved stereo
+        std::vector<float> target;
+        std::vector<float> candidates;
+        std::vector<float> decimated_target;
+        std::vector<float> decimated_candidates;
+
+        float Sample(const int64_t frame, const uint32_t channel) const;
+        float Mono(const int64_t frame) const;
+        void AddGrain(const int64_t start);
+        void ShiftHop();
+        int64_t FindGrain(const double grain_nominal);
+    };
+}
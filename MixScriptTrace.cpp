@@ -0,0 +1,155 @@
+// MixScriptTrace - scoped timing spans written as Chrome trace json
+// Author - Nic Taylor
+
+#include "MixScriptTrace.h"
+
+#ifdef MIXSCRIPT_TRACE
+#include "nMath.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace MixScript
+{
+    namespace {
+        constexpr uint32_t kTraceRingSize = 1 << 14; // events kept per thread
+
+        struct TraceEvent {
+            const char* name;
+            int64_t start;
+            int64_t duration;
+            uint32_t thread_id;
+        };
+
+        struct TraceRing {
+            std::atomic<uint64_t> written;
+            std::atomic<uint64_t> cleared; // events before this are not dumped
+            std::atomic_bool in_use;
+            uint32_t thread_id;
+            std::array<TraceEvent, kTraceRingSize> events;
+        };
+
+        // Rings outlive their threads so short lived analysis workers still show up in a dump. A ring released by
+        // an exited thread is reused by the next new one, its events keep the id of the thread that wrote them.
+        struct TraceRegistry {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<TraceRing>> rings;
+            uint32_t next_thread_id = 1;
+            const int64_t epoch = Clock();
+
+            static int64_t Clock() {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+        };
+
+        TraceRegistry& Registry() {
+            static TraceRegistry registry;
+            return registry;
+        }
+
+        int64_t Now() {
+            return TraceRegistry::Clock() - Registry().epoch;
+        }
+
+        struct ThreadRing {
+            TraceRing* ring = nullptr;
+
+            ~ThreadRing() {
+                if (ring != nullptr) {
+                    ring->in_use.store(false, std::memory_order_release);
+                }
+            }
+
+            TraceRing& Get() {
+                if (ring == nullptr) {
+                    TraceRegistry& registry = Registry();
+                    std::lock_guard<std::mutex> lock(registry.mutex);
+                    for (std::unique_ptr<TraceRing>& free_ring : registry.rings) {
+                        if (!free_ring->in_use.load(std::memory_order_acquire)) {
+                            ring = free_ring.get();
+                            break;
+                        }
+                    }
+                    if (ring == nullptr) {
+                        registry.rings.emplace_back(new TraceRing());
+                        ring = registry.rings.back().get();
+                        ring->written.store(0, std::memory_order_relaxed);
+                        ring->cleared.store(0, std::memory_order_relaxed);
+                    }
+                    ring->in_use.store(true, std::memory_order_relaxed);
+                    ring->thread_id = registry.next_thread_id++;
+                }
+                return *ring;
+            }
+        };
+
+        thread_local ThreadRing thread_ring;
+    }
+
+    TraceScope::TraceScope(const char* name_) : name(name_), start(Now()) {
+    }
+
+    TraceScope::~TraceScope() {
+        TraceRing& ring = thread_ring.Get();
+        const uint64_t index = ring.written.load(std::memory_order_relaxed);
+        ring.events[index & (kTraceRingSize - 1)] = { name, start, Now() - start, ring.thread_id };
+        ring.written.store(index + 1, std::memory_order_release);
+    }
+
+    bool DumpTrace(const char* file_path) {
+        std::vector<TraceEvent> events;
+        {
+            TraceRegistry& registry = Registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            for (const std::unique_ptr<TraceRing>& ring : registry.rings) {
+                const uint64_t end = ring->written.load(std::memory_order_acquire);
+                const uint64_t begin = nMath::Max(end > kTraceRingSize ? end - kTraceRingSize : 0,
+                    ring->cleared.load(std::memory_order_relaxed));
+                const size_t first = events.size();
+                for (uint64_t index = begin; index < end; ++index) {
+                    events.push_back(ring->events[index & (kTraceRingSize - 1)]);
+                }
+                // Threads keep writing during the copy, drop whatever may have been overwritten meanwhile. The
+                // event at written is written before the count moves, so its slot counts as overwritten too.
+                const uint64_t written = ring->written.load(std::memory_order_acquire);
+                if (written + 1 > begin + kTraceRingSize) {
+                    const uint64_t stale = nMath::Min(written + 1 - kTraceRingSize - begin, end - begin);
+                    events.erase(events.begin() + first, events.begin() + first + static_cast<size_t>(stale));
+                }
+            }
+        }
+
+        std::ofstream fs(file_path);
+        if (!fs.is_open()) {
+            return false;
+        }
+        fs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        fs.setf(std::ios::fixed);
+        fs.precision(3);
+        bool first = true;
+        for (const TraceEvent& event : events) {
+            fs << (first ? "\n" : ",\n");
+            first = false;
+            fs << "{\"name\":\"" << event.name << "\",\"cat\":\"mixscript\",\"ph\":\"X\",\"pid\":1,\"tid\":" <<
+                event.thread_id << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0 << "}";
+        }
+        fs << "\n]}\n";
+        return fs.good();
+    }
+
+    void ClearTrace() {
+        TraceRegistry& registry = Registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        // Only the owning thread writes the count, so clearing moves the start instead.
+        for (std::unique_ptr<TraceRing>& ring : registry.rings) {
+            ring->cleared.store(ring->written.load(std::memory_order_acquire), std::memory_order_relaxed);
+        }
+    }
+}
+#endif
@@ -0,0 +1,34 @@
+// MixScriptTrace - scoped timing spans written as Chrome trace json
+// Author - Nic Taylor
+
+#pragma once
+
+// Spans are only recorded when MIXSCRIPT_TRACE is defined for the project, otherwise the macros expand to nothing.
+#ifdef MIXSCRIPT_TRACE
+#include <stdint.h>
+
+namespace MixScript
+{
+    // Appends a complete event to the calling thread's ring when it goes out of scope. Only the name pointer is
+    // kept so it must be a string literal. No locks or allocation after the first span on a thread.
+    class TraceScope {
+    public:
+        explicit TraceScope(const char* name_);
+        ~TraceScope();
+
+    private:
+        const char* name;
+        int64_t start;
+    };
+
+    // Writes the spans still held by every thread's ring in the Chrome/Perfetto trace event format.
+    bool DumpTrace(const char* file_path);
+    void ClearTrace();
+}
+
+#define MS_TRACE_JOIN_(a, b) a##b
+#define MS_TRACE_JOIN(a, b) MS_TRACE_JOIN_(a, b)
+#define MS_TRACE_SCOPE(name) MixScript::TraceScope MS_TRACE_JOIN(trace_scope_, __LINE__)(name)
+#else
+#define MS_TRACE_SCOPE(name)
+#endif
@@ -0,0 +1,305 @@
+// MixScriptBenchmark - timings of the mixer hot paths on synthetic tracks
+// Author - Nic Taylor
+
+// Console tool built from this file and the core sources, everything but Main, MainComponent and
+// TrackControlsComponent. Prints one json object per line for each benchmark so runs can be stored per commit and
+// compared.
+//
+// MixScriptBenchmark [--filter text] [--label commit] [--min-time seconds] [--out file]
+
+#include "../MixScriptAnalysis.h"
+#include "../MixScriptMixer.h"
+#include "../WavAudioBuffer.h"
+#include "../nFilters.h"
+#include "../nMath.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr uint32_t kSampleRate = 44100;
+    constexpr float kBpm = 120.f;
+    constexpr int32_t kBlockSize = 512;
+    constexpr uint32_t kFramesPerBeat = static_cast<uint32_t>(kSampleRate * 60.f / kBpm);
+
+    struct Options {
+        std::string filter;
+        std::string label;
+        double min_time = 0.5;
+        std::string out_path;
+    };
+
+    // Keeps results alive so the optimiser cannot drop the work.
+    volatile float sink = 0.f;
+
+    // A kick on every beat over a detuned pad, deterministic for a given seed. Cues are placed on every bar.
+    std::unique_ptr<MixScript::WaveAudioSource> SyntheticTrack(const float seconds, const uint32_t seed) {
+        const uint32_t num_frames = static_cast<uint32_t>(seconds * kSampleRate);
+        const uint32_t num_bytes = num_frames * 4;
+        const uint32_t padding = 4;
+        uint8_t* samples = new uint8_t[num_bytes + padding]();
+        int16_t* pcm = reinterpret_cast<int16_t*>(samples);
+        uint32_t noise = seed;
+        const float pad_hz = 110.f * (1.f + 0.05f * (seed % 7));
+        for (uint32_t frame = 0; frame < num_frames; ++frame) {
+            const float t = frame / static_cast<float>(kSampleRate);
+            const float beat_t = (frame % kFramesPerBeat) / static_cast<float>(kSampleRate);
+            const float kick = expf(-beat_t * 30.f) * sinf(2.f * (float)M_PI * 55.f * beat_t);
+            noise = noise * 1664525u + 1013904223u;
+            const float hiss = 0.02f * ((noise >> 9) / static_cast<float>(1 << 23) - 1.f);
+            const float pad = 0.15f * (sinf(2.f * (float)M_PI * pad_hz * t) + sinf(2.f * (float)M_PI * 1.01f * pad_hz * t));
+            pcm[2 * frame] = static_cast<int16_t>(nMath::Clamp(0.6f * kick + pad + hiss, -1.f, 1.f) * 32767.f);
+            pcm[2 * frame + 1] = static_cast<int16_t>(nMath::Clamp(0.6f * kick + pad - hiss, -1.f, 1.f) * 32767.f);
+        }
+
+        std::vector<uint32_t> cues;
+        for (uint32_t frame = 0; frame < num_frames; frame += 4 * kFramesPerBeat) {
+            cues.push_back(frame);
+        }
+        MixScript::WaveAudioBuffer* buffer = new MixScript::WaveAudioBuffer(samples, num_bytes);
+        const MixScript::WaveAudioFormat format = { 2, kSampleRate, 16 };
+        return std::unique_ptr<MixScript::WaveAudioSource>(new MixScript::WaveAudioSource("", format, buffer,
+            MixScript::AudioRegion{ samples, samples + num_bytes }, cues));
+    }
+
+    // Spreads num_movements evenly over the track, alternating gain so every interval interpolates.
+    void AddMovements(MixScript::MixerControl& control, const MixScript::WaveAudioSource& source,
+        const uint32_t num_movements) {
+        const int64_t num_frames = (source.audio_end - source.audio_start) / 4;
+        for (uint32_t i = 0; i < num_movements; ++i) {
+            const int64_t frame = num_frames * i / num_movements;
+            control.Add(MixScript::GainControl{ i % 2 ? 0.5f : 1.f }, source.audio_start + 4 * frame);
+        }
+    }
+
+    class Runner {
+    public:
+        explicit Runner(const Options& options_) : options(options_), out(nullptr) {
+            if (!options.out_path.empty()) {
+                file.open(options.out_path);
+            }
+            out = file.is_open() ? &file : &std::cout;
+        }
+
+        // run performs items_per_batch items of work per call. Iterations grow until a run takes min_time.
+        void Run(const std::string& name, const uint64_t items_per_batch, const std::function<void()>& run) {
+            if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+                return;
+            }
+            run(); // warm up
+            uint64_t iterations = 1;
+            double elapsed = 0.0;
+            while (true) {
+                const auto start = std::chrono::steady_clock::now();
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    run();
+                }
+                elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                if (elapsed >= options.min_time || iterations >= (1ull << 30)) {
+                    break;
+                }
+                iterations *= elapsed > 0.0 ? nMath::Clamp<uint64_t>(
+                    static_cast<uint64_t>(1.4 * options.min_time / elapsed), 2, 100) : 100;
+            }
+            const double items = static_cast<double>(iterations * items_per_batch);
+            *out << "{\"label\":\"" << options.label << "\",\"name\":\"" << name << "\",\"iterations\":" <<
+                iterations << ",\"items\":" << iterations * items_per_batch << ",\"seconds\":" << elapsed <<
+                ",\"ns_per_item\":" << 1e9 * elapsed / items << ",\"items_per_second\":" << items / elapsed << "}" <<
+                std::endl;
+        }
+
+    private:
+        const Options& options;
+        std::ofstream file;
+        std::ostream* out;
+    };
+
+    void BenchmarkSource(Runner& runner) {
+        std::unique_ptr<MixScript::WaveAudioSource> source = SyntheticTrack(30.f, 1);
+        const uint32_t kFrames = 1 << 16;
+
+        runner.Run("WaveAudioSource::Read", 2 * kFrames, [&source, kFrames]() {
+            float sum = 0.f;
+            for (uint32_t i = 0; i < 2 * kFrames; ++i) {
+                if (source->read_pos >= source->audio_end) {
+                    source->read_pos = source->audio_start;
+                }
+                sum += source->Read();
+            }
+            sink = sum;
+        });
+
+        for (const uint32_t num_movements : { 1u, 16u, 256u, 4096u }) {
+            std::unique_ptr<MixScript::WaveAudioSource> processed = SyntheticTrack(30.f, 1);
+            processed->SetMixSampleRate(kSampleRate);
+            AddMovements(processed->fader_control, *processed, num_movements);
+            AddMovements(processed->gain_control, *processed, num_movements);
+            MixScript::WaveAudioSource& deck = *processed;
+            runner.Run("WaveAudioSource::ReadAndProcess/movements:" + std::to_string(num_movements), kFrames,
+                [&deck, kFrames]() {
+                float sum = 0.f;
+                for (uint32_t i = 0; i < kFrames; ++i) {
+                    if (deck.read_pos >= deck.audio_end) {
+                        MixScript::ResetToPos(deck, deck.audio_start);
+                    }
+                    sum += deck.ReadAndProcess(0);
+                    sum += deck.ReadAndProcess(1);
+                }
+                sink = sum;
+            });
+        }
+    }
+
+    void BenchmarkControls(Runner& runner) {
+        std::unique_ptr<MixScript::WaveAudioSource> source = SyntheticTrack(30.f, 1);
+        const uint32_t kLookups = 1 << 14;
+        std::vector<const uint8_t*> positions(kLookups);
+        const int64_t num_frames = (source->audio_end - source->audio_start) / 4;
+        uint32_t state = 12345;
+        for (const uint8_t*& position : positions) {
+            state = state * 1664525u + 1013904223u;
+            position = source->audio_start + 4 * (state % num_frames);
+        }
+
+        for (const uint32_t num_movements : { 1u, 16u, 256u, 4096u }) {
+            MixScript::MixerControl control;
+            AddMovements(control, *source, num_movements);
+            runner.Run("MixerControl::GetInterpolation/movements:" + std::to_string(num_movements), kLookups,
+                [&control, &positions]() {
+                float sum = 0.f;
+                for (const uint8_t* position : positions) {
+                    sum += control.GetInterpolation(position).ratio;
+                }
+                sink = sum;
+            });
+            runner.Run("MixerControl::ValueAt/movements:" + std::to_string(num_movements), kLookups,
+                [&control, &positions]() {
+                float sum = 0.f;
+                for (const uint8_t* position : positions) {
+                    sum += control.ValueAt(position);
+                }
+                sink = sum;
+            });
+        }
+    }
+
+    void BenchmarkFilters(Runner& runner) {
+        const uint32_t kSamples = 1 << 16;
+        std::vector<float> input(kSamples);
+        for (uint32_t i = 0; i < kSamples; ++i) {
+            input[i] = sinf(0.01f * i) + 0.25f * sinf(0.3f * i);
+        }
+        const nMath::TwoPoleFilterParams params = nMath::TwoPoleButterworthLowShelfConfig(
+            200.f / kSampleRate, -6.f);
+        nMath::TwoPoleFilter filter;
+        runner.Run("TwoPoleFilter::Apply", kSamples, [&filter, &params, &input]() {
+            float sum = 0.f;
+            for (const float x : input) {
+                sum += filter.Apply(params, x);
+            }
+            sink = sum;
+        });
+    }
+
+    void BenchmarkMix(Runner& runner) {
+        std::vector<float> left(kBlockSize);
+        std::vector<float> right(kBlockSize);
+        const auto mix_block = [&left, &right](MixScript::Mixer& mixer) {
+            // Loop from the start rather than timing silence once a deck runs out.
+            for (const MixScript::WaveAudioSource* deck : { mixer.Playing(), mixer.Incoming() }) {
+                if (deck->read_pos + 4 * kBlockSize >= deck->audio_end) {
+                    mixer.ResetToCue(0);
+                }
+            }
+            MixScript::FloatOutputWriter writer = { &left[0], &right[0] };
+            mixer.MixOutput(writer, kBlockSize);
+            sink = left[0] + right[kBlockSize - 1];
+        };
+
+        for (const int32_t solo_deck : { 0, 1, -1 }) {
+            MixScript::Mixer mixer;
+            mixer.LoadPlaying(SyntheticTrack(120.f, 1));
+            mixer.LoadIncoming(SyntheticTrack(120.f, 2));
+            mixer.PrepareOutput(kSampleRate, kBlockSize);
+            if (solo_deck >= 0) {
+                mixer.HandleAction(MixScript::SourceActionInfo(MixScript::SA_SOLO, 0, solo_deck));
+            }
+            mixer.ProcessActions();
+            const std::string name = solo_deck < 0 ? "Mixer::Mix/sync" :
+                solo_deck == 0 ? "Mixer::Mix/solo_playing" : "Mixer::Mix/solo_incoming";
+            runner.Run(name, kBlockSize, [&mixer, &mix_block]() {
+                mix_block(mixer);
+            });
+        }
+    }
+
+    void BenchmarkPeaks(Runner& runner) {
+        std::unique_ptr<MixScript::WaveAudioSource> source = SyntheticTrack(300.f, 1);
+        const uint32_t kPixelWidth = 1600;
+        // A loaded deck has its pyramid from the load analysis, the scan is the fallback without one.
+        for (const bool pyramid : { false, true }) {
+            if (pyramid) {
+                MixScript::ComputePeakPyramid(*source, source->peak_pyramid);
+            }
+            const std::string name = pyramid ? "ComputeWavePeaks/pyramid/zoom:" : "ComputeWavePeaks/scan/zoom:";
+            for (int zoom_factor = 0; zoom_factor <= 20; ++zoom_factor) {
+                MixScript::WavePeaks peaks;
+                runner.Run(name + std::to_string(zoom_factor), kPixelWidth,
+                    [&source, &peaks, kPixelWidth, zoom_factor]() {
+                    sink = *MixScript::ComputeWavePeaks(*source, kPixelWidth, peaks, zoom_factor);
+                });
+            }
+        }
+    }
+
+    void BenchmarkRender(Runner& runner) {
+        MixScript::Mixer mixer;
+        mixer.LoadPlaying(SyntheticTrack(30.f, 1));
+        mixer.LoadIncoming(SyntheticTrack(30.f, 2));
+        const uint32_t render_frames = 30 * kSampleRate;
+        runner.Run("Mixer::Render", render_frames, [&mixer]() {
+            std::unique_ptr<MixScript::WaveAudioSource> output(mixer.Render());
+            sink = output->integrated_lufs;
+            delete[] output->buffer->samples;
+        });
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string arg = argv[i];
+        if (arg == "--filter") {
+            options.filter = argv[i + 1];
+        }
+        else if (arg == "--label") {
+            options.label = argv[i + 1];
+        }
+        else if (arg == "--min-time") {
+            options.min_time = atof(argv[i + 1]);
+        }
+        else if (arg == "--out") {
+            options.out_path = argv[i + 1];
+        }
+        else {
+            std::cerr << "Unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    Runner runner(options);
+    BenchmarkSource(runner);
+    BenchmarkControls(runner);
+    BenchmarkFilters(runner);
+    BenchmarkMix(runner);
+    BenchmarkPeaks(runner);
+    BenchmarkRender(runner);
+    return 0;
+}
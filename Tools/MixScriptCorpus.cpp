@@ -0,0 +1,364 @@
+// MixScriptCorpus - deterministic wav files and projects for perf and correctness runs
+// Author - Nic Taylor
+
+// Console tool, needs no other sources. Writes into an existing directory:
+//   click_<bpm>_<rate>_<bits>.wav  accented clicks at a known tempo over a noise floor, cue chunk every 16 bars
+//   noise_<rate>.wav               white noise
+//   sweep_<rate>.wav               exponential sine sweep from 20 Hz
+//   mix_<rate>.mix, mix_cross_rate.mix
+//                                  projects pairing the click tracks with implied markers on every bar and dense
+//                                  automation on every recorded control
+//   corpus.txt                     what was written and the tempo of each click track
+//
+// MixScriptCorpus <out_dir> [--seconds 180] [--movements 4000] [--seed 1]
+
+#include "../MixScriptAction.h"
+#include "../WavAudioSource.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr uint32_t kChannels = 2;
+    constexpr uint32_t kBeatsPerBar = 4;
+    constexpr uint32_t kBarsPerCue = 16;
+    constexpr float kSignalSeconds = 30.f; // noise and sweep length
+    // LoadWaveFile reads at most 10 minutes of 48 kHz 16 bit stereo.
+    constexpr double kMaxFileBytes = 10.0 * 60.0 * 48000.0 * 4.0;
+
+    struct Random {
+        uint32_t state;
+
+        explicit Random(const uint32_t seed) : state(seed * 2654435761u + 1u) {}
+
+        uint32_t Next() {
+            state = state * 1664525u + 1013904223u;
+            return state;
+        }
+        // [0, 1)
+        float Uniform() {
+            return (Next() >> 8) / static_cast<float>(1 << 24);
+        }
+        float Range(const float low, const float high) {
+            return low + (high - low) * Uniform();
+        }
+    };
+
+    struct TrackInfo {
+        std::string name;
+        std::string kind;
+        uint32_t sample_rate;
+        uint32_t bits;
+        uint32_t num_frames;
+        float bpm; // 0 without a tempo
+    };
+
+    void WriteU32(std::ofstream& fs, const uint32_t value) {
+        fs.write(reinterpret_cast<const char*>(&value), 4);
+    }
+
+    void WriteU16(std::ofstream& fs, const uint16_t value) {
+        fs.write(reinterpret_cast<const char*>(&value), 2);
+    }
+
+    void WriteTag(std::ofstream& fs, const char* tag) {
+        fs.write(tag, 4);
+    }
+
+    // PCM wav in the chunk layout ParseWaveFile reads: fmt, cue then data. cue_frames must be increasing.
+    // signal(frame, channel) returns -1 to 1.
+    bool WriteWave(const std::string& path, const uint32_t sample_rate, const uint32_t bits, const uint32_t num_frames,
+        const std::vector<uint32_t>& cue_frames, const std::function<float(uint32_t, uint32_t)>& signal) {
+        std::ofstream fs(path, std::ios::binary);
+        if (!fs.is_open()) {
+            return false;
+        }
+        const uint32_t block_align = kChannels * bits / 8;
+        const uint32_t data_size = num_frames * block_align;
+        const uint32_t cue_size = 4 + 24 * static_cast<uint32_t>(cue_frames.size());
+        WriteTag(fs, "RIFF");
+        WriteU32(fs, 4 + (8 + 16) + (8 + cue_size) + (8 + data_size));
+        WriteTag(fs, "WAVE");
+
+        WriteTag(fs, "fmt ");
+        WriteU32(fs, 16);
+        WriteU16(fs, 1); // PCM
+        WriteU16(fs, static_cast<uint16_t>(kChannels));
+        WriteU32(fs, sample_rate);
+        WriteU32(fs, sample_rate * block_align);
+        WriteU16(fs, static_cast<uint16_t>(block_align));
+        WriteU16(fs, static_cast<uint16_t>(bits));
+
+        WriteTag(fs, "cue ");
+        WriteU32(fs, cue_size);
+        WriteU32(fs, static_cast<uint32_t>(cue_frames.size()));
+        for (uint32_t i = 0; i < cue_frames.size(); ++i) {
+            WriteU32(fs, i + 1); // id
+            WriteU32(fs, cue_frames[i]); // play order position
+            WriteTag(fs, "data");
+            WriteU32(fs, 0); // chunk start
+            WriteU32(fs, 0); // block start
+            WriteU32(fs, cue_frames[i]); // sample offset
+        }
+
+        WriteTag(fs, "data");
+        WriteU32(fs, data_size);
+        const float scale = bits == 24 ? 8388607.f : 32767.f;
+        std::vector<uint8_t> block;
+        block.reserve(4096 * block_align);
+        for (uint32_t frame = 0; frame < num_frames; ++frame) {
+            for (uint32_t channel = 0; channel < kChannels; ++channel) {
+                const float value = std::min(std::max(signal(frame, channel), -1.f), 1.f);
+                const int32_t sample = static_cast<int32_t>(lrintf(value * scale));
+                block.push_back(static_cast<uint8_t>(sample));
+                block.push_back(static_cast<uint8_t>(sample >> 8));
+                if (bits == 24) {
+                    block.push_back(static_cast<uint8_t>(sample >> 16));
+                }
+            }
+            if (block.size() >= 4096 * block_align) {
+                fs.write(reinterpret_cast<const char*>(&block[0]), block.size());
+                block.clear();
+            }
+        }
+        if (!block.empty()) {
+            fs.write(reinterpret_cast<const char*>(&block[0]), block.size());
+        }
+        return fs.good();
+    }
+
+    uint32_t FramesPerBeat(const TrackInfo& track) {
+        return static_cast<uint32_t>(roundf(track.sample_rate * 60.f / track.bpm));
+    }
+
+    bool WriteClickTrack(const std::string& dir, const TrackInfo& track, const uint32_t seed) {
+        const uint32_t frames_per_beat = FramesPerBeat(track);
+        std::vector<uint32_t> cues;
+        for (uint32_t frame = 0; frame < track.num_frames; frame += kBarsPerCue * kBeatsPerBar * frames_per_beat) {
+            cues.push_back(frame);
+        }
+        const uint32_t click_frames = track.sample_rate / 100; // 10 ms
+        Random random(seed);
+        return WriteWave(dir + "/" + track.name, track.sample_rate, track.bits, track.num_frames, cues,
+            [&track, &random, frames_per_beat, click_frames](const uint32_t frame, const uint32_t channel) {
+            const uint32_t beat = frame / frames_per_beat;
+            const uint32_t offset = frame - beat * frames_per_beat;
+            float value = 0.02f * (2.f * random.Uniform() - 1.f);
+            if (offset < click_frames) {
+                const float hz = beat % kBeatsPerBar == 0 ? 2000.f : 1000.f;
+                const float t = offset / static_cast<float>(track.sample_rate);
+                value += 0.7f * expf(-t * 400.f) * sinf(2.f * (float)M_PI * hz * t);
+            }
+            return channel == 0 ? value : 0.9f * value;
+        });
+    }
+
+    bool WriteNoise(const std::string& dir, const TrackInfo& track, const uint32_t seed) {
+        Random random(seed);
+        return WriteWave(dir + "/" + track.name, track.sample_rate, track.bits, track.num_frames, {},
+            [&random](const uint32_t, const uint32_t) {
+            return 0.25f * (2.f * random.Uniform() - 1.f);
+        });
+    }
+
+    bool WriteSweep(const std::string& dir, const TrackInfo& track) {
+        const double f0 = 20.0;
+        const double f1 = std::min(20000.0, 0.45 * track.sample_rate);
+        const double duration = track.num_frames / static_cast<double>(track.sample_rate);
+        const double k = log(f1 / f0);
+        return WriteWave(dir + "/" + track.name, track.sample_rate, track.bits, track.num_frames, {},
+            [&track, f0, k, duration](const uint32_t frame, const uint32_t) {
+            const double t = frame / static_cast<double>(track.sample_rate);
+            const double phase = 2.0 * M_PI * f0 * duration / k * (exp(t * k / duration) - 1.0);
+            return static_cast<float>(0.5 * sin(phase));
+        });
+    }
+
+    struct ControlSpec {
+        MixScript::SourceAction action;
+        float share; // of the movements per deck
+        float low;
+        float high;
+    };
+
+    // Value ranges follow what the actions can write.
+    const ControlSpec kControls[] = {
+        { MixScript::SA_MULTIPLY_FADER_GAIN, 0.3f, 0.f, 1.f },
+        { MixScript::SA_MULTIPLY_TRACK_GAIN, 0.1f, 0.25f, 2.f },
+        { MixScript::SA_MULTIPLY_LP_SHELF_GAIN, 0.1f, 0.063f, 2.f },
+        { MixScript::SA_MULTIPLY_HP_SHELF_GAIN, 0.1f, 0.063f, 2.f },
+        { MixScript::SA_MULTIPLY_LOW_GAIN, 0.05f, 0.f, 2.f },
+        { MixScript::SA_MULTIPLY_MID_GAIN, 0.05f, 0.f, 2.f },
+        { MixScript::SA_MULTIPLY_HIGH_GAIN, 0.05f, 0.f, 2.f },
+        { MixScript::SA_SWEEP_FILTER, 0.1f, 0.f, 2.f },
+        { MixScript::SA_MULTIPLY_CONVOLUTION_SEND, 0.05f, 0.f, 1.f },
+        { MixScript::SA_MULTIPLY_DELAY_SEND, 0.05f, 0.f, 1.f },
+        { MixScript::SA_DELAY_FEEDBACK, 0.05f, 0.f, 0.9f },
+    };
+
+    // Same block layout as Mixer::Save, positions are bytes into the 16 bit audio the mixer holds.
+    void WriteProjectSource(std::ofstream& fs, const TrackInfo& track, const uint32_t num_movements, Random& random) {
+        const int64_t bytes_per_frame = kChannels * 2;
+        const uint32_t frames_per_beat = FramesPerBeat(track);
+        const uint32_t frames_per_bar = kBeatsPerBar * frames_per_beat;
+        fs << "audio_source {\n";
+        for (uint32_t bar = 0; bar * frames_per_bar < track.num_frames; ++bar) {
+            // The cue chunk markers stay default markers, the bars between are implied.
+            const MixScript::CueType type = bar % kBarsPerCue == 0 ? (bar == 0 ? MixScript::CT_LEFT_RIGHT :
+                MixScript::CT_DEFAULT) : MixScript::CT_IMPLIED;
+            fs << "cues {\n";
+            fs << "  pos: " << bar * frames_per_bar * bytes_per_frame << "\n";
+            fs << "  type: " << static_cast<int32_t>(type) << "\n";
+            fs << "}\n";
+        }
+        for (const ControlSpec& control : kControls) {
+            const uint32_t count = std::max(1u, static_cast<uint32_t>(control.share * num_movements));
+            std::vector<uint32_t> frames(count);
+            for (uint32_t& frame : frames) {
+                frame = random.Next() % track.num_frames;
+            }
+            frames[0] = 0; // every control starts defined
+            std::sort(frames.begin(), frames.end());
+            for (const uint32_t frame : frames) {
+                // Mostly recorded style points, some with a threshold like the marker edits. Only linear fades,
+                // the other fade types are not written by the mixer and do not handle falling values.
+                const float threshold = random.Uniform() < 0.2f ? random.Range(0.1f, 0.9f) : 0.f;
+                fs << "movements {\n";
+                fs << "  action: " << static_cast<int32_t>(control.action) << "\n";
+                fs << "  pos: " << frame * bytes_per_frame << "\n";
+                fs << "  value: " << random.Range(control.low, control.high) << "\n";
+                fs << "  type: " << static_cast<int32_t>(MixScript::MFT_LINEAR) << "\n";
+                fs << "  threshold: " << threshold << "\n";
+                fs << "  transition: 0\n";
+                fs << "}\n";
+            }
+        }
+        fs << "}\n";
+    }
+
+    bool WriteProject(const std::string& dir, const std::string& name, const TrackInfo& playing,
+        const TrackInfo& incoming, const uint32_t num_movements, const uint32_t seed) {
+        std::ofstream fs(dir + "/" + name);
+        if (!fs.is_open()) {
+            return false;
+        }
+        Random random(seed);
+        fs << "Playing: " << dir << "/" << playing.name << "\n";
+        fs << "Incoming: " << dir << "/" << incoming.name << "\n";
+        fs << "mix_sync {\n";
+        const uint32_t playing_bars = (playing.num_frames + kBeatsPerBar * FramesPerBeat(playing) - 1) /
+            (kBeatsPerBar * FramesPerBeat(playing));
+        fs << "  playing_cue_id: " << std::min(1 + kBarsPerCue, playing_bars) << "\n";
+        fs << "  incoming_cue_id: 1\n";
+        fs << "}\n";
+        WriteProjectSource(fs, playing, num_movements, random);
+        WriteProjectSource(fs, incoming, num_movements, random);
+        return fs.good();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "MixScriptCorpus <out_dir> [--seconds 180] [--movements 4000] [--seed 1]" << std::endl;
+        return 1;
+    }
+    const std::string dir = argv[1];
+    float seconds = 180.f;
+    uint32_t num_movements = 4000;
+    uint32_t seed = 1;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        const std::string arg = argv[i];
+        if (arg == "--seconds") {
+            seconds = static_cast<float>(atof(argv[i + 1]));
+        }
+        else if (arg == "--movements") {
+            num_movements = static_cast<uint32_t>(atoi(argv[i + 1]));
+        }
+        else if (arg == "--seed") {
+            seed = static_cast<uint32_t>(atoi(argv[i + 1]));
+        }
+        else {
+            std::cerr << "Unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<TrackInfo> tracks;
+    const uint32_t sample_rates[] = { 44100, 48000, 96000 };
+    float bpm = 120.f;
+    for (const uint32_t sample_rate : sample_rates) {
+        for (const uint32_t bits : { 16u, 24u }) {
+            const uint32_t max_frames = static_cast<uint32_t>(kMaxFileBytes / (kChannels * bits / 8));
+            const uint32_t num_frames = std::min(static_cast<uint32_t>(seconds * sample_rate), max_frames);
+            const std::string name = "click_" + std::to_string(static_cast<int>(bpm)) + "_" +
+                std::to_string(sample_rate) + "_" + std::to_string(bits) + ".wav";
+            // Whole frames per beat, so the tempo written is the one the frames give.
+            const float frames_per_beat = roundf(sample_rate * 60.f / bpm);
+            tracks.push_back({ name, "click", sample_rate, bits, num_frames, sample_rate * 60.f / frames_per_beat });
+            bpm += 2.f;
+        }
+        const uint32_t signal_frames = static_cast<uint32_t>(kSignalSeconds * sample_rate);
+        tracks.push_back({ "noise_" + std::to_string(sample_rate) + ".wav", "noise", sample_rate, 16, signal_frames,
+            0.f });
+        tracks.push_back({ "sweep_" + std::to_string(sample_rate) + ".wav", "sweep", sample_rate, 16, signal_frames,
+            0.f });
+    }
+
+    uint32_t track_seed = seed;
+    for (TrackInfo& track : tracks) {
+        bool written = false;
+        if (track.kind == "click") {
+            written = WriteClickTrack(dir, track, ++track_seed);
+        }
+        else if (track.kind == "noise") {
+            written = WriteNoise(dir, track, ++track_seed);
+        }
+        else {
+            written = WriteSweep(dir, track);
+        }
+        if (!written) {
+            std::cerr << "Failed to write " << dir << "/" << track.name << std::endl;
+            return 1;
+        }
+        std::cout << track.name << std::endl;
+    }
+
+    // Click tracks are laid out 16 bit then 24 bit per rate, with the noise and sweep after.
+    const auto click = [&tracks](const size_t rate_index, const size_t bits_index) -> const TrackInfo& {
+        return tracks[rate_index * 4 + bits_index];
+    };
+    bool written = true;
+    for (size_t rate_index = 0; rate_index < 3; ++rate_index) {
+        const std::string name = "mix_" + std::to_string(sample_rates[rate_index]) + ".mix";
+        written = written && WriteProject(dir, name, click(rate_index, 0), click(rate_index, 1), num_movements,
+            seed + static_cast<uint32_t>(rate_index));
+    }
+    written = written && WriteProject(dir, "mix_cross_rate.mix", click(0, 0), click(1, 0), num_movements, seed + 3);
+    if (!written) {
+        std::cerr << "Failed to write projects to " << dir << std::endl;
+        return 1;
+    }
+
+    std::ofstream fs(dir + "/corpus.txt");
+    fs << "seed: " << seed << "\n";
+    fs << "movements_per_deck: " << num_movements << "\n";
+    for (const TrackInfo& track : tracks) {
+        fs << "track {\n";
+        fs << "  name: " << track.name << "\n";
+        fs << "  kind: " << track.kind << "\n";
+        fs << "  sample_rate: " << track.sample_rate << "\n";
+        fs << "  bits: " << track.bits << "\n";
+        fs << "  frames: " << track.num_frames << "\n";
+        if (track.bpm > 0.f) {
+            fs << "  bpm: " << track.bpm << "\n";
+        }
+        fs << "}\n";
+    }
+    return fs.good() ? 0 : 1;
+}
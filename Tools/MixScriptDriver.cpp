@@ -0,0 +1,261 @@
+// MixScriptDriver - headless audio device that drives the mixer callback in real time
+// Author - Nic Taylor
+
+// Console tool built from this file and the core sources, everything but Main, MainComponent and
+// TrackControlsComponent. Stands in for the JUCE device: a device thread calls Mixer::AudioCallback, the same path as
+// MainComponent::getNextAudioBlock, once per block at the wall clock period of the device rate. A second thread acts
+// as the UI and writes bursts of control actions through Mixer::HandleAction while it plays. The output can be
+// written to a wav file. --harden turns on Mixer::SetRealtimeHardening before playback and counts page faults taken
+// inside the callback.
+//
+// Prints one json object with the deadline results and the mixer's callback stats. A deadline missed only because
+// the thread woke late is counted apart, that is the machine rather than the mixer. Exits non-zero when more than
+// --max-missed of the others are missed.
+//
+// MixScriptDriver [--rate 48000] [--block 256] [--seconds 10] [--burst 32] [--burst-interval 0.1] [--live-record]
+//     [--harden] [--max-missed 0] [--out file.wav] [--label commit] project.mix
+
+#include "../MixScriptMixer.h"
+#include "../WavAudioBuffer.h"
+#include "../nMath.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Waits that close to the deadline spin instead of sleeping, the scheduler overshoots by about this much.
+    constexpr std::chrono::microseconds kSpinMargin(200);
+
+    struct Options {
+        double sample_rate = 48000.0;
+        int32_t block_size = 256;
+        double seconds = 10.0;
+        uint32_t burst_size = 32;
+        double burst_interval = 0.1;
+        bool live_record = false;
+        bool harden = false;
+        uint64_t max_missed = 0;
+        std::string out_path;
+        std::string label;
+    };
+
+    struct DeviceResult {
+        uint64_t callbacks = 0;
+        uint64_t missed_deadlines = 0; // finished after the start of the next period
+        uint64_t late_wake_misses = 0; // missed but would have been on time if started on time
+        int64_t max_wake_late = 0; // nanoseconds from the scheduled start to the callback
+        std::vector<int64_t> callback_times;
+    };
+
+    void WaitUntil(const Clock::time_point deadline) {
+        if (Clock::now() + kSpinMargin < deadline) {
+            std::this_thread::sleep_until(deadline - kSpinMargin);
+        }
+        while (Clock::now() < deadline) {
+        }
+    }
+
+    // Nudges of the controls a hand on the deck would make, every one is real-time work in ProcessActions.
+    void SendBurst(MixScript::Mixer& mixer, const uint32_t burst_size, uint32_t& action_index) {
+        static constexpr std::array<MixScript::SourceAction, 4> kBurstActions = { MixScript::SA_MULTIPLY_TRACK_GAIN,
+            MixScript::SA_MULTIPLY_LOW_GAIN, MixScript::SA_SWEEP_FILTER, MixScript::SA_MULTIPLY_DELAY_SEND };
+        for (uint32_t i = 0; i < burst_size; ++i, ++action_index) {
+            const MixScript::SourceAction action = kBurstActions[action_index % kBurstActions.size()];
+            // Swings down then back up so the controls stay in range.
+            const float step = (action_index / 64) % 2 ? 0.5f : -0.5f;
+            const int target = (action_index / kBurstActions.size()) % 2;
+            mixer.HandleAction(MixScript::SourceActionInfo(action, step, target));
+        }
+    }
+
+    // The device thread. Blocks keep their schedule when a callback runs late, like a device pulling from a ring
+    // it has already fallen behind on.
+    void RunDevice(MixScript::Mixer& mixer, const Options& options, const uint32_t num_callbacks, int16_t* out_pcm,
+        std::atomic_bool& running, DeviceResult& result) {
+        std::vector<float> left(options.block_size);
+        std::vector<float> right(options.block_size);
+        const std::chrono::nanoseconds period(static_cast<int64_t>(1e9 * options.block_size / options.sample_rate));
+
+        const Clock::time_point start = Clock::now() + period;
+        for (uint32_t callback = 0; callback < num_callbacks; ++callback) {
+            const Clock::time_point scheduled = start + period * callback;
+            WaitUntil(scheduled);
+            const Clock::time_point begin = Clock::now();
+
+            std::fill(left.begin(), left.end(), 0.f);
+            std::fill(right.begin(), right.end(), 0.f);
+            MixScript::FloatOutputWriter output_writer = { left.data(), right.data() };
+            mixer.AudioCallback(output_writer, options.block_size, 0, false);
+
+            const Clock::time_point end = Clock::now();
+            result.callback_times[callback] = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+            result.max_wake_late = nMath::Max(result.max_wake_late,
+                static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(begin - scheduled).count()));
+            if (end > scheduled + period) {
+                ++result.missed_deadlines;
+                if (end - begin <= period) {
+                    ++result.late_wake_misses;
+                }
+            }
+            ++result.callbacks;
+
+            if (out_pcm != nullptr) {
+                int16_t* frame = out_pcm + 2 * static_cast<size_t>(callback) * options.block_size;
+                for (int32_t i = 0; i < options.block_size; ++i) {
+                    frame[2 * i] = static_cast<int16_t>(nMath::Clamp(left[i], -1.f, 1.f) * 32767.f);
+                    frame[2 * i + 1] = static_cast<int16_t>(nMath::Clamp(right[i], -1.f, 1.f) * 32767.f);
+                }
+            }
+        }
+        running = false;
+    }
+
+    bool WriteOutput(const Options& options, uint8_t* samples, const uint32_t num_bytes) {
+        MixScript::WaveAudioBuffer* buffer = new MixScript::WaveAudioBuffer(samples, num_bytes);
+        const MixScript::WaveAudioFormat format = { 2, static_cast<uint32_t>(options.sample_rate), 16 };
+        std::unique_ptr<MixScript::WaveAudioSource> output(new MixScript::WaveAudioSource("", format, buffer,
+            MixScript::AudioRegion{ samples, samples + num_bytes }, std::vector<uint32_t>()));
+        return MixScript::WriteWaveFile(options.out_path.c_str(), output);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    const char* project_path = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--live-record") {
+            options.live_record = true;
+        }
+        else if (arg == "--harden") {
+            options.harden = true;
+        }
+        else if (arg.compare(0, 2, "--") == 0 && i + 1 < argc) {
+            const char* value = argv[++i];
+            if (arg == "--rate") {
+                options.sample_rate = atof(value);
+            }
+            else if (arg == "--block") {
+                options.block_size = atoi(value);
+            }
+            else if (arg == "--seconds") {
+                options.seconds = atof(value);
+            }
+            else if (arg == "--burst") {
+                options.burst_size = static_cast<uint32_t>(atoi(value));
+            }
+            else if (arg == "--burst-interval") {
+                options.burst_interval = atof(value);
+            }
+            else if (arg == "--max-missed") {
+                options.max_missed = static_cast<uint64_t>(atoll(value));
+            }
+            else if (arg == "--out") {
+                options.out_path = value;
+            }
+            else if (arg == "--label") {
+                options.label = value;
+            }
+            else {
+                std::cerr << "Unknown argument " << arg << std::endl;
+                return 2;
+            }
+        }
+        else {
+            project_path = argv[i];
+        }
+    }
+    // The action queue holds 512 actions, more than that between two callbacks overwrites unread ones.
+    if (project_path == nullptr || options.sample_rate <= 0.0 || options.block_size <= 0 || options.seconds <= 0.0 ||
+        options.burst_size > 256 || options.burst_interval <= 0.0) {
+        std::cerr << "MixScriptDriver [--rate hz] [--block frames] [--seconds s] [--burst actions] "
+            "[--burst-interval s] [--live-record] [--harden] [--max-missed n] [--out file.wav] [--label commit] project.mix" <<
+            std::endl;
+        return 2;
+    }
+    if (FILE* file = fopen(project_path, "rb")) {
+        fclose(file);
+    }
+    else {
+        std::cerr << "Missing project " << project_path << std::endl;
+        return 2;
+    }
+
+    MixScript::Mixer mixer;
+    if (!mixer.Load(project_path)) {
+        std::cerr << "Bad project " << project_path << std::endl;
+        return 2;
+    }
+    mixer.PrepareOutput(options.sample_rate, options.block_size);
+    mixer.ResetToCue(1);
+    if (options.live_record) {
+        mixer.HandleAction(MixScript::SourceActionInfo(MixScript::SA_SET_LIVE_RECORD, 1));
+    }
+
+    const uint32_t num_callbacks = static_cast<uint32_t>(options.seconds * options.sample_rate / options.block_size);
+    const uint32_t out_bytes = options.out_path.empty() ? 0 : num_callbacks * options.block_size * 4;
+    uint8_t* out_samples = out_bytes > 0 ? new uint8_t[out_bytes]() : nullptr;
+    DeviceResult result;
+    result.callback_times.resize(num_callbacks);
+    // After the large allocations so they are locked too.
+    const bool memory_locked = options.harden && mixer.SetRealtimeHardening(true);
+
+    std::atomic_bool running(true);
+    std::thread device(RunDevice, std::ref(mixer), std::cref(options), num_callbacks,
+        reinterpret_cast<int16_t*>(out_samples), std::ref(running), std::ref(result));
+
+    uint64_t actions_sent = 0;
+    uint32_t action_index = 0;
+    const std::chrono::nanoseconds burst_period(static_cast<int64_t>(1e9 * options.burst_interval));
+    Clock::time_point next_burst = Clock::now() + burst_period;
+    while (running) {
+        std::this_thread::sleep_until(nMath::Min(next_burst, Clock::now() + std::chrono::milliseconds(10)));
+        mixer.GrowRecordingRoom();
+        if (running && Clock::now() >= next_burst) {
+            SendBurst(mixer, options.burst_size, action_index);
+            actions_sent += options.burst_size;
+            next_burst += burst_period;
+        }
+    }
+    device.join();
+
+    const MixScript::CallbackStatsSnapshot stats = mixer.callback_stats.Snapshot();
+    std::vector<int64_t>& times = result.callback_times;
+    std::sort(times.begin(), times.end());
+    const double period_us = 1e6 * options.block_size / options.sample_rate;
+    const auto percentile_us = [&times](const double percentile) {
+        return times.empty() ? 0.0 : times[static_cast<size_t>(percentile * (times.size() - 1))] / 1000.0;
+    };
+    const bool pass = result.missed_deadlines - result.late_wake_misses <= options.max_missed;
+
+    std::cout << "{\"label\":\"" << options.label << "\",\"project\":\"" << project_path << "\",\"sample_rate\":" <<
+        options.sample_rate << ",\"block\":" << options.block_size << ",\"period_us\":" << period_us <<
+        ",\"callbacks\":" << result.callbacks << ",\"missed_deadlines\":" << result.missed_deadlines <<
+        ",\"late_wake_misses\":" << result.late_wake_misses << ",\"actions_sent\":" << actions_sent << ",\"callback_p50_us\":" << percentile_us(0.5) <<
+        ",\"callback_p99_us\":" << percentile_us(0.99) << ",\"callback_max_us\":" << percentile_us(1.0) <<
+        ",\"max_wake_late_us\":" << result.max_wake_late / 1000.0 << ",\"overruns\":" << stats.overruns <<
+        ",\"late_callbacks\":" << stats.late_callbacks << ",\"mean_load_percent\":" << stats.MeanLoadPercent() <<
+        ",\"load_p99_percent\":" << stats.LoadPercentile(0.99f) << ",\"max_load_percent\":" <<
+        stats.max_load_percent << ",\"actions_us\":" << (stats.callbacks ? stats.actions_time / 1000.0 /
+        stats.callbacks : 0.0) << ",\"harden\":" << (options.harden ? "true" : "false") << ",\"memory_locked\":" <<
+        (memory_locked ? "true" : "false") << ",\"audio_thread_realtime\":" <<
+        (mixer.AudioThreadRealtime() ? "true" : "false") << ",\"page_faults\":" << stats.page_faults <<
+        ",\"faulting_callbacks\":" << stats.faulting_callbacks << ",\"pass\":" << (pass ? "true" : "false") << "}" << std::endl;
+
+    bool written = true;
+    if (out_samples != nullptr) {
+        written = WriteOutput(options, out_samples, out_bytes);
+        delete[] out_samples;
+    }
+    return pass && written ? 0 : 1;
+}
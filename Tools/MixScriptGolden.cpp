@@ -0,0 +1,194 @@
+// MixScriptGolden - renders projects and compares them to stored golden wav files
+// Author - Nic Taylor
+
+// Headless console tool built from this file and the core sources, everything but Main, MainComponent and
+// TrackControlsComponent. Each project is rendered with Mixer::Render and compared sample by sample to its golden
+// render. Prints one json object per line: a result per project with the render throughput, plus one per segment
+// that is over tolerance. Exits non-zero when any project fails.
+//
+// MixScriptGolden [--record] [--max-abs 0.0001] [--rms 0.00001] [--segment seconds] [--label commit]
+//     project.mix golden.wav [project.mix golden.wav ...]
+//
+// --record writes the golden files instead of comparing. Errors are relative to full scale.
+
+#include "../MixScriptMixer.h"
+#include "../WavAudioBuffer.h"
+#include "../nMath.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    struct Options {
+        bool record = false;
+        double max_abs = 1e-4; // about 3 lsb of 16 bit
+        double rms = 1e-5;
+        double segment_seconds = 1.0;
+        std::string label;
+    };
+
+    struct SegmentError {
+        double max_abs;
+        double rms;
+    };
+
+    bool FileExists(const char* path) {
+        if (FILE* file = fopen(path, "rb")) {
+            fclose(file);
+            return true;
+        }
+        return false;
+    }
+
+    // Each sample of the render against the golden file, in segments of segment_frames.
+    std::vector<SegmentError> Compare(const MixScript::WaveAudioSource& render,
+        const MixScript::WaveAudioSource& golden, const uint32_t segment_frames) {
+        const uint32_t channels = render.format.channels;
+        const int16_t* rendered = reinterpret_cast<const int16_t*>(render.audio_start);
+        const int16_t* expected = reinterpret_cast<const int16_t*>(golden.audio_start);
+        const size_t num_samples = (render.audio_end - render.audio_start) / 2;
+        const size_t segment_samples = static_cast<size_t>(segment_frames) * channels;
+        std::vector<SegmentError> segments;
+        for (size_t start = 0; start < num_samples; start += segment_samples) {
+            const size_t end = nMath::Min(start + segment_samples, num_samples);
+            SegmentError error = { 0.0, 0.0 };
+            double sum = 0.0;
+            for (size_t i = start; i < end; ++i) {
+                const double diff = (rendered[i] - expected[i]) / 32768.0;
+                error.max_abs = nMath::Max(error.max_abs, fabs(diff));
+                sum += diff * diff;
+            }
+            error.rms = sqrt(sum / (end - start));
+            segments.push_back(error);
+        }
+        return segments;
+    }
+
+    // Returns true when the project passes or was recorded.
+    bool RunProject(const Options& options, const char* project_path, const char* golden_path) {
+        if (!FileExists(project_path)) {
+            std::cerr << "Missing project " << project_path << std::endl;
+            return false;
+        }
+        MixScript::Mixer mixer;
+        if (!mixer.Load(project_path)) {
+            std::cerr << "Bad project " << project_path << std::endl;
+            return false;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<MixScript::WaveAudioSource> render(mixer.Render());
+        const double render_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const uint32_t frame_bytes = render->format.channels * 2;
+        const uint64_t frames = (render->audio_end - render->audio_start) / frame_bytes;
+        const double audio_seconds = frames / static_cast<double>(render->format.sample_rate);
+
+        std::cout << "{\"label\":\"" << options.label << "\",\"project\":\"" << project_path << "\",\"frames\":" <<
+            frames << ",\"render_seconds\":" << render_seconds << ",\"frames_per_second\":" <<
+            frames / render_seconds << ",\"realtime_factor\":" << audio_seconds / render_seconds <<
+            ",\"lufs\":" << render->integrated_lufs;
+
+        if (options.record) {
+            const bool written = MixScript::WriteWaveFile(golden_path, render);
+            std::cout << ",\"recorded\":" << (written ? "true" : "false") << "}" << std::endl;
+            delete[] render->buffer->samples;
+            return written;
+        }
+        if (!FileExists(golden_path)) {
+            std::cout << ",\"pass\":false,\"error\":\"missing golden\"}" << std::endl;
+            delete[] render->buffer->samples;
+            return false;
+        }
+
+        std::unique_ptr<MixScript::WaveAudioSource> golden = MixScript::LoadWaveFile(golden_path);
+        const bool same_format = golden->format.channels == render->format.channels &&
+            golden->format.sample_rate == render->format.sample_rate &&
+            golden->format.bit_rate == render->format.bit_rate &&
+            golden->audio_end - golden->audio_start == render->audio_end - render->audio_start;
+        if (!same_format) {
+            std::cout << ",\"pass\":false,\"error\":\"format or length differs\",\"golden_frames\":" <<
+                (golden->audio_end - golden->audio_start) / frame_bytes << "}" << std::endl;
+            delete[] render->buffer->samples;
+            return false;
+        }
+
+        const uint32_t segment_frames = nMath::Max(static_cast<uint32_t>(
+            options.segment_seconds * render->format.sample_rate), 1u);
+        const std::vector<SegmentError> segments = Compare(*render, *golden, segment_frames);
+        SegmentError total = { 0.0, 0.0 };
+        double sum = 0.0;
+        size_t worst = 0;
+        for (size_t segment = 0; segment < segments.size(); ++segment) {
+            total.max_abs = nMath::Max(total.max_abs, segments[segment].max_abs);
+            // Segments are equal length apart from the last, close enough for the total.
+            sum += segments[segment].rms * segments[segment].rms;
+            if (segments[segment].max_abs > segments[worst].max_abs) {
+                worst = segment;
+            }
+        }
+        total.rms = segments.empty() ? 0.0 : sqrt(sum / segments.size());
+        const bool pass = total.max_abs <= options.max_abs && total.rms <= options.rms;
+        std::cout << ",\"pass\":" << (pass ? "true" : "false") << ",\"max_abs\":" << total.max_abs << ",\"rms\":" <<
+            total.rms << ",\"worst_segment\":" << worst << "}" << std::endl;
+
+        for (size_t segment = 0; segment < segments.size(); ++segment) {
+            if (segments[segment].max_abs > options.max_abs || segments[segment].rms > options.rms) {
+                std::cout << "{\"label\":\"" << options.label << "\",\"project\":\"" << project_path <<
+                    "\",\"segment\":" << segment << ",\"start_seconds\":" << segment * options.segment_seconds <<
+                    ",\"max_abs\":" << segments[segment].max_abs << ",\"rms\":" << segments[segment].rms << "}" <<
+                    std::endl;
+            }
+        }
+        delete[] render->buffer->samples;
+        return pass;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    std::vector<const char*> paths;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--record") {
+            options.record = true;
+        }
+        else if (arg.compare(0, 2, "--") == 0 && i + 1 < argc) {
+            const char* value = argv[++i];
+            if (arg == "--max-abs") {
+                options.max_abs = atof(value);
+            }
+            else if (arg == "--rms") {
+                options.rms = atof(value);
+            }
+            else if (arg == "--segment") {
+                options.segment_seconds = atof(value);
+            }
+            else if (arg == "--label") {
+                options.label = value;
+            }
+            else {
+                std::cerr << "Unknown argument " << arg << std::endl;
+                return 2;
+            }
+        }
+        else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty() || paths.size() % 2 != 0 || options.segment_seconds <= 0.0) {
+        std::cerr << "MixScriptGolden [--record] [--max-abs x] [--rms x] [--segment seconds] [--label commit] "
+            "project.mix golden.wav ..." << std::endl;
+        return 2;
+    }
+
+    bool pass = true;
+    for (size_t i = 0; i < paths.size(); i += 2) {
+        pass = RunProject(options, paths[i], paths[i + 1]) && pass;
+    }
+    return pass ? 0 : 1;
+}
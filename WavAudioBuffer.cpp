@@ -2,11 +2,14 @@
 // Author - Nic Taylor
 
 #include "WavAudioBuffer.h"
+#include "MixScriptTrace.h"
 #include <assert.h>
+#include <string.h>
 
 namespace MixScript {
     void ParseWaveFile(WaveAudioFormat *format, WaveAudioBuffer* buffer,
         std::vector<uint32_t>* cues, AudioRegion* region) {
+        MS_TRACE_SCOPE("ParseWaveFile");
 
         *region = { nullptr, nullptr };
 
@@ -43,8 +46,7 @@ namespace MixScript {
                 format_pos += 6; // skip other fields
 
                 const uint16_t bit_rate = *(decltype(bit_rate)*)format_pos;
-                //assert(bit_rate == 16 || bit_rate == 24);
-                assert(bit_rate == 16); // TODO: 24 bit
+                assert(bit_rate == 16 || bit_rate == 24);
                 format->bit_rate = static_cast<decltype(format->bit_rate)>(bit_rate);
                 break;
             }
@@ -80,11 +82,28 @@ namespace MixScript {
             read_pos += chunk_size;
         }
 
+        // The mixer reads 16 bit samples, 24 bit data is rounded to the nearest 16 bit value in place, clamped at
+        // full scale.
+        if (format->bit_rate == 24 && audio_pos != nullptr) {
+            const uint32_t num_samples = data_chunk_size / 3;
+            int16_t* narrowed = reinterpret_cast<int16_t*>(audio_pos);
+            for (uint32_t i = 0; i < num_samples; ++i) {
+                uint8_t const * const sample = audio_pos + 3 * i;
+                const int32_t value = static_cast<int32_t>((sample[0] << 8) | (sample[1] << 16) |
+                    (static_cast<uint32_t>(sample[2]) << 24)) >> 8;
+                const int32_t rounded = (value + 128) >> 8;
+                narrowed[i] = static_cast<int16_t>(rounded > 32767 ? 32767 : rounded);
+            }
+            data_chunk_size = num_samples * 2;
+            format->bit_rate = 16;
+        }
+
         region->start = audio_pos;
         region->end = audio_pos + data_chunk_size;
     }
 
     std::vector<uint8_t> ToByteBuffer(const WaveAudioFormat& format, const AudioRegionC& region) {
+        MS_TRACE_SCOPE("ToByteBuffer");
         const uint32_t data_size = static_cast<uint32_t>(region.end - region.start);
         const uint32_t file_size_minus_8 = 36 + data_size;
 
@@ -3,15 +3,22 @@
 
 #include "WavAudioSource.h"
 #include "WavAudioBuffer.h"
+#include "MixScriptRealtime.h"
+#include "MixScriptTrace.h"
 #include "nMath.h"
+#ifdef _WIN32
 #undef UNICODE // using single byte file loading routines
 #include <windows.h>
+#else
+#include <stdio.h>
+#endif
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <algorithm>
 #include <stdint.h>
 #include <memory>
 #include <assert.h>
+#include <string.h>
 
 #include <iostream>
 #include <fstream>
@@ -41,35 +48,49 @@ namespace MixScript
 
     void WaveAudioSource::Write(const float value) {
         const float sample_max = (float)((1 << (format.bit_rate - 1)) - 1);        
-        const int32_t next = (uint32_t)roundf(value * sample_max);
-        memcpy(write_pos, (uint8_t*)&next, format.bit_rate);
-        write_pos += 2; // TODO: Byte rate
+        const int32_t next = (int32_t)roundf(nMath::Clamp(value, -1.f, 1.f) * sample_max);
+        memcpy(write_pos, (uint8_t*)&next, ByteRate(format));
+        write_pos += ByteRate(format);
     }
 
-    int32_t WaveAudioSource::FindMarkerPivot(const int32_t marker_id) const {
-        const int32_t marker_index = marker_id - 1;
-        if (marker_index < 0 ||
-            (cue_starts[marker_index].type != CT_IMPLIED &&
-             cue_starts[marker_index].type != CT_DEFAULT)) {
-            return marker_id;
-        }        
-        for (int32_t index = marker_index - 1; index >= 0; --index) {
-            if (cue_starts[index].type == CT_LEFT_RIGHT ||
-                cue_starts[index].type == CT_RIGHT) {
-                return index + 1; // to id
+    // Pivot of an implied or default marker is the nearest region marker to the left facing right, otherwise the
+    // nearest to the right facing left. Other markers are their own pivot. Two sweeps instead of a scan per marker.
+    void WaveAudioSource::FindMarkerPivots(std::vector<int32_t>& pivots) const {
+        const int32_t num_markers = static_cast<int32_t>(cue_starts.size());
+        pivots.resize(num_markers);
+        int32_t right_pivot_id = 0;
+        for (int32_t index = num_markers - 1; index >= 0; --index) {
+            pivots[index] = right_pivot_id;
+            if (cue_starts[index].type == CT_LEFT_RIGHT || cue_starts[index].type == CT_LEFT) {
+                right_pivot_id = index + 1; // to id
             }
         }
-        for (int32_t index = marker_index + 1; index < cue_starts.size(); ++index) {
-            if (cue_starts[index].type == CT_LEFT_RIGHT ||
-                cue_starts[index].type == CT_LEFT) {
-                return index + 1; // to id
+        int32_t left_pivot_id = 0;
+        for (int32_t index = 0; index < num_markers; ++index) {
+            const CueType type = cue_starts[index].type;
+            const int32_t marker_id = index + 1;
+            if (type != CT_IMPLIED && type != CT_DEFAULT) {
+                pivots[index] = marker_id;
+            }
+            else if (left_pivot_id > 0) {
+                pivots[index] = left_pivot_id;
+            }
+            else if (pivots[index] == 0) {
+                pivots[index] = marker_id;
+            }
+            if (type == CT_LEFT_RIGHT || type == CT_RIGHT) {
+                left_pivot_id = marker_id;
             }
         }
-        return marker_id;
     }
 
     void WaveAudioSource::CorrectImpliedMarkers() {
-        const int pivot_id = FindMarkerPivot(selected_marker);
+        if (selected_marker <= 0) {
+            return;
+        }
+        std::vector<int32_t> pivots;
+        FindMarkerPivots(pivots);
+        const int pivot_id = pivots[selected_marker - 1];
         if (pivot_id == 0 || pivot_id >= (int)cue_starts.size() || selected_marker == pivot_id) {
             return;
         }
@@ -77,9 +98,52 @@ namespace MixScript
         uint8_t const * const start = pivot_cue.start;
         const int64_t delta = cue_starts[selected_marker - 1].start - start;
         const float new_delta = fabsf(static_cast<float>(delta) / (selected_marker - pivot_id));
+        if (new_delta < kBeatsPerMarker * MinBytesPerBeat()) {
+            // Too close to the pivot to be a bar, the grid puts the marker back.
+            MaterialiseImpliedMarkers();
+            return;
+        }
         const int pivot_index = pivot_id - 1;        
-        auto update_marker = [&, this](MixScript::Cue& cue, const int32_t index) -> bool {
-            if (FindMarkerPivot(index + 1) == pivot_id) {
+        const bool update_left = pivot_cue.type == CT_LEFT || pivot_cue.type == CT_LEFT_RIGHT;
+        const bool update_right = pivot_cue.type == CT_RIGHT || pivot_cue.type == CT_LEFT_RIGHT;
+        if (!tempo_map.Empty()) {
+            // Same extent as the marker updates below. The marker that stops a side keeps its bar.
+            auto marker_beat = [this](const MixScript::Cue& cue) -> int32_t {
+                return static_cast<int32_t>(lround(tempo_map.OffsetToBeat(static_cast<double>(cue.start - audio_start))));
+            };
+            const int32_t pivot_beat = marker_beat(pivot_cue);
+            int32_t begin_beat = pivot_beat;
+            int32_t end_beat = pivot_beat;
+            if (update_left) {
+                begin_beat = TempoMap::kOpenBegin;
+                for (int32_t index = pivot_index - 1; index >= 0; --index) {
+                    if (pivots[index] != pivot_id) {
+                        begin_beat = nMath::Min(marker_beat(cue_starts[index]) + 1, pivot_beat);
+                        break;
+                    }
+                }
+            }
+            if (update_right) {
+                end_beat = TempoMap::kOpenEnd;
+                for (int32_t index = pivot_index + 1; index < (int32_t)cue_starts.size(); ++index) {
+                    if (pivots[index] != pivot_id) {
+                        end_beat = marker_beat(cue_starts[index]);
+                        break;
+                    }
+                }
+            }
+            if (begin_beat < end_beat) {
+                const double bytes_per_beat = new_delta / (double)kBeatsPerMarker;
+                // A tempo that runs into the next region is refused and the marker goes back on its bar.
+                if (tempo_map.SetTempo(begin_beat, end_beat, pivot_beat, bytes_per_beat)) {
+                    bpm = BytesPerBeatToBpm(format, bytes_per_beat);
+                }
+                MaterialiseImpliedMarkers();
+            }
+            return;
+        }
+        auto update_marker = [&](MixScript::Cue& cue, const int32_t index) -> bool {
+            if (pivots[index] == pivot_id) {
                 if (int samples = static_cast<int>((index - pivot_index) * new_delta)) {
                     samples &= ~(0x04 - 1);
                     cue.start = start + samples;
@@ -88,14 +152,14 @@ namespace MixScript
             }
             return false;
         };
-        if (pivot_cue.type == CT_LEFT || pivot_cue.type == CT_LEFT_RIGHT) {
+        if (update_left) {
             for (int32_t index = pivot_index - 1; index >= 0; --index) {
                 if (!update_marker(cue_starts[index], index)) {
                     break;
                 }
             }
         }
-        if (pivot_cue.type == CT_RIGHT || pivot_cue.type == CT_LEFT_RIGHT) {
+        if (update_right) {
             for (int32_t index = pivot_index + 1; index < cue_starts.size(); ++index) {
                 if (!update_marker(cue_starts[index], index)) {
                     break;
@@ -142,6 +206,103 @@ namespace MixScript
         selected_marker = 1 + static_cast<int>(it - cue_starts.begin());
     }
 
+    void WaveAudioSource::GenerateImpliedMarkers(uint8_t const * const first, const uint32_t delta) {
+        if (delta < kBeatsPerMarker * MinBytesPerBeat()) {
+            return;
+        }
+        assert(delta % 4 == 0);
+        const double bytes_per_beat = delta / (double)kBeatsPerMarker;
+        tempo_map.Reset(static_cast<double>(first - audio_start), bytes_per_beat);
+        bpm = BytesPerBeatToBpm(format, bytes_per_beat);
+        MaterialiseImpliedMarkers();
+    }
+
+    void WaveAudioSource::ClearImpliedMarkers() {
+        uint8_t const * const selected_marker_start = selected_marker > 0 ? cue_starts[selected_marker - 1].start : nullptr;
+        int selected_marker_offset = 0;
+        cue_starts.erase(std::remove_if(cue_starts.begin(), cue_starts.end(),
+            [selected_marker_start, &selected_marker_offset](const MixScript::Cue& cue) {
+            if (cue.start < selected_marker_start && cue.type == CT_IMPLIED) {
+                ++selected_marker_offset;
+            }
+            return cue.type == CT_IMPLIED;
+        }), cue_starts.end());
+        if (selected_marker_offset > 0) {
+            selected_marker -= selected_marker_offset;
+            assert(selected_marker > 0);
+        }
+    }
+
+    void WaveAudioSource::MaterialiseImpliedMarkers() {
+        // An implied selection follows its bar.
+        const bool selected_implied = selected_marker > 0 && cue_starts[selected_marker - 1].type == CT_IMPLIED;
+        const double selected_beat = selected_implied && !tempo_map.Empty() ? kBeatsPerMarker * round(
+            tempo_map.OffsetToBeat(static_cast<double>(cue_starts[selected_marker - 1].start - audio_start)) /
+            kBeatsPerMarker) : 0.0;
+        ClearImpliedMarkers();
+        if (tempo_map.Empty()) {
+            return;
+        }
+
+        const int64_t length = audio_end - audio_start;
+        const int64_t alignment = format.channels * ByteRate(format);
+        auto aligned_offset = [alignment](const double offset) -> int64_t {
+            const int64_t bytes = static_cast<int64_t>(offset);
+            return bytes - bytes % alignment;
+        };
+        std::vector<MixScript::Cue> implied;
+        int32_t bar = static_cast<int32_t>(ceil(tempo_map.OffsetToBeat(0.0) / kBeatsPerMarker));
+        // No more bars than the fastest grid fits, whatever a project put in the map.
+        const int64_t max_bars = static_cast<int64_t>(length / (kBeatsPerMarker * MinBytesPerBeat())) + 2;
+        for (int64_t count = 0; count < max_bars; ++count, ++bar) {
+            const int64_t offset = aligned_offset(tempo_map.BeatToOffset(static_cast<double>(bar * kBeatsPerMarker)));
+            if (offset >= length) {
+                break;
+            }
+            if (offset > 0) {
+                implied.push_back({ audio_start + offset, CT_IMPLIED });
+            }
+        }
+        // Segments are anchored independently and can overlap after an edit.
+        auto cue_less = [](const MixScript::Cue& lhs, const MixScript::Cue& rhs) { return lhs.start < rhs.start; };
+        if (!std::is_sorted(implied.begin(), implied.end(), cue_less)) {
+            std::sort(implied.begin(), implied.end(), cue_less);
+        }
+
+        // Existing markers win over a grid line at the same position.
+        std::vector<MixScript::Cue> merged;
+        merged.reserve(cue_starts.size() + implied.size());
+        const int32_t selected_index = selected_marker - 1;
+        auto implied_it = implied.begin();
+        auto push_implied = [&merged](const MixScript::Cue& cue) {
+            if (merged.empty() || merged.back().start != cue.start) {
+                merged.push_back(cue);
+            }
+        };
+        for (int32_t index = 0; index < (int32_t)cue_starts.size(); ++index) {
+            const MixScript::Cue& cue = cue_starts[index];
+            while (implied_it != implied.end() && implied_it->start < cue.start) {
+                push_implied(*implied_it++);
+            }
+            while (implied_it != implied.end() && implied_it->start == cue.start) {
+                ++implied_it;
+            }
+            if (!selected_implied && index == selected_index) {
+                selected_marker = static_cast<int>(merged.size()) + 1;
+            }
+            merged.push_back(cue);
+        }
+        for (; implied_it != implied.end(); ++implied_it) {
+            push_implied(*implied_it);
+        }
+        cue_starts = std::move(merged);
+
+        if (selected_implied) {
+            uint8_t const * const selected_pos = audio_start + aligned_offset(tempo_map.BeatToOffset(selected_beat));
+            selected_marker = static_cast<int>(nMath::Min(NextCueIndex(selected_pos), cue_starts.size() - 1)) + 1;
+        }
+    }
+
     void WaveAudioSource::UpdateMarker(const CueType type) {
         if (selected_marker <= 0) {
             return;
@@ -171,31 +332,59 @@ namespace MixScript
     }
 
     WaveAudioSource::WaveAudioSource():
-        file_name(""),
         format(),
+        file_name(""),
         buffer(nullptr),
         audio_start(nullptr),
         audio_end(nullptr),
+        delay_beats(kDefaultDelayBeats),
+        bpm(-1.f),
+        integrated_lufs(nMath::kLoudnessAbsoluteGate),
         selected_marker(-1),
+        playback_solo(false),
+        playback_bypass_all(false),
+        tempo_mode(DTM_NONE),
+        varispeed_frame(0.0),
         read_pos(nullptr),
         last_read_pos(0),
         write_pos(0),
-        bpm(-1.f),
-        playback_solo(false),
-        playback_bypass_all(false)
+        tempo_read_pos(nullptr),
+        tempo_right(0.f),
+        tempo_rate(1.f),
+        sample_rate_ratio(1.f),
+        mix_sample_rate(0),
+        stretch_left(),
+        stretch_right(),
+        stretch_fraction(0.0)
     {}
 
     WaveAudioSource::WaveAudioSource(const char* file_path, const WaveAudioFormat& format_, WaveAudioBuffer* buffer_,
         const AudioRegion& region_, const std::vector<uint32_t>& cue_offsets):
-        file_name(file_path),
         format(format_),
+        file_name(file_path),
         buffer(buffer_),
         audio_start(region_.start),
         audio_end(region_.end),
-        selected_marker(-1),
+        delay_beats(kDefaultDelayBeats),
         bpm(-1.f),
+        integrated_lufs(nMath::kLoudnessAbsoluteGate),
+        selected_marker(-1),
         playback_solo(false),
-        playback_bypass_all(false) {
+        playback_bypass_all(false),
+        tempo_mode(DTM_NONE),
+        varispeed_frame(0.0),
+        tempo_read_pos(nullptr),
+        tempo_right(0.f),
+        tempo_rate(1.f),
+        sample_rate_ratio(1.f),
+        mix_sample_rate(format_.sample_rate),
+        stretch_left(),
+        stretch_right(),
+        stretch_fraction(0.0) {
+        stretcher.Prepare(audio_start, audio_end, format.channels);
+        for (nMath::ThreeBandIsolator& isolator : isolators) {
+            isolator.Prepare(kLowSplitHz / mix_sample_rate, kHighSplitHz / mix_sample_rate);
+        }
         read_pos = region_.start;
         last_read_pos = 0;
         write_pos = region_.start;
@@ -223,6 +412,14 @@ namespace MixScript
         }
     }
 
+    size_t WaveAudioSource::NextCueIndex(uint8_t const * const position) const {
+        const auto next_cue = std::lower_bound(cue_starts.begin(), cue_starts.end(), position,
+            [](const MixScript::Cue& lhs, uint8_t const * const rhs) {
+            return lhs.start < rhs;
+        });
+        return static_cast<size_t>(next_cue - cue_starts.begin());
+    }
+
     void ResetToCue(std::unique_ptr<WaveAudioSource>& source_, const uint32_t cue_id) {
         WaveAudioSource& source = *source_.get();
 
@@ -274,12 +471,7 @@ namespace MixScript
     }
 
     void MixerControl::ClearMovements(uint8_t const * const start, uint8_t const * const end) {
-        if (!movements.empty()) {
-            movements.erase(
-                std::remove_if(movements.begin(), movements.end(), [&](const MixerControl::movement_type& movement) {
-                return movement.cue_pos > start && movement.cue_pos <= end;
-            }), movements.end());
-        }
+        movements.EraseRange(start, end);
     }
     
     void UpdateMovement(const WaveAudioSource& source, const GainControl& control, MixerControl& mixer_control,
@@ -288,41 +480,35 @@ namespace MixScript
         if (!update_param_on_selected_marker || cue_id > 0) {
             uint8_t const * const marker_pos = update_param_on_selected_marker ? source.cue_starts[cue_id - 1].start :
                 (source.audio_start + source.last_read_pos);
-            int gain_cue_id = 0;
-            bool found = false;
-            // TODO: Binary Search
-            for (Movement& movement : mixer_control.movements) {
-                // TODO: Decide if it is easier to separate automation points from cues, or if
-                // automation and cues should stay in sync.
-                if (movement.cue_pos == marker_pos) {
-                    movement.control = control;
-                    movement.threshold_percent = interpolation_percent;
-                    movement.transition_samples = (int64_t)TimeMsToBytes(source.format, 5.f);
-                    movement.precompute_index = precompute_index;
-                    found = true;
-                    break;
-                }
-                else if (movement.cue_pos > marker_pos) {
-                    break;
-                }
-                ++gain_cue_id;
-            }
-            if (!found) {
-                if (gain_cue_id >= mixer_control.movements.size()) {
-                    Movement& movement = mixer_control.Add(control, marker_pos);
-                    movement.threshold_percent = interpolation_percent;
-                    movement.transition_samples = (int64_t)TimeMsToBytes(source.format, 5.f);
-                    movement.precompute_index = precompute_index;
-                }
-                else {
-                    mixer_control.movements.insert(mixer_control.movements.begin() + gain_cue_id,
-                        Movement{ control, MFT_LINEAR, interpolation_percent,
-                        (int64_t)TimeMsToBytes(source.format, 5.f), marker_pos });
-                }
+            // TODO: Decide if it is easier to separate automation points from cues, or if
+            // automation and cues should stay in sync.
+            Movement* movement = mixer_control.movements.Find(marker_pos);
+            if (movement == nullptr) {
+                movement = &mixer_control.Add(control, marker_pos);
             }
+            movement->control = control;
+            movement->threshold_percent = interpolation_percent;
+            movement->transition_samples = (int64_t)TimeMsToBytes(source.format, 5.f);
+            movement->precompute_index = precompute_index;
         }
     }
 
+    // Each side of the sweep covers 20 Hz to 20 kHz exponentially. Resonance rises with depth and the filter fades
+    // in over the first 5% so leaving 1 is seamless.
+    float ApplyFilterSweep(nMath::StateVariableFilter& filter, const float sample_rate, const float x,
+        const float sweep) {
+        constexpr float kSweepOctaves = 9.9658f; // log2(1000)
+        const float depth = nMath::Min(fabsf(sweep - 1.f), 1.f);
+        const float cutoff = sweep < 1.f ? 20000.f * exp2f(-kSweepOctaves * depth) :
+            20.f * exp2f(kSweepOctaves * depth);
+        const float g = nMath::FastTan((float)M_PI * nMath::Min(cutoff / sample_rate, 0.49f));
+        const float k = 1.f / (0.707f + 0.8f * depth);
+        const nMath::StateVariableFilter::Outputs outputs = filter.Process(x, g, k);
+        const float filtered = sweep < 1.f ? outputs.low : outputs.high;
+        const float wet = nMath::Min(depth * 20.f, 1.f);
+        return x + wet * (filtered - x);
+    }
+
     float InterpolateMix(const float param, const float inv_duration, const MixFadeType fade_type) {
         switch (fade_type) {
         case MFT_LINEAR:
@@ -338,12 +524,25 @@ namespace MixScript
         return param;
     }
 
+    // Blending the cached parameters through a transition runs one filter per band instead of crossfading two.
+    nMath::ShelfFilterParams ShelfParamsAt(const MovementPrecomputeCacheShelf& precompute,
+        const MixerControl::MixerInterpolation& interpolation) {
+        const nMath::ShelfFilterParams& start = precompute.At(interpolation.start->precompute_index);
+        if (!interpolation.end) {
+            return start;
+        }
+        const float t = InterpolateMix(1.f, interpolation.ratio, interpolation.end->interpolation_type);
+        return nMath::Lerp(start, precompute.At(interpolation.end->precompute_index), nMath::Clamp(t, 0.f, 1.f));
+    }
+
     Movement& MixerControl::Add(const GainControl& control, uint8_t const * const position) {
-        movements.emplace_back(Movement{ control, MFT_LINEAR, 0.f, 0, position, -1 });
-        return movements.back();
+        return movements.Insert(Movement{ control, MFT_LINEAR, 0.f, 0, position, -1 });
     }
 
     MixerControl::MixerInterpolation MixerControl::GetInterpolation(uint8_t const * const position) const {
+        if (live && !bypass) {
+            return MixerInterpolation{ &live_movement, nullptr, 0.f };
+        }
         if (movements.empty() || bypass) {
             return MixerInterpolation{ nullptr, nullptr, 0.f };
         }
@@ -353,17 +552,14 @@ namespace MixScript
             return MixerInterpolation{ &movements.back(), nullptr, 0.f };
         }
 
-        const auto interval = std::lower_bound(movements.begin(), movements.end(), position,
-            [](const Movement& lhs, uint8_t const * const rhs) {
-            return lhs.cue_pos < rhs;
-        });
+        const auto interval = movements.LowerBound(position);
         assert(interval != movements.end());
 
         if (interval == movements.begin()) {
             return MixerInterpolation{ &movements.front(), nullptr, 0.f };
         }
         
-        const Movement& start_state = *(interval - 1);
+        const Movement& start_state = *std::prev(interval);
         const Movement& end_state = *interval;
 
         const int64_t t = (int64_t)(position - start_state.cue_pos);
@@ -396,14 +592,14 @@ namespace MixScript
     }
     
     float MixerControl::ValueAt(uint8_t const * const position) const {
+        if (live && !bypass) {
+            return live_movement.control.Value();
+        }
         if (movements.empty() || bypass) {
             return 1.f;
         }
 
-        const auto interval = std::lower_bound(movements.begin(), movements.end(), position,
-            [](const Movement& lhs, uint8_t const * const rhs) {
-            return lhs.cue_pos < rhs;
-        });
+        const auto interval = movements.LowerBound(position);
 
         if (interval == movements.begin()) {
             return movements.front().control.Value();
@@ -412,7 +608,7 @@ namespace MixScript
             return movements.back().control.Value();
         }
 
-        const Movement& start_state = *(interval - 1);
+        const Movement& start_state = *std::prev(interval);
         const Movement& end_state = *interval;
 
         const int64_t t = (int64_t)(position - start_state.cue_pos);
@@ -446,10 +642,159 @@ namespace MixScript
         return InterpolateMix(end_value - start_value, ratio, end_state.interpolation_type) + start_value;
     }
 
+    float WaveAudioSource::ReadStretched(const int channel) {
+        typedef nMath::SincResampler Resampler;
+        const bool resampled = sample_rate_ratio != 1.f;
+        if (channel == 1) {
+            // The next output frame is behind the stretcher by the frames buffered for the resampler.
+            const double buffered = resampled ? (Resampler::kTailFrames + 1 - stretch_fraction) * tempo_rate : 0.0;
+            const int64_t frame_bytes = format.channels * ByteRate(format);
+            const int64_t frame = static_cast<int64_t>(stretcher.Position() - buffered);
+            read_pos = nMath::Min(audio_start + nMath::Max(frame, (int64_t)0) * frame_bytes, audio_end);
+            tempo_read_pos = read_pos;
+            return tempo_right;
+        }
+        if (read_pos != tempo_read_pos) {
+            stretcher.Reset((read_pos - audio_start) / (double)(format.channels * ByteRate(format)));
+            if (resampled) {
+                ResetStretchWindow();
+            }
+        }
+        float left = 0.f;
+        if (!resampled) {
+            stretcher.Next(left, tempo_right);
+        }
+        else {
+            while (stretch_fraction >= 1.0) {
+                std::copy(stretch_left.begin() + 1, stretch_left.end(), stretch_left.begin());
+                std::copy(stretch_right.begin() + 1, stretch_right.end(), stretch_right.begin());
+                stretcher.Next(stretch_left.back(), stretch_right.back());
+                stretch_fraction -= 1.0;
+            }
+            float coefficients[Resampler::kTaps];
+            resampler.Coefficients(static_cast<float>(stretch_fraction), coefficients);
+            left = Resampler::Apply(stretch_left.data(), coefficients);
+            tempo_right = Resampler::Apply(stretch_right.data(), coefficients);
+            stretch_fraction += sample_rate_ratio;
+        }
+        read_pos += 2;
+        return left;
+    }
+
+    void WaveAudioSource::ResetStretchWindow() {
+        typedef nMath::SincResampler Resampler;
+        stretch_left.fill(0.f);
+        stretch_right.fill(0.f);
+        for (int32_t tap = Resampler::kLeadFrames; tap < Resampler::kTaps; ++tap) {
+            stretcher.Next(stretch_left[tap], stretch_right[tap]);
+        }
+        stretch_fraction = 0.0;
+    }
+
+    float WaveAudioSource::ReadVarispeed(const int channel) {
+        const int64_t frame_bytes = format.channels * ByteRate(format);
+        if (channel == 1) {
+            read_pos = nMath::Min(audio_start + static_cast<int64_t>(varispeed_frame) * frame_bytes, audio_end);
+            tempo_read_pos = read_pos;
+            return tempo_right;
+        }
+        if (read_pos != tempo_read_pos) {
+            varispeed_frame = static_cast<double>((read_pos - audio_start) / frame_bytes);
+        }
+        typedef nMath::SincResampler Resampler;
+        const int64_t frame = static_cast<int64_t>(varispeed_frame);
+        float coefficients[Resampler::kTaps];
+        resampler.Coefficients(static_cast<float>(varispeed_frame - frame), coefficients);
+        float left_taps[Resampler::kTaps];
+        float right_taps[Resampler::kTaps];
+        const int16_t* samples = reinterpret_cast<const int16_t*>(audio_start);
+        const int64_t num_frames = (audio_end - audio_start) / frame_bytes;
+        const uint32_t right_channel = format.channels > 1 ? 1 : 0;
+        for (int32_t tap = 0; tap < Resampler::kTaps; ++tap) {
+            const int64_t tap_frame = frame - Resampler::kLeadFrames + tap;
+            const bool inside = tap_frame >= 0 && tap_frame < num_frames;
+            left_taps[tap] = inside ? samples[tap_frame * format.channels] * (1.f / 32768.f) : 0.f;
+            right_taps[tap] = inside ? samples[tap_frame * format.channels + right_channel] * (1.f / 32768.f) : 0.f;
+        }
+        tempo_right = Resampler::Apply(right_taps, coefficients);
+        varispeed_frame += (tempo_mode == DTM_VARISPEED ? tempo_rate : 1.f) * sample_rate_ratio;
+        read_pos += 2;
+        return Resampler::Apply(left_taps, coefficients);
+    }
+
+    void WaveAudioSource::SetTempoRate(const float rate) {
+        tempo_rate = nMath::Clamp(rate, TimeStretcher::kMinRate, TimeStretcher::kMaxRate);
+        stretcher.SetRate(tempo_rate);
+    }
+
+    nMath::ShelfFilterParams WaveAudioSource::ShelfConfig(const MixScript::SourceAction action, const float db) const {
+        const float gain_db = fabsf(db) > 0.01 ? db : 0.f;
+        if (action == MixScript::SA_MULTIPLY_LP_SHELF_GAIN) {
+            return nMath::ShelfButterworthLowConfig(kLowSplitHz / mix_sample_rate, gain_db);
+        }
+        return nMath::ShelfButterworthHighConfig(kHighSplitHz / mix_sample_rate, gain_db);
+    }
+
+    void WaveAudioSource::WorkingMemory(MemoryRanges& ranges) const {
+        ranges.Add(this, sizeof(WaveAudioSource));
+        if (Empty()) {
+            return;
+        }
+        ranges.Add(audio_start, audio_end - audio_start);
+        ranges.Add(cue_starts);
+        ranges.Add(tempo_map.Segments());
+        for (const MixerControl* control : { &gain_control, &fader_control, &lp_shelf_control, &hp_shelf_control,
+            &low_control, &mid_control, &high_control, &filter_control, &convolution_send_control,
+            &delay_send_control, &delay_feedback_control }) {
+            control->movements.WorkingMemory(ranges);
+        }
+        ranges.Add(lp_shelf_precomute.cache);
+        ranges.Add(hp_shelf_precomute.cache);
+        stretcher.WorkingMemory(ranges);
+        resampler.WorkingMemory(ranges);
+        delay.WorkingMemory(ranges);
+        convolution.WorkingMemory(ranges);
+    }
+
+    void WaveAudioSource::SetMixSampleRate(const uint32_t mix_sample_rate_) {
+        // Sends run after the read, at the mix rate.
+        if (!Empty() && mix_sample_rate_ != 0 && delay.SampleRate() != mix_sample_rate_) {
+            delay.Prepare(static_cast<float>(mix_sample_rate_), kMaxDelaySeconds);
+        }
+        if (!Empty() && mix_sample_rate_ != 0 && mix_sample_rate_ != mix_sample_rate) {
+            mix_sample_rate = mix_sample_rate_;
+            for (nMath::ThreeBandIsolator& isolator : isolators) {
+                isolator.Prepare(kLowSplitHz / mix_sample_rate, kHighSplitHz / mix_sample_rate);
+            }
+            // The gain of each cached shelf is recovered from its own params, m2 + 1 of the low shelf and m0 of the
+            // high shelf are the linear gain, so entries no movement points at yet are retuned too.
+            for (nMath::ShelfFilterParams& params : lp_shelf_precomute.cache) {
+                params = ShelfConfig(MixScript::SA_MULTIPLY_LP_SHELF_GAIN, 20.f * log10f(params.m2 + 1.f));
+            }
+            for (nMath::ShelfFilterParams& params : hp_shelf_precomute.cache) {
+                params = ShelfConfig(MixScript::SA_MULTIPLY_HP_SHELF_GAIN, 20.f * log10f(params.m0));
+            }
+        }
+        const float ratio = Empty() || mix_sample_rate_ == 0 ? 1.f :
+            static_cast<float>(format.sample_rate / static_cast<double>(mix_sample_rate_));
+        if (ratio == sample_rate_ratio) {
+            return;
+        }
+        sample_rate_ratio = ratio;
+        // Decimating needs the cutoff at the mix Nyquist.
+        resampler = nMath::SincResampler(0.95f / nMath::Max(ratio, 1.f));
+        // The stretched window belongs to the old ratio, the next read starts it again.
+        tempo_read_pos = nullptr;
+    }
+
     float WaveAudioSource::ReadAndProcess(const int channel) {
         uint8_t const * const starting_read_pos = read_pos;
-        bool unused = false;
-        float sample = Read();
+        const float sample = tempo_mode == DTM_STRETCH ? ReadStretched(channel) :
+            tempo_mode == DTM_VARISPEED || sample_rate_ratio != 1.f ? ReadVarispeed(channel) : Read();
+        return Process(channel, sample, starting_read_pos);
+    }
+
+    float WaveAudioSource::Process(const int channel, float sample, uint8_t const * const starting_read_pos) {
         if (playback_bypass_all) {
             return sample;
         }
@@ -481,40 +826,79 @@ namespace MixScript
 
         interpolation = lp_shelf_control.GetInterpolation(starting_read_pos);
         if (interpolation.start) {
-            float start_value = lp_shelf_filters[channel].left.Apply(
-                lp_shelf_precomute.cache[interpolation.start->precompute_index], sample);
-            if (interpolation.end) {
-                float end_value = lp_shelf_filters[channel].right.Apply(
-                    lp_shelf_precomute.cache[interpolation.end->precompute_index], sample);
-                sample = InterpolateMix(end_value - start_value, interpolation.ratio,
-                    interpolation.end->interpolation_type) + start_value;
+            sample = lp_shelf_filters[channel].Shelf(sample, ShelfParamsAt(lp_shelf_precomute, interpolation));
+        }
+
+        interpolation = hp_shelf_control.GetInterpolation(starting_read_pos);
+        if (interpolation.start) {
+            sample = hp_shelf_filters[channel].Shelf(sample, ShelfParamsAt(hp_shelf_precomute, interpolation));
+        }
+
+        // The isolator runs for the whole track once any band has automation, switching it in and out would step
+        // the phase.
+        bool isolator_active = false;
+        auto band_gain = [starting_read_pos, &isolator_active](const MixerControl& control) {
+            const MixerControl::MixerInterpolation band = control.GetInterpolation(starting_read_pos);
+            if (!band.start) {
+                return 1.f;
             }
-            else {
-                sample = start_value;
+            isolator_active = true;
+            const float start_value = band.start->control.Value();
+            if (!band.end) {
+                return start_value;
             }
+            return InterpolateMix(band.end->control.Value() - start_value, band.ratio,
+                band.end->interpolation_type) + start_value;
+        };
+        const float low_gain = band_gain(low_control);
+        const float mid_gain = band_gain(mid_control);
+        const float high_gain = band_gain(high_control);
+        if (isolator_active) {
+            sample = isolators[channel].Process(sample, low_gain, mid_gain, high_gain);
         }
 
-        interpolation = hp_shelf_control.GetInterpolation(starting_read_pos);
+        interpolation = filter_control.GetInterpolation(starting_read_pos);
         if (interpolation.start) {
-            float start_value = hp_shelf_filters[channel].left.Apply(
-                hp_shelf_precomute.cache[interpolation.start->precompute_index], sample);
+            float sweep = interpolation.start->control.Value();
             if (interpolation.end) {
-                float end_value = hp_shelf_filters[channel].right.Apply(
-                    hp_shelf_precomute.cache[interpolation.end->precompute_index], sample);
-                sample = InterpolateMix(end_value - start_value, interpolation.ratio,
-                    interpolation.end->interpolation_type) + start_value;
+                sweep += InterpolateMix(interpolation.end->control.Value() - sweep, interpolation.ratio,
+                    interpolation.end->interpolation_type);
             }
-            else {
-                sample = start_value;
+            sample = ApplyFilterSweep(sweep_filters[channel], static_cast<float>(mix_sample_rate), sample, sweep);
+        }
+
+        // Sends take the post fader signal and return past the fader.
+        auto control_value = [starting_read_pos](const MixerControl& control, const float unset_value) {
+            const MixerControl::MixerInterpolation send = control.GetInterpolation(starting_read_pos);
+            if (!send.start) {
+                return unset_value;
+            }
+            const float start_value = send.start->control.Value();
+            if (!send.end) {
+                return start_value;
             }
+            return InterpolateMix(send.end->control.Value() - start_value, send.ratio,
+                send.end->interpolation_type) + start_value;
+        };
+        const float dry = sample;
+        nMath::Convolver* convolver = convolution.Active();
+        if (convolver != nullptr) {
+            // Runs with no send too so the tail keeps ringing, it goes idle once the tail is out.
+            sample += convolver->Process(channel, control_value(convolution_send_control, 0.f) * dry);
+        }
+        // A deck that never sent to the delay has nothing to ring.
+        if (delay.Prepared() && !delay_send_control.movements.empty()) {
+            sample += delay.Process(channel, control_value(delay_send_control, 0.f) * dry,
+                control_value(delay_feedback_control, kDefaultDelayFeedback));
         }
         return sample;
     }
     
     std::unique_ptr<WaveAudioSource> LoadWaveFile(const char* file_path) {
-
+        MS_TRACE_SCOPE("LoadWaveFile");
         uint8_t* large_file_buffer = new uint8_t[kMaxAudioBufferSize];
 
+#ifdef _WIN32
         HANDLE file = CreateFile(file_path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
             nullptr);
         DWORD bytes_read = 0;
@@ -524,6 +908,13 @@ namespace MixScript
                 nullptr) != 0;            
             CloseHandle(file);
         }
+#else
+        size_t bytes_read = 0;
+        if (FILE* file = fopen(file_path, "rb")) {
+            bytes_read = fread(large_file_buffer, 1, kMaxAudioBufferSize - 1, file);
+            fclose(file);
+        }
+#endif
 
         WaveAudioBuffer* wav_buffer = new WaveAudioBuffer(large_file_buffer, static_cast<uint32_t>(bytes_read));
         WaveAudioFormat format;
@@ -535,6 +926,8 @@ namespace MixScript
     }
 
     bool WriteWaveFile(const char* file_path, const std::unique_ptr<WaveAudioSource>& source) {
+        MS_TRACE_SCOPE("WriteWaveFile");
+#ifdef _WIN32
         HANDLE file = CreateFile(file_path, GENERIC_WRITE, FILE_SHARE_WRITE, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
             nullptr);
         if (file != INVALID_HANDLE_VALUE) {            
@@ -547,6 +940,15 @@ namespace MixScript
             CloseHandle(file);
             return bWriteComplete;
         }
+#else
+        if (FILE* file = fopen(file_path, "wb")) {
+            std::vector<uint8_t> file_buffer(std::move(
+                ToByteBuffer(source->format, AudioRegionC{ source->audio_start, source->audio_end })));
+            const bool write_complete = fwrite(&file_buffer[0], 1, file_buffer.size(), file) == file_buffer.size();
+            fclose(file);
+            return write_complete;
+        }
+#endif
 
         return false;
     }
@@ -562,6 +964,27 @@ namespace MixScript
         case  MixScript::SA_MULTIPLY_HP_SHELF_GAIN:
             return hp_shelf_control;
             break;
+        case  MixScript::SA_MULTIPLY_LOW_GAIN:
+            return low_control;
+            break;
+        case  MixScript::SA_MULTIPLY_MID_GAIN:
+            return mid_control;
+            break;
+        case  MixScript::SA_MULTIPLY_HIGH_GAIN:
+            return high_control;
+            break;
+        case  MixScript::SA_SWEEP_FILTER:
+            return filter_control;
+            break;
+        case  MixScript::SA_MULTIPLY_CONVOLUTION_SEND:
+            return convolution_send_control;
+            break;
+        case  MixScript::SA_MULTIPLY_DELAY_SEND:
+            return delay_send_control;
+            break;
+        case  MixScript::SA_DELAY_FEEDBACK:
+            return delay_feedback_control;
+            break;
         default:
             return gain_control;
         }
@@ -578,6 +1001,27 @@ namespace MixScript
         case  MixScript::SA_MULTIPLY_HP_SHELF_GAIN:
             return hp_shelf_control;
             break;
+        case  MixScript::SA_MULTIPLY_LOW_GAIN:
+            return low_control;
+            break;
+        case  MixScript::SA_MULTIPLY_MID_GAIN:
+            return mid_control;
+            break;
+        case  MixScript::SA_MULTIPLY_HIGH_GAIN:
+            return high_control;
+            break;
+        case  MixScript::SA_SWEEP_FILTER:
+            return filter_control;
+            break;
+        case  MixScript::SA_MULTIPLY_CONVOLUTION_SEND:
+            return convolution_send_control;
+            break;
+        case  MixScript::SA_MULTIPLY_DELAY_SEND:
+            return delay_send_control;
+            break;
+        case  MixScript::SA_DELAY_FEEDBACK:
+            return delay_feedback_control;
+            break;
         default:
             return gain_control;
         }
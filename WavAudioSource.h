@@ -8,12 +8,22 @@
 #include <memory>
 
 #include "MixScriptAction.h"
+#include "MixScriptAnalysis.h"
+#include "MixScriptMovementList.h"
 #include "MixScriptShared.h"
+#include "MixScriptTempoMap.h"
+#include "MixScriptTimeStretch.h"
+#include "nConvolution.h"
+#include "nCrossover.h"
+#include "nDelay.h"
 #include "nFilters.h"
+#include "nLoudness.h"
+#include "nResampler.h"
 
 namespace MixScript
 {
     struct WaveAudioBuffer;
+    class MemoryRanges;
     
     struct GainControl {
         float gain;
@@ -22,11 +32,6 @@ namespace MixScript
         }
     };
 
-    struct BiquadFilterInterpolatedState {
-        nMath::TwoPoleFilter left; // region
-        nMath::TwoPoleFilter right;
-    };
-
     enum MixFadeType : int32_t {
         MFT_LINEAR = 1,
         MFT_SQRT,
@@ -38,11 +43,19 @@ namespace MixScript
         virtual void Remove(const int index) = 0;
     };
 
-    struct MovementPrecomputCacheTwoPoleFilter : public MovementPrecomputeCache {
-        std::vector<nMath::TwoPoleFilterParams> cache;
+    struct MovementPrecomputeCacheShelf : public MovementPrecomputeCache {
+        std::vector<nMath::ShelfFilterParams> cache;
+        // Params of the live movement while a ride is recorded, rewritten in place by each shelf action.
+        static constexpr int kLiveIndex = -2;
+        nMath::ShelfFilterParams live;
+
+        MovementPrecomputeCacheShelf() : live() {}
         void Remove(const int index) {
             cache.erase(cache.begin() + index);
         }
+        const nMath::ShelfFilterParams& At(const int index) const {
+            return index == kLiveIndex ? live : cache[index];
+        }
     };
 
     struct Movement {
@@ -56,11 +69,14 @@ namespace MixScript
     
     struct MixerControl {
         typedef Movement movement_type;
-        std::vector<movement_type> movements;
+        MovementList<movement_type> movements;
         MovementPrecomputeCache* cache;
         bool bypass;
+        // While recording a ride the live movement overrides the automation.
+        bool live;
+        movement_type live_movement;
         
-        MixerControl() : bypass(false), cache(nullptr) { movements.reserve(256); }
+        MixerControl() : cache(nullptr), bypass(false), live(false) { movements.Reserve(256); }
 
         movement_type& Add(const GainControl& control, uint8_t const * const position);
         struct MixerInterpolation {
@@ -84,26 +100,74 @@ namespace MixScript
         const uint8_t* start;
         CueType type;
     };
+
+    // How a deck follows the playing deck's tempo.
+    enum DeckTempoMode : int {
+        DTM_NONE,
+        DTM_STRETCH, // key locked
+        DTM_VARISPEED, // pitch follows tempo
+    };
     struct WaveAudioSource {
         WaveAudioFormat format;
         std::string file_name;
         std::unique_ptr<WaveAudioBuffer> buffer;        
         uint8_t const * const audio_start;
         uint8_t const * const audio_end;
-        std::vector<Cue> cue_starts;
+        std::vector<MixScript::Cue> cue_starts;
         MixerControl gain_control;
         MixerControl fader_control;
         MixerControl lp_shelf_control;
-        MovementPrecomputCacheTwoPoleFilter lp_shelf_precomute;
-        std::array<BiquadFilterInterpolatedState, 2> lp_shelf_filters;
+        MovementPrecomputeCacheShelf lp_shelf_precomute;
+        std::array<nMath::StateVariableFilter, 2> lp_shelf_filters;
         MixerControl hp_shelf_control;
-        MovementPrecomputCacheTwoPoleFilter hp_shelf_precomute;
-        std::array<BiquadFilterInterpolatedState, 2> hp_shelf_filters;
+        MovementPrecomputeCacheShelf hp_shelf_precomute;
+        std::array<nMath::StateVariableFilter, 2> hp_shelf_filters;
+        // Crossovers of the isolator bands, also the shelf corners.
+        static constexpr float kLowSplitHz = 200.f;
+        static constexpr float kHighSplitHz = 3000.f;
+        // Isolator band gains, 1 is flat and 0 kills the band.
+        MixerControl low_control;
+        MixerControl mid_control;
+        MixerControl high_control;
+        std::array<nMath::ThreeBandIsolator, 2> isolators;
+        // Filter sweep, 1 is open. Below 1 a low pass sweeps down, above 1 a high pass sweeps up.
+        MixerControl filter_control;
+        std::array<nMath::StateVariableFilter, 2> sweep_filters;
+        // Send of the post fader signal into the impulse response, 0 to 1. The return is not faded so a tail
+        // rings out after the fader closes.
+        MixerControl convolution_send_control;
+        nMath::ConvolverExchange convolution;
+        // Echo of the post fader signal delay_beats long at the deck tempo. Send is 0 to 1 and feedback 0 to
+        // nMath::FeedbackDelay::kMaxFeedback. Like the convolution send, the return is not faded.
+        static constexpr float kDefaultDelayBeats = 0.75f;
+        static constexpr float kDefaultDelayFeedback = 0.5f;
+        static constexpr float kMaxDelaySeconds = 3.f;
+        MixerControl delay_send_control;
+        MixerControl delay_feedback_control;
+        float delay_beats;
+        nMath::FeedbackDelay delay;
         float bpm;
+        // Integrated loudness in LUFS, measured after load.
+        float integrated_lufs;
+        // Implied markers are materialised from the tempo map, one per bar.
+        static constexpr int32_t kBeatsPerMarker = 4;
+        // Fastest grid an edit or a project can set, a marker dragged onto its pivot would otherwise imply a bar
+        // of a few bytes.
+        static constexpr float kMaxGridBpm = 300.f;
+        double MinBytesPerBeat() const {
+            return 60.0 * format.channels * ByteRate(format) * format.sample_rate / kMaxGridBpm;
+        }
+        TempoMap tempo_map;
+        OnsetEnvelope onset_envelope;
+        PeakPyramid peak_pyramid;
         int selected_marker;
 
         bool playback_solo; // solo without sync
         bool playback_bypass_all;
+        DeckTempoMode tempo_mode;
+        TimeStretcher stretcher;
+        // Fractional frame of the varispeed reader, read_pos is its floor.
+        double varispeed_frame;
 
         const float kSampleRatio = 1.f / (float)((uint32_t)1 << (uint32_t)31);
         const uint8_t* read_pos;
@@ -111,15 +175,38 @@ namespace MixScript
         uint8_t* write_pos;
         float Read();
         float ReadAndProcess(const int channel);
+        // Automation and filters for one channel of the sample read at position.
+        float Process(const int channel, float sample, uint8_t const * const position);
         float Read(const uint8_t** read_pos_) const;
         void Write(const float value);
         bool Cue(uint8_t const * const position, uint32_t& cue_id) const;
+        // Index of the first cue at or after position.
+        size_t NextCueIndex(uint8_t const * const position) const;
         const uint8_t * SelectedMarkerPos() const;
         void TryWrap();
         void AddMarker(const CueType type = CT_DEFAULT);
+        // Sets the tempo map to one bar every delta bytes through first and materialises it.
+        void GenerateImpliedMarkers(uint8_t const * const first, const uint32_t delta);
+        void ClearImpliedMarkers();
+        // Rebuilds implied markers from the tempo map in one sorted pass.
+        void MaterialiseImpliedMarkers();
         void UpdateMarker(const CueType type);
         void DeleteMarker();
         void MoveSelectedMarker(const int32_t num_samples);
+        // Source frames per output frame for the tempo modes.
+        void SetTempoRate(const float rate);
+        float TempoRate() const { return tempo_rate; }
+        // A deck at another rate than the mix reads through the varispeed resampler. A stretched deck stretches at
+        // its file rate and resamples the stretched frames after, so it keeps its key.
+        // The isolators, shelves and sweep run after the read so they are tuned to the mix rate, a change re-prepares
+        // them and retunes both shelf caches in place.
+        void SetMixSampleRate(const uint32_t mix_sample_rate_);
+        float SampleRateRatio() const { return sample_rate_ratio; }
+        uint32_t MixSampleRate() const { return mix_sample_rate; }
+        // Shelf of SA_MULTIPLY_LP_SHELF_GAIN or SA_MULTIPLY_HP_SHELF_GAIN at db, tuned to the mix rate.
+        nMath::ShelfFilterParams ShelfConfig(const MixScript::SourceAction action, const float db) const;
+        // The source, its samples and every buffer the read, automation and sends touch during the mix.
+        void WorkingMemory(MemoryRanges& ranges) const;
         bool Empty()const { return buffer == nullptr; }
 
         const MixerControl& GetControl(const MixScript::SourceAction action) const;
@@ -133,7 +220,24 @@ namespace MixScript
             const AudioRegion& region_, const std::vector<uint32_t>& cue_offsets);
 
     private:
-        int32_t FindMarkerPivot(const int32_t marker_id) const;
+        // read_pos the tempo reader expects next, anything else was a seek.
+        const uint8_t* tempo_read_pos;
+        float tempo_right;
+        float tempo_rate;
+        float sample_rate_ratio; // source frames per mix frame
+        uint32_t mix_sample_rate;
+        nMath::SincResampler resampler;
+        // Stretched frames at the file rate for a deck at another rate than the mix. The output frame is
+        // stretch_fraction past the frame at kLeadFrames.
+        std::array<float, nMath::SincResampler::kTaps> stretch_left;
+        std::array<float, nMath::SincResampler::kTaps> stretch_right;
+        double stretch_fraction;
+        float ReadStretched(const int channel);
+        // Restarts the stretched window at the stretcher's position.
+        void ResetStretchWindow();
+        float ReadVarispeed(const int channel);
+
+        void FindMarkerPivots(std::vector<int32_t>& pivots) const;
         void CorrectImpliedMarkers();
     };
 
@@ -0,0 +1,220 @@
+// nConvolution - partitioned fft convolution for impulse response effects
+// Author - Nic Taylor
+
+#include "nConvolution.h"
+#include "nMath.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <xmmintrin.h>
+
+namespace nMath {
+    namespace {
+        // accumulate += a * b over num_bins complex bins.
+        inline void MultiplyAccumulate(float const * const a_real, float const * const a_imag,
+            float const * const b_real, float const * const b_imag, float* accumulate_real, float* accumulate_imag,
+            const uint32_t num_bins) {
+            uint32_t bin = 0;
+            for (; bin + 4 <= num_bins; bin += 4) {
+                const __m128 ar = _mm_loadu_ps(a_real + bin);
+                const __m128 ai = _mm_loadu_ps(a_imag + bin);
+                const __m128 br = _mm_loadu_ps(b_real + bin);
+                const __m128 bi = _mm_loadu_ps(b_imag + bin);
+                const __m128 real = _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi));
+                const __m128 imag = _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br));
+                _mm_storeu_ps(accumulate_real + bin, _mm_add_ps(_mm_loadu_ps(accumulate_real + bin), real));
+                _mm_storeu_ps(accumulate_imag + bin, _mm_add_ps(_mm_loadu_ps(accumulate_imag + bin), imag));
+            }
+            for (; bin < num_bins; ++bin) {
+                accumulate_real[bin] += a_real[bin] * b_real[bin] - a_imag[bin] * b_imag[bin];
+                accumulate_imag[bin] += a_real[bin] * b_imag[bin] + a_imag[bin] * b_real[bin];
+            }
+        }
+    }
+
+    Convolver::Level::Level(const uint32_t size_, const uint32_t offset_, const uint32_t num_partitions_) :
+        size(size_), offset(offset_), num_partitions(num_partitions_), fft(size_), head(0), block_end(0),
+        block_slot(0) {
+        const size_t num_bins = static_cast<size_t>(num_partitions) * (size + 1);
+        for (int channel = 0; channel < 2; ++channel) {
+            partition_real[channel].resize(num_bins);
+            partition_imag[channel].resize(num_bins);
+            input_real[channel].resize(num_bins);
+            input_imag[channel].resize(num_bins);
+            accumulate_real[channel].resize(size + 1);
+            accumulate_imag[channel].resize(size + 1);
+        }
+    }
+
+    Convolver::Convolver(const std::vector<float>& left, const std::vector<float>& right, const float sample_rate_) :
+        sample_rate(sample_rate_), length(static_cast<uint32_t>(nMath::Max(left.size(), right.size()))),
+        frame(0), silent_frames(0), frame_silent(true), idle(true) {
+        // Level k has partitions of kBlockSize * 8^k. Past the head, a level starts at twice its partition size,
+        // so a block is first due a full period after its boundary and can be computed over that period.
+        uint32_t size = kBlockSize;
+        uint32_t offset = 0;
+        while (offset < length || levels.empty()) {
+            const uint32_t next_size = size * kLevelScale;
+            const uint32_t end = next_size <= kMaxBlockSize ? nMath::Min(2 * next_size, length) : length;
+            const uint32_t num_partitions = nMath::Max((end - nMath::Min(offset, end) + size - 1) / size, 1u);
+            levels.emplace_back(size, offset, num_partitions);
+            offset = end;
+            size = next_size;
+        }
+
+        const uint32_t max_size = levels.back().size;
+        history_size = 2 * max_size;
+        uint32_t output_size = 1;
+        while (output_size < levels.back().offset + 2 * max_size + kBlockSize) {
+            output_size <<= 1;
+        }
+        output_mask = output_size - 1;
+        for (int channel = 0; channel < 2; ++channel) {
+            history[channel].assign(2 * history_size, 0.f);
+            output[channel].assign(output_size, 0.f);
+        }
+        scratch_time.resize(2 * max_size);
+        // The last block of input can still be in flight for a period after it leaves the history.
+        idle_frames = length + 3 * max_size + kBlockSize;
+
+        for (Level& level : levels) {
+            for (int channel = 0; channel < 2; ++channel) {
+                const std::vector<float>& response = channel == 0 || right.empty() ? left : right;
+                for (uint32_t partition = 0; partition < level.num_partitions; ++partition) {
+                    const uint32_t start = level.offset + partition * level.size;
+                    std::fill(scratch_time.begin(), scratch_time.begin() + 2 * level.size, 0.f);
+                    for (uint32_t i = 0; i < level.size && start + i < response.size(); ++i) {
+                        scratch_time[i] = response[start + i];
+                    }
+                    const size_t bins = static_cast<size_t>(partition) * (level.size + 1);
+                    level.fft.RealForward(&scratch_time[0], &level.partition_real[channel][bins],
+                        &level.partition_imag[channel][bins]);
+                }
+            }
+        }
+    }
+
+    void Convolver::Reset() {
+        for (Level& level : levels) {
+            for (int channel = 0; channel < 2; ++channel) {
+                std::fill(level.input_real[channel].begin(), level.input_real[channel].end(), 0.f);
+                std::fill(level.input_imag[channel].begin(), level.input_imag[channel].end(), 0.f);
+                std::fill(level.accumulate_real[channel].begin(), level.accumulate_real[channel].end(), 0.f);
+                std::fill(level.accumulate_imag[channel].begin(), level.accumulate_imag[channel].end(), 0.f);
+            }
+            level.head = 0;
+            level.block_end = 0;
+            level.block_slot = 0;
+        }
+        for (int channel = 0; channel < 2; ++channel) {
+            std::fill(history[channel].begin(), history[channel].end(), 0.f);
+            std::fill(output[channel].begin(), output[channel].end(), 0.f);
+        }
+        frame = 0;
+        silent_frames = 0;
+        frame_silent = true;
+        idle = true;
+    }
+
+    void Convolver::StepLevel(Level& level, const uint32_t tick) {
+        const uint32_t num_ticks = level.size / kBlockSize;
+        if (tick == 0) {
+            level.block_end = frame + 1;
+            level.block_slot = level.head;
+            level.head = level.head + 1 == level.num_partitions ? 0 : level.head + 1;
+            BeginBlock(level, 0);
+            BeginBlock(level, 1);
+        }
+        // The head has one tick, too few to split.
+        if (num_ticks < 3) {
+            for (int channel = 0; channel < 2; ++channel) {
+                Accumulate(level, channel, 0, level.num_partitions);
+                EndBlock(level, channel);
+            }
+            return;
+        }
+        if (tick > 0 && tick + 1 < num_ticks) {
+            const uint32_t num_slices = num_ticks - 2;
+            const uint32_t first_partition = (tick - 1) * level.num_partitions / num_slices;
+            const uint32_t end_partition = tick * level.num_partitions / num_slices;
+            Accumulate(level, 0, first_partition, end_partition);
+            Accumulate(level, 1, first_partition, end_partition);
+        }
+        else if (tick + 1 == num_ticks) {
+            EndBlock(level, 0);
+            EndBlock(level, 1);
+        }
+    }
+
+    void Convolver::BeginBlock(Level& level, const int channel) {
+        // Newest 2 * size frames, the previous block then the one that just completed.
+        const uint32_t write = (level.block_end - 1) & (history_size - 1);
+        float const * const window = &history[channel][write + history_size + 1 - 2 * level.size];
+        const size_t slot_bins = static_cast<size_t>(level.block_slot) * (level.size + 1);
+        level.fft.RealForward(window, &level.input_real[channel][slot_bins], &level.input_imag[channel][slot_bins]);
+        std::fill(level.accumulate_real[channel].begin(), level.accumulate_real[channel].end(), 0.f);
+        std::fill(level.accumulate_imag[channel].begin(), level.accumulate_imag[channel].end(), 0.f);
+    }
+
+    void Convolver::Accumulate(Level& level, const int channel, const uint32_t first_partition,
+        const uint32_t end_partition) {
+        const uint32_t num_bins = level.size + 1;
+        // Partition p pairs with the block p periods older than the one in flight.
+        for (uint32_t partition = first_partition; partition < end_partition; ++partition) {
+            const uint32_t slot = (level.block_slot + level.num_partitions - partition) % level.num_partitions;
+            const size_t input_bins = static_cast<size_t>(slot) * num_bins;
+            const size_t partition_bins = static_cast<size_t>(partition) * num_bins;
+            MultiplyAccumulate(&level.input_real[channel][input_bins], &level.input_imag[channel][input_bins],
+                &level.partition_real[channel][partition_bins], &level.partition_imag[channel][partition_bins],
+                &level.accumulate_real[channel][0], &level.accumulate_imag[channel][0], num_bins);
+        }
+    }
+
+    void Convolver::EndBlock(Level& level, const int channel) {
+        level.fft.RealInverse(&level.accumulate_real[channel][0], &level.accumulate_imag[channel][0],
+            &scratch_time[0]);
+        // The second half is the valid linear convolution of the completed block.
+        const uint32_t due = level.block_end - level.size + level.offset + kBlockSize;
+        float* wet = &output[channel][0];
+        for (uint32_t i = 0; i < level.size; ++i) {
+            wet[(due + i) & output_mask] += scratch_time[level.size + i];
+        }
+    }
+
+    float Convolver::Process(const int channel, const float x) {
+        if (channel == 0) {
+            frame_silent = x == 0.f;
+        }
+        else {
+            frame_silent = frame_silent && x == 0.f;
+        }
+        if (idle) {
+            if (x == 0.f) {
+                return 0.f;
+            }
+            idle = false;
+            silent_frames = 0;
+        }
+
+        const uint32_t write = frame & (history_size - 1);
+        history[channel][write] = x;
+        history[channel][write + history_size] = x;
+        float& due = output[channel][frame & output_mask];
+        const float wet = due;
+        due = 0.f;
+        if (channel == 0) {
+            return wet;
+        }
+
+        if (((frame + 1) & (kBlockSize - 1)) == 0) {
+            const uint32_t block = (frame + 1) / kBlockSize;
+            for (Level& level : levels) {
+                StepLevel(level, block & (level.size / kBlockSize - 1));
+            }
+        }
+        ++frame;
+        silent_frames = frame_silent ? silent_frames + 1 : 0;
+        idle = silent_frames >= idle_frames;
+        return wet;
+    }
+}
@@ -0,0 +1,106 @@
+// nConvolution - partitioned fft convolution for impulse response effects
+// Author - Nic Taylor
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+#include "nExchange.h"
+#include "nFFT.h"
+
+namespace nMath {
+    // Stereo overlap-save convolution with non-uniform partitions. The head of the impulse response uses small
+    // partitions for low latency and each later level is 8 times larger, starting at twice its own partition size.
+    // That leaves a level one period to compute a block, so the work is spread over the kBlockSize ticks of the
+    // period: the forward ffts on the block boundary, the multiply-accumulate in slices of partitions, and the
+    // inverse ffts on the last tick. A tick costs at most two ffts of the largest level, never a whole level. All
+    // memory is allocated by the constructor so it can be built off the audio thread.
+    class Convolver {
+    public:
+        static constexpr uint32_t kBlockSize = 128; // latency in frames
+        static constexpr uint32_t kLevelScale = 8;
+        static constexpr uint32_t kMaxBlockSize = kBlockSize * kLevelScale * kLevelScale;
+
+        // right may be empty for a mono impulse response, both input channels then share left.
+        Convolver(const std::vector<float>& left, const std::vector<float>& right, const float sample_rate);
+
+        float SampleRate() const { return sample_rate; }
+        uint32_t Length() const { return length; }
+        void Reset();
+        // Left then right each frame. Returns the wet signal of the frame kBlockSize frames ago.
+        float Process(const int channel, const float x);
+        // Hands the partitions, history, output and scratch buffers to ranges.Add.
+        template <class Ranges>
+        void WorkingMemory(Ranges& ranges) const {
+            ranges.Add(levels);
+            for (const Level& level : levels) {
+                level.fft.WorkingMemory(ranges);
+                for (int channel = 0; channel < 2; ++channel) {
+                    ranges.Add(level.partition_real[channel]);
+                    ranges.Add(level.partition_imag[channel]);
+                    ranges.Add(level.input_real[channel]);
+                    ranges.Add(level.input_imag[channel]);
+                    ranges.Add(level.accumulate_real[channel]);
+                    ranges.Add(level.accumulate_imag[channel]);
+                }
+            }
+            for (int channel = 0; channel < 2; ++channel) {
+                ranges.Add(history[channel]);
+                ranges.Add(output[channel]);
+            }
+            ranges.Add(scratch_time);
+        }
+
+    private:
+        struct Level {
+            Level(const uint32_t size_, const uint32_t offset_, const uint32_t num_partitions_);
+
+            uint32_t size;
+            uint32_t offset; // frames into the impulse response
+            uint32_t num_partitions;
+            FFT fft; // size points, real transforms of 2 * size
+            // Partition spectra of size + 1 bins, per channel.
+            std::array<std::vector<float>, 2> partition_real;
+            std::array<std::vector<float>, 2> partition_imag;
+            // Spectra of the last num_partitions input blocks, slot head is the next one written.
+            std::array<std::vector<float>, 2> input_real;
+            std::array<std::vector<float>, 2> input_imag;
+            uint32_t head;
+            // Block in flight over the current period, started when frame + 1 was block_end.
+            std::array<std::vector<float>, 2> accumulate_real;
+            std::array<std::vector<float>, 2> accumulate_imag;
+            uint32_t block_end;
+            uint32_t block_slot;
+        };
+
+        float sample_rate;
+        uint32_t length;
+        std::vector<Level> levels;
+        // Input history per channel doubled so the last 2 * size frames of any level are contiguous.
+        std::array<std::vector<float>, 2> history;
+        uint32_t history_size;
+        // Wet output per channel indexed by the frame it is due.
+        std::array<std::vector<float>, 2> output;
+        uint32_t output_mask;
+        std::vector<float> scratch_time;
+        uint32_t frame;
+        // Once the input has been silent for longer than the response, the state is all zeros and Process skips
+        // the work until the input is not.
+        uint32_t silent_frames;
+        uint32_t idle_frames;
+        bool frame_silent;
+        bool idle;
+
+        // Step tick of the size / kBlockSize ticks in a level's period, 0 on its block boundary.
+        void StepLevel(Level& level, const uint32_t tick);
+        void BeginBlock(Level& level, const int channel);
+        void Accumulate(Level& level, const int channel, const uint32_t first_partition, const uint32_t end_partition);
+        void EndBlock(Level& level, const int channel);
+    };
+
+    // Convolvers prepared on a loading thread for the audio thread.
+    typedef Exchange<Convolver> ConvolverExchange;
+}
@@ -0,0 +1,76 @@
+// nCrossover - Linkwitz-Riley band splitting
+// Author - Nic Taylor
+
+#include "nCrossover.h"
+
+#include <string.h>
+#include <xmmintrin.h>
+
+namespace nMath {
+    BiquadLanes::BiquadLanes() {
+        for (int32_t lane = 0; lane < 4; ++lane) {
+            SetLane(lane, TwoPoleNullConfig());
+        }
+        Reset();
+    }
+
+    void BiquadLanes::SetLane(const int32_t lane, const TwoPoleFilterParams& params) {
+        b0[lane] = params.b0;
+        b1[lane] = params.b1;
+        b2[lane] = params.b2;
+        a1[lane] = params.a1;
+        a2[lane] = params.a2;
+    }
+
+    void BiquadLanes::Reset() {
+        memset(z1, 0, sizeof(z1));
+        memset(z2, 0, sizeof(z2));
+    }
+
+    void BiquadLanes::Apply(float* lanes) {
+        const __m128 x = _mm_load_ps(lanes);
+        const __m128 s1 = _mm_load_ps(z1);
+        const __m128 y = _mm_add_ps(_mm_mul_ps(_mm_load_ps(b0), x), s1);
+        const __m128 next_z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_load_ps(b1), x), _mm_mul_ps(_mm_load_ps(a1), y)),
+            _mm_load_ps(z2));
+        const __m128 next_z2 = _mm_sub_ps(_mm_mul_ps(_mm_load_ps(b2), x), _mm_mul_ps(_mm_load_ps(a2), y));
+        _mm_store_ps(z1, next_z1);
+        _mm_store_ps(z2, next_z2);
+        _mm_store_ps(lanes, y);
+    }
+
+    void ThreeBandIsolator::Prepare(const float low_percent, const float high_percent) {
+        const TwoPoleFilterParams low_lp = TwoPoleButterworthLowPassConfig(low_percent);
+        const TwoPoleFilterParams low_hp = TwoPoleButterworthHighPassConfig(low_percent);
+        const TwoPoleFilterParams high_lp = TwoPoleButterworthLowPassConfig(high_percent);
+        const TwoPoleFilterParams high_hp = TwoPoleButterworthHighPassConfig(high_percent);
+        // Lane 0 low, 1 mid, 2 high, 3 unused.
+        stages[0].SetLane(0, low_lp);
+        stages[1].SetLane(0, low_lp);
+        stages[2].SetLane(0, TwoPoleButterworthAllPassConfig(high_percent));
+        stages[0].SetLane(1, low_hp);
+        stages[1].SetLane(1, low_hp);
+        stages[2].SetLane(1, high_lp);
+        stages[3].SetLane(1, high_lp);
+        stages[0].SetLane(2, low_hp);
+        stages[1].SetLane(2, low_hp);
+        stages[2].SetLane(2, high_hp);
+        stages[3].SetLane(2, high_hp);
+        Reset();
+    }
+
+    void ThreeBandIsolator::Reset() {
+        for (BiquadLanes& stage : stages) {
+            stage.Reset();
+        }
+    }
+
+    float ThreeBandIsolator::Process(const float x, const float low_gain, const float mid_gain,
+        const float high_gain) {
+        alignas(16) float lanes[4] = { x, x, x, 0.f };
+        for (BiquadLanes& stage : stages) {
+            stage.Apply(lanes);
+        }
+        return lanes[0] * low_gain + lanes[1] * mid_gain + lanes[2] * high_gain;
+    }
+}
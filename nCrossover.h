@@ -0,0 +1,46 @@
+// nCrossover - Linkwitz-Riley band splitting
+// Author - Nic Taylor
+
+#pragma once
+#include <array>
+#include <stdint.h>
+
+#include "nFilters.h"
+
+namespace nMath {
+    // Four biquads side by side in SSE lanes, each with its own coefficients and input. Transposed direct form II.
+    class BiquadLanes {
+    public:
+        BiquadLanes();
+
+        void SetLane(const int32_t lane, const TwoPoleFilterParams& params);
+        void Reset();
+        // In place on 4 floats, 16 byte aligned.
+        void Apply(float* lanes);
+
+    private:
+        alignas(16) float b0[4];
+        alignas(16) float b1[4];
+        alignas(16) float b2[4];
+        alignas(16) float a1[4];
+        alignas(16) float a2[4];
+        alignas(16) float z1[4];
+        alignas(16) float z2[4];
+    };
+
+    // Low, mid and high bands from two LR4 crossovers. Each band runs its whole cascade in one lane, so the three
+    // bands cost four vector biquads and the band gains are a dot product. The low band passes through the upper
+    // crossover's allpass so the bands at unity gain sum to a flat magnitude.
+    class ThreeBandIsolator {
+    public:
+        static constexpr int32_t kStages = 4;
+
+        // Crossover frequencies as a percent of the sample rate.
+        void Prepare(const float low_percent, const float high_percent);
+        void Reset();
+        float Process(const float x, const float low_gain, const float mid_gain, const float high_gain);
+
+    private:
+        std::array<BiquadLanes, kStages> stages;
+    };
+}
@@ -0,0 +1,73 @@
+// nDelay - feedback delay lines
+// Author - Nic Taylor
+
+#include "nDelay.h"
+#include "nMath.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <algorithm>
+
+namespace nMath {
+    namespace {
+        constexpr float kFeedbackLowPassHz = 4000.f;
+        constexpr float kFeedbackHighPassHz = 150.f;
+        constexpr float kButterworthK = 1.41421356f;
+    }
+
+    FeedbackDelay::FeedbackDelay() : sample_rate(0.f), mask(0), write_index(0), delay_frames(1.f),
+        target_frames(1.f), max_frames(1.f), glide_coeff(1.f), low_pass_g(0.f), high_pass_g(0.f) {
+    }
+
+    void FeedbackDelay::Prepare(const float sample_rate_, const float max_seconds) {
+        sample_rate = sample_rate_;
+        uint32_t size = 4;
+        // Room for the interpolation tap past the longest delay.
+        while (size < static_cast<uint32_t>(max_seconds * sample_rate) + 2) {
+            size <<= 1;
+        }
+        mask = size - 1;
+        for (std::vector<float>& buffer : buffers) {
+            buffer.assign(size, 0.f);
+        }
+        max_frames = static_cast<float>(size - 2);
+        glide_coeff = 1.f - expf(-1.f / (0.05f * sample_rate));
+        low_pass_g = tanf(static_cast<float>(M_PI) * nMath::Min(kFeedbackLowPassHz, 0.45f * sample_rate) / sample_rate);
+        high_pass_g = tanf(static_cast<float>(M_PI) * kFeedbackHighPassHz / sample_rate);
+        Reset();
+    }
+
+    void FeedbackDelay::Reset() {
+        for (std::vector<float>& buffer : buffers) {
+            std::fill(buffer.begin(), buffer.end(), 0.f);
+        }
+        for (int channel = 0; channel < 2; ++channel) {
+            low_pass[channel].Reset();
+            high_pass[channel].Reset();
+        }
+        write_index = 0;
+        delay_frames = target_frames;
+    }
+
+    void FeedbackDelay::SetDelayFrames(const float frames) {
+        target_frames = nMath::Clamp(frames, 1.f, max_frames);
+    }
+
+    float FeedbackDelay::Process(const int channel, const float x, const float feedback) {
+        std::vector<float>& buffer = buffers[channel];
+        const uint32_t whole = static_cast<uint32_t>(delay_frames);
+        const float fraction = delay_frames - whole;
+        const float newer = buffer[(write_index - whole) & mask];
+        const float older = buffer[(write_index - whole - 1) & mask];
+        const float delayed = newer + (older - newer) * fraction;
+
+        const float darker = low_pass[channel].Process(delayed, low_pass_g, kButterworthK).low;
+        const float thinner = high_pass[channel].Process(darker, high_pass_g, kButterworthK).high;
+        buffer[write_index] = x + nMath::Clamp(feedback, 0.f, kMaxFeedback) * thinner;
+        if (channel == 1) {
+            write_index = (write_index + 1) & mask;
+            delay_frames += (target_frames - delay_frames) * glide_coeff;
+        }
+        return delayed;
+    }
+}
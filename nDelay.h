@@ -0,0 +1,50 @@
+// nDelay - feedback delay lines
+// Author - Nic Taylor
+
+#pragma once
+#include <array>
+#include <vector>
+#include <stdint.h>
+
+#include "nFilters.h"
+
+namespace nMath {
+    // Stereo feedback delay on a buffer allocated once by Prepare. The delay glides to its target over about
+    // 50 ms, so a tempo change bends the repeats instead of clicking, and a band pass in the feedback path darkens
+    // and thins each repeat. Cost per frame is the same for any delay or feedback.
+    class FeedbackDelay {
+    public:
+        static constexpr float kMaxFeedback = 0.9f;
+
+        FeedbackDelay();
+
+        void Prepare(const float sample_rate, const float max_seconds);
+        void Reset();
+        float SampleRate() const { return sample_rate; }
+        bool Prepared() const { return !buffers[0].empty(); }
+        // Clamped to the buffer.
+        void SetDelayFrames(const float frames);
+        // Left then right each frame. x goes into the line and the delayed signal comes out.
+        float Process(const int channel, const float x, const float feedback);
+        // Hands the delay lines to ranges.Add, to lock them in memory.
+        template <class Ranges>
+        void WorkingMemory(Ranges& ranges) const {
+            ranges.Add(buffers[0]);
+            ranges.Add(buffers[1]);
+        }
+
+    private:
+        float sample_rate;
+        std::array<std::vector<float>, 2> buffers;
+        uint32_t mask;
+        uint32_t write_index;
+        float delay_frames;
+        float target_frames;
+        float max_frames;
+        float glide_coeff;
+        float low_pass_g;
+        float high_pass_g;
+        std::array<StateVariableFilter, 2> low_pass;
+        std::array<StateVariableFilter, 2> high_pass;
+    };
+}
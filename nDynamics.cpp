@@ -0,0 +1,120 @@
+// nDynamics - gain riding processors
+// Author - Nic Taylor
+
+#include "nDynamics.h"
+#include "nMath.h"
+#include "nResampler.h"
+
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <assert.h>
+#include <xmmintrin.h>
+
+namespace nMath {
+    LookaheadLimiter::LookaheadLimiter() : bypass(false), ceiling(1.f), release_coeff(0.f), lookahead(0),
+        latency(0), history_index(0), hold_index(0), average_sum(0.0), delay_index(0), release_gain(1.f),
+        gain_out(1.f) {
+        SetCeiling(-1.f);
+    }
+
+    void LookaheadLimiter::Prepare(const float sample_rate, const float lookahead_ms, const float release_ms) {
+        assert(sample_rate > 0.f);
+        // The sinc interpolator's taps at quarter frames give the oversampled signal between frames.
+        static_assert(kTaps == SincResampler::kTaps, "Limiter taps follow the interpolator.");
+        const SincResampler interpolator;
+        phase_coefficients.resize(kTaps * kOversampling);
+        float coefficients[kTaps];
+        for (int32_t phase = 0; phase < kOversampling; ++phase) {
+            interpolator.Coefficients(phase / static_cast<float>(kOversampling), coefficients);
+            for (int32_t tap = 0; tap < kTaps; ++tap) {
+                phase_coefficients[tap * kOversampling + phase] = coefficients[tap];
+            }
+        }
+
+        lookahead = nMath::Max(static_cast<int32_t>(ceilf(lookahead_ms * 0.001f * sample_rate / 4.f)) * 4, 4);
+        // A peak is detected kTailFrames after it arrives and must leave the delay at the end of its hold.
+        latency = lookahead - 1 + SincResampler::kTailFrames;
+        release_coeff = 1.f - expf(-1.f / (release_ms * 0.001f * sample_rate));
+
+        history_left.assign(2 * kTaps, 0.f);
+        history_right.assign(2 * kTaps, 0.f);
+        hold.assign(lookahead, 1.f);
+        average.assign(lookahead, 1.f);
+        delay_left.assign(latency + 1, 0.f);
+        delay_right.assign(latency + 1, 0.f);
+        Reset();
+    }
+
+    void LookaheadLimiter::Reset() {
+        std::fill(history_left.begin(), history_left.end(), 0.f);
+        std::fill(history_right.begin(), history_right.end(), 0.f);
+        std::fill(hold.begin(), hold.end(), 1.f);
+        std::fill(average.begin(), average.end(), 1.f);
+        std::fill(delay_left.begin(), delay_left.end(), 0.f);
+        std::fill(delay_right.begin(), delay_right.end(), 0.f);
+        history_index = 0;
+        hold_index = 0;
+        delay_index = 0;
+        average_sum = static_cast<double>(lookahead);
+        release_gain = 1.f;
+        gain_out = 1.f;
+    }
+
+    void LookaheadLimiter::SetCeiling(const float ceiling_db) {
+        ceiling = powf(10.f, ceiling_db / 20.f);
+    }
+
+    float LookaheadLimiter::TruePeak(float const * const taps) const {
+        // One lane per phase, each tap broadcast across the lanes.
+        __m128 sum = _mm_setzero_ps();
+        for (int32_t tap = 0; tap < kTaps; ++tap) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(taps[tap]),
+                _mm_loadu_ps(&phase_coefficients[tap * kOversampling])));
+        }
+        const __m128 magnitude = _mm_max_ps(sum, _mm_sub_ps(_mm_setzero_ps(), sum));
+        const __m128 pairs = _mm_max_ps(magnitude, _mm_movehl_ps(magnitude, magnitude));
+        // The interpolator is a low pass, the sample itself can be the peak of broadband material.
+        return nMath::Max(_mm_cvtss_f32(_mm_max_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1))),
+            fabsf(taps[SincResampler::kLeadFrames]));
+    }
+
+    void LookaheadLimiter::Process(float& left, float& right) {
+        if (lookahead == 0) {
+            return;
+        }
+        history_left[history_index] = left;
+        history_left[history_index + kTaps] = left;
+        history_right[history_index] = right;
+        history_right[history_index + kTaps] = right;
+        history_index = history_index + 1 < kTaps ? history_index + 1 : 0;
+        const float peak = nMath::Max(TruePeak(&history_left[history_index]),
+            TruePeak(&history_right[history_index]));
+        const float required = peak > ceiling ? ceiling / peak : 1.f;
+
+        hold[hold_index] = required;
+        hold_index = hold_index + 1 < lookahead ? hold_index + 1 : 0;
+        __m128 held = _mm_loadu_ps(&hold[0]);
+        for (int32_t i = 4; i < lookahead; i += 4) {
+            held = _mm_min_ps(held, _mm_loadu_ps(&hold[i]));
+        }
+        held = _mm_min_ps(held, _mm_movehl_ps(held, held));
+        const float held_gain = _mm_cvtss_f32(_mm_min_ss(held, _mm_shuffle_ps(held, held, 1)));
+
+        release_gain = held_gain < release_gain ? held_gain :
+            release_gain + (held_gain - release_gain) * release_coeff;
+        // hold_index is also the oldest slot of the average.
+        average_sum += release_gain - average[hold_index];
+        average[hold_index] = release_gain;
+        const float gain = bypass ? 1.f : static_cast<float>(average_sum / lookahead);
+
+        delay_left[delay_index] = left;
+        delay_right[delay_index] = right;
+        delay_index = delay_index < latency ? delay_index + 1 : 0;
+        // Rounding in the average can leave a hair over the ceiling.
+        const float limit = bypass ? FLT_MAX : ceiling;
+        left = nMath::Clamp(delay_left[delay_index] * gain, -limit, limit);
+        right = nMath::Clamp(delay_right[delay_index] * gain, -limit, limit);
+        gain_out = gain;
+    }
+}
@@ -0,0 +1,63 @@
+// nDynamics - gain riding processors
+// Author - Nic Taylor
+
+#pragma once
+#include <vector>
+#include <stdint.h>
+
+namespace nMath {
+    // Stereo linked lookahead limiter on 4x oversampled true peaks. The gain needed by a peak is held across the
+    // lookahead window and box averaged over the same window, so the gain is fully down by the time the peak
+    // leaves the delay line. Latency is fixed by Prepare and does not change with bypass.
+    class LookaheadLimiter {
+    public:
+        static constexpr int32_t kOversampling = 4;
+
+        LookaheadLimiter();
+
+        void Prepare(const float sample_rate, const float lookahead_ms = 1.5f, const float release_ms = 80.f);
+        void Reset();
+        void SetCeiling(const float ceiling_db);
+        // Frames between a sample going in and coming out.
+        int32_t Latency() const { return latency; }
+        // Linear gain applied to the last frame out.
+        float Gain() const { return gain_out; }
+        // In place, the output is the input from Latency() frames ago.
+        void Process(float& left, float& right);
+        // Hands every buffer Process touches to ranges.Add.
+        template <class Ranges>
+        void WorkingMemory(Ranges& ranges) const {
+            for (const std::vector<float>* buffer : { &phase_coefficients, &history_left, &history_right, &hold,
+                &average, &delay_left, &delay_right }) {
+                ranges.Add(*buffer);
+            }
+        }
+
+        bool bypass;
+
+    private:
+        static constexpr int32_t kTaps = 16;
+
+        float ceiling;
+        float release_coeff;
+        int32_t lookahead; // multiple of 4
+        int32_t latency;
+        // Phase coefficients interleaved by tap, kTaps * kOversampling.
+        std::vector<float> phase_coefficients;
+        // Input history per channel doubled so the taps are contiguous.
+        std::vector<float> history_left;
+        std::vector<float> history_right;
+        int32_t history_index;
+        std::vector<float> hold;
+        int32_t hold_index;
+        std::vector<float> average;
+        double average_sum;
+        std::vector<float> delay_left;
+        std::vector<float> delay_right;
+        int32_t delay_index;
+        float release_gain;
+        float gain_out;
+
+        float TruePeak(float const * const taps) const;
+    };
+}
@@ -0,0 +1,71 @@
+// nExchange - hands objects built on a loading thread to the audio thread
+// Author - Nic Taylor
+
+#pragma once
+#include <atomic>
+#include <memory>
+#include <assert.h>
+
+namespace nMath {
+    // Hands objects prepared on a loading thread to the audio thread. Neither side locks and the audio thread
+    // never frees, a replaced object is parked until the next Publish or destruction. T has Reset and a
+    // WorkingMemory template like the other audio path types.
+    template <class T>
+    class Exchange {
+    public:
+        Exchange() : published(nullptr), pending(nullptr), retired(nullptr), active(nullptr) {}
+        ~Exchange() {
+            delete pending.exchange(nullptr);
+            delete retired.exchange(nullptr);
+            delete active;
+        }
+        Exchange(const Exchange&) = delete;
+        Exchange& operator=(const Exchange&) = delete;
+
+        // Loading thread.
+        void Publish(std::unique_ptr<T> object) {
+            assert(object != nullptr);
+            delete retired.exchange(nullptr);
+            published = object.get();
+            delete pending.exchange(object.release());
+        }
+        // Loading thread while the audio thread is not running.
+        void Reset() {
+            Acquire();
+            if (active != nullptr) {
+                active->Reset();
+            }
+        }
+        // Audio thread, once per block. Installs the latest published object.
+        T* Acquire() {
+            // Wait for the loading thread to free the last one parked rather than dropping it.
+            if (retired.load() == nullptr) {
+                T* next = pending.exchange(nullptr);
+                if (next != nullptr) {
+                    retired.store(active);
+                    active = next;
+                }
+            }
+            return active;
+        }
+        T* Active() const { return active; }
+        // Loading thread. The last published object, nullptr until the first Publish.
+        const T* Published() const { return published; }
+        bool HasPublished() const { return published != nullptr; }
+        // Loading thread. The last published object and its buffers, it is alive until the next Publish.
+        template <class Ranges>
+        void WorkingMemory(Ranges& ranges) const {
+            if (published != nullptr) {
+                ranges.Add(published, sizeof(T));
+                published->WorkingMemory(ranges);
+            }
+        }
+
+    private:
+        // Loading thread only.
+        T* published;
+        std::atomic<T*> pending;
+        std::atomic<T*> retired;
+        T* active;
+    };
+}
@@ -0,0 +1,176 @@
+// nFFT - radix 2 fft on split real and imaginary arrays
+// Author - Nic Taylor
+
+#include "nFFT.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <assert.h>
+#include <utility>
+#include <xmmintrin.h>
+
+namespace nMath {
+    FFT::FFT(const uint32_t size_) : size(size_) {
+        assert(size >= 4 && (size & (size - 1)) == 0);
+        uint32_t log2 = 0;
+        while ((1u << log2) < size) {
+            ++log2;
+        }
+        bit_reverse.resize(size);
+        for (uint32_t i = 0; i < size; ++i) {
+            uint32_t reversed = 0;
+            for (uint32_t bit = 0; bit < log2; ++bit) {
+                reversed |= ((i >> bit) & 1u) << (log2 - 1 - bit);
+            }
+            bit_reverse[i] = reversed;
+        }
+
+        twiddle_real.resize(size);
+        twiddle_imag.resize(size);
+        for (uint32_t half = 1; half < size; half <<= 1) {
+            for (uint32_t j = 0; j < half; ++j) {
+                const double angle = -M_PI * j / half;
+                twiddle_real[half - 1 + j] = static_cast<float>(cos(angle));
+                twiddle_imag[half - 1 + j] = static_cast<float>(sin(angle));
+            }
+        }
+
+        real_twiddle_real.resize(size / 2 + 1);
+        real_twiddle_imag.resize(size / 2 + 1);
+        for (uint32_t k = 0; k <= size / 2; ++k) {
+            const double angle = -M_PI * k / size;
+            real_twiddle_real[k] = static_cast<float>(cos(angle));
+            real_twiddle_imag[k] = static_cast<float>(sin(angle));
+        }
+    }
+
+    template <bool kInverse>
+    void FFT::Transform(float* real, float* imag) const {
+        for (uint32_t i = 0; i < size; ++i) {
+            const uint32_t j = bit_reverse[i];
+            if (i < j) {
+                std::swap(real[i], real[j]);
+                std::swap(imag[i], imag[j]);
+            }
+        }
+
+        // First two stages have fewer butterflies per block than SSE lanes.
+        for (uint32_t half = 1; half < 4; half <<= 1) {
+            for (uint32_t block = 0; block < size; block += 2 * half) {
+                for (uint32_t j = 0; j < half; ++j) {
+                    const float wr = twiddle_real[half - 1 + j];
+                    const float wi = kInverse ? -twiddle_imag[half - 1 + j] : twiddle_imag[half - 1 + j];
+                    const uint32_t a = block + j;
+                    const uint32_t b = a + half;
+                    const float tr = real[b] * wr - imag[b] * wi;
+                    const float ti = real[b] * wi + imag[b] * wr;
+                    real[b] = real[a] - tr;
+                    imag[b] = imag[a] - ti;
+                    real[a] += tr;
+                    imag[a] += ti;
+                }
+            }
+        }
+
+        const __m128 sign = _mm_set1_ps(kInverse ? -1.f : 1.f);
+        for (uint32_t half = 4; half < size; half <<= 1) {
+            float const * const stage_real = &twiddle_real[half - 1];
+            float const * const stage_imag = &twiddle_imag[half - 1];
+            for (uint32_t block = 0; block < size; block += 2 * half) {
+                float* a_real = real + block;
+                float* a_imag = imag + block;
+                float* b_real = a_real + half;
+                float* b_imag = a_imag + half;
+                for (uint32_t j = 0; j < half; j += 4) {
+                    const __m128 wr = _mm_loadu_ps(stage_real + j);
+                    const __m128 wi = _mm_mul_ps(_mm_loadu_ps(stage_imag + j), sign);
+                    const __m128 br = _mm_loadu_ps(b_real + j);
+                    const __m128 bi = _mm_loadu_ps(b_imag + j);
+                    const __m128 tr = _mm_sub_ps(_mm_mul_ps(br, wr), _mm_mul_ps(bi, wi));
+                    const __m128 ti = _mm_add_ps(_mm_mul_ps(br, wi), _mm_mul_ps(bi, wr));
+                    const __m128 ar = _mm_loadu_ps(a_real + j);
+                    const __m128 ai = _mm_loadu_ps(a_imag + j);
+                    _mm_storeu_ps(b_real + j, _mm_sub_ps(ar, tr));
+                    _mm_storeu_ps(b_imag + j, _mm_sub_ps(ai, ti));
+                    _mm_storeu_ps(a_real + j, _mm_add_ps(ar, tr));
+                    _mm_storeu_ps(a_imag + j, _mm_add_ps(ai, ti));
+                }
+            }
+        }
+    }
+
+    void FFT::Forward(float* real, float* imag) const {
+        Transform<false>(real, imag);
+    }
+
+    void FFT::Inverse(float* real, float* imag) const {
+        Transform<true>(real, imag);
+        const __m128 scale = _mm_set1_ps(1.f / size);
+        for (uint32_t i = 0; i < size; i += 4) {
+            _mm_storeu_ps(real + i, _mm_mul_ps(_mm_loadu_ps(real + i), scale));
+            _mm_storeu_ps(imag + i, _mm_mul_ps(_mm_loadu_ps(imag + i), scale));
+        }
+    }
+
+    void FFT::RealForward(const float* input, float* real, float* imag) const {
+        // Even samples as real, odd as imaginary, then untangle the two spectra.
+        for (uint32_t i = 0; i < size; ++i) {
+            real[i] = input[2 * i];
+            imag[i] = input[2 * i + 1];
+        }
+        Forward(real, imag);
+
+        const float dc_real = real[0];
+        const float dc_imag = imag[0];
+        real[0] = dc_real + dc_imag;
+        imag[0] = 0.f;
+        real[size] = dc_real - dc_imag;
+        imag[size] = 0.f;
+        for (uint32_t k = 1; k <= size / 2; ++k) {
+            const uint32_t m = size - k;
+            // Xe = (Z[k] + conj(Z[m])) / 2, Xo = (Z[k] - conj(Z[m])) / 2i
+            const float even_real = 0.5f * (real[k] + real[m]);
+            const float even_imag = 0.5f * (imag[k] - imag[m]);
+            const float odd_real = 0.5f * (imag[k] + imag[m]);
+            const float odd_imag = -0.5f * (real[k] - real[m]);
+            const float wr = real_twiddle_real[k];
+            const float wi = real_twiddle_imag[k];
+            const float tr = odd_real * wr - odd_imag * wi;
+            const float ti = odd_real * wi + odd_imag * wr;
+            // X[k] = Xe + W Xo, X[m] = conj(Xe - W Xo)
+            real[k] = even_real + tr;
+            imag[k] = even_imag + ti;
+            real[m] = even_real - tr;
+            imag[m] = ti - even_imag;
+        }
+    }
+
+    void FFT::RealInverse(float* real, float* imag, float* output) const {
+        const float dc = real[0];
+        const float nyquist = real[size];
+        real[0] = 0.5f * (dc + nyquist);
+        imag[0] = 0.5f * (dc - nyquist);
+        for (uint32_t k = 1; k <= size / 2; ++k) {
+            const uint32_t m = size - k;
+            const float even_real = 0.5f * (real[k] + real[m]);
+            const float even_imag = 0.5f * (imag[k] - imag[m]);
+            const float diff_real = 0.5f * (real[k] - real[m]);
+            const float diff_imag = 0.5f * (imag[k] + imag[m]);
+            // Xo = conj(W) (X[k] - conj(X[m])) / 2
+            const float wr = real_twiddle_real[k];
+            const float wi = real_twiddle_imag[k];
+            const float odd_real = diff_real * wr + diff_imag * wi;
+            const float odd_imag = diff_imag * wr - diff_real * wi;
+            // Z[k] = Xe + i Xo, Z[m] = conj(Xe) + i conj(Xo)
+            real[k] = even_real - odd_imag;
+            imag[k] = even_imag + odd_real;
+            real[m] = even_real + odd_imag;
+            imag[m] = odd_real - even_imag;
+        }
+        Inverse(real, imag);
+        for (uint32_t i = 0; i < size; ++i) {
+            output[2 * i] = real[i];
+            output[2 * i + 1] = imag[i];
+        }
+    }
+}
@@ -0,0 +1,55 @@
+// nFFT - radix 2 fft on split real and imaginary arrays
+// Author - Nic Taylor
+
+#pragma once
+#include <vector>
+#include <stdint.h>
+
+namespace nMath {
+    // Complex transform of size points, a power of 2 of at least 4. Const methods only touch the caller's
+    // buffers so one FFT can be shared between threads.
+    class FFT {
+    public:
+        explicit FFT(const uint32_t size);
+
+        uint32_t Size() const { return size; }
+
+        // In place. Inverse is scaled by 1 / size.
+        void Forward(float* real, float* imag) const;
+        void Inverse(float* real, float* imag) const;
+
+        // Transform of 2 * size real samples. real and imag hold size + 1 bins, DC to Nyquist.
+        void RealForward(const float* input, float* real, float* imag) const;
+        // Inverse of RealForward into 2 * size samples. Overwrites real and imag.
+        void RealInverse(float* real, float* imag, float* output) const;
+        template <class Ranges>
+        void WorkingMemory(Ranges& ranges) const {
+            ranges.Add(bit_reverse);
+            for (const std::vector<float>* table : { &twiddle_real, &twiddle_imag, &real_twiddle_real,
+                &real_twiddle_imag }) {
+                ranges.Add(*table);
+            }
+        }
+
+    private:
+        uint32_t size;
+        std::vector<uint32_t> bit_reverse;
+        // Twiddles of the stage with half size h start at h - 1.
+        std::vector<float> twiddle_real;
+        std::vector<float> twiddle_imag;
+        // exp(-i pi k / size) for splitting the real transform, k <= size / 2.
+        std::vector<float> real_twiddle_real;
+        std::vector<float> real_twiddle_imag;
+
+        template <bool kInverse>
+        void Transform(float* real, float* imag) const;
+    };
+
+    inline uint32_t NextPowerOf2(const uint32_t value) {
+        uint32_t power = 1;
+        while (power < value) {
+            power <<= 1;
+        }
+        return power;
+    }
+}
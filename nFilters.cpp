@@ -48,4 +48,56 @@ namespace nMath {
 
         return TwoPoleFilterParams(b0 * inv_a0, b1 * inv_a0, b2 * inv_a0, a1 * inv_a0, a2 * inv_a0);
     }
-}
\ No newline at end of file
+
+    TwoPoleFilterParams TwoPoleButterworthLowPassConfig(const float cuttoff_percent)
+    {
+        const float filter_cutoff = 2.f * (float)M_PI * cuttoff_percent;
+        const float omega_cos = cosf(filter_cutoff);
+        const float alpha = sinf(filter_cutoff) * (float)M_SQRT1_2;
+
+        const float inv_a0 = 1.f / (1.f + alpha);
+        const float b1 = 1.f - omega_cos;
+        return TwoPoleFilterParams(0.5f * b1 * inv_a0, b1 * inv_a0, 0.5f * b1 * inv_a0,
+            -2.f * omega_cos * inv_a0, (1.f - alpha) * inv_a0);
+    }
+
+    TwoPoleFilterParams TwoPoleButterworthHighPassConfig(const float cuttoff_percent)
+    {
+        const float filter_cutoff = 2.f * (float)M_PI * cuttoff_percent;
+        const float omega_cos = cosf(filter_cutoff);
+        const float alpha = sinf(filter_cutoff) * (float)M_SQRT1_2;
+
+        const float inv_a0 = 1.f / (1.f + alpha);
+        const float b1 = -(1.f + omega_cos);
+        return TwoPoleFilterParams(-0.5f * b1 * inv_a0, b1 * inv_a0, -0.5f * b1 * inv_a0,
+            -2.f * omega_cos * inv_a0, (1.f - alpha) * inv_a0);
+    }
+
+    TwoPoleFilterParams TwoPoleButterworthAllPassConfig(const float cuttoff_percent)
+    {
+        const float filter_cutoff = 2.f * (float)M_PI * cuttoff_percent;
+        const float omega_cos = cosf(filter_cutoff);
+        const float alpha = sinf(filter_cutoff) * (float)M_SQRT1_2;
+
+        const float inv_a0 = 1.f / (1.f + alpha);
+        return TwoPoleFilterParams((1.f - alpha) * inv_a0, -2.f * omega_cos * inv_a0, 1.f,
+            -2.f * omega_cos * inv_a0, (1.f - alpha) * inv_a0);
+    }
+
+    // Based on 'Linear Trapezoidal Integrated SVF' by Andrew Simper.
+    ShelfFilterParams ShelfButterworthLowConfig(const float cuttoff_percent, const float gain_db)
+    {
+        const float sqrt_gain = powf(10.f, gain_db / 40.f);
+        const float k = (float)M_SQRT2;
+        return ShelfFilterParams{ tanf((float)M_PI * cuttoff_percent) / sqrtf(sqrt_gain), k,
+            1.f, k * (sqrt_gain - 1.f), sqrt_gain * sqrt_gain - 1.f };
+    }
+
+    ShelfFilterParams ShelfButterworthHighConfig(const float cuttoff_percent, const float gain_db)
+    {
+        const float sqrt_gain = powf(10.f, gain_db / 40.f);
+        const float k = (float)M_SQRT2;
+        return ShelfFilterParams{ tanf((float)M_PI * cuttoff_percent) * sqrtf(sqrt_gain), k,
+            sqrt_gain * sqrt_gain, k * (1.f - sqrt_gain) * sqrt_gain, 1.f - sqrt_gain * sqrt_gain };
+    }
+}
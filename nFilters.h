@@ -42,9 +42,71 @@ namespace nMath {
         }
     };
     
+    // Pade approximant of tan, relative error below 2e-4 up to 0.49 pi.
+    inline float FastTan(const float x) {
+        const float x2 = x * x;
+        return x * (135135.f - 17325.f * x2 + 378.f * x2 * x2) /
+            (135135.f - 62370.f * x2 + 3150.f * x2 * x2 - 28.f * x2 * x2 * x2);
+    }
+
+    // Shelf as a mix of state variable filter outputs, x * m0 + band * m1 + low * m2.
+    struct ShelfFilterParams {
+        float g, k;
+        float m0, m1, m2;
+    };
+
+    // Shelves at the same cutoff share a topology, so blending their parameters moves smoothly between them.
+    inline ShelfFilterParams Lerp(const ShelfFilterParams& lhs, const ShelfFilterParams& rhs, const float t) {
+        return ShelfFilterParams{ lhs.g + (rhs.g - lhs.g) * t, lhs.k + (rhs.k - lhs.k) * t,
+            lhs.m0 + (rhs.m0 - lhs.m0) * t, lhs.m1 + (rhs.m1 - lhs.m1) * t, lhs.m2 + (rhs.m2 - lhs.m2) * t };
+    }
+
+    // Topology preserving transform state variable filter (Simper). Stable under per sample changes of cutoff and
+    // resonance since the state is the integrator outputs, not past samples.
+    struct StateVariableFilter {
+        struct Outputs {
+            float low;
+            float band;
+            float high;
+        };
+
+        StateVariableFilter() : ic1eq(0.f), ic2eq(0.f) {}
+        float ic1eq, ic2eq;
+
+        // g is tan(pi * cutoff_percent), k is 1 / Q.
+        Outputs Process(const float x, const float g, const float k) {
+            const float a1 = 1.f / (1.f + g * (g + k));
+            const float a2 = g * a1;
+            const float a3 = g * a2;
+            const float v3 = x - ic2eq;
+            const float v1 = a1 * ic1eq + a2 * v3;
+            const float v2 = ic2eq + a2 * ic1eq + a3 * v3;
+            ic1eq = 2.f * v1 - ic1eq;
+            ic2eq = 2.f * v2 - ic2eq;
+            return Outputs{ v2, v1, x - k * v1 - v2 };
+        }
+
+        float Shelf(const float x, const ShelfFilterParams& params) {
+            const Outputs outputs = Process(x, params.g, params.k);
+            return params.m0 * x + params.m1 * outputs.band + params.m2 * outputs.low;
+        }
+
+        void Reset() {
+            ic1eq = 0.f;
+            ic2eq = 0.f;
+        }
+    };
+
     inline TwoPoleFilterParams TwoPoleNullConfig() {
         return TwoPoleFilterParams(1.f, 0.f, 0.f, 0.f, 0.f);
     }
     TwoPoleFilterParams TwoPoleButterworthLowShelfConfig(const float cuttoff_percent, const float gain_db);
     TwoPoleFilterParams TwoPoleButterworthHighShelfConfig(const float cuttoff_percent, const float gain_db);
+    // 0 dB gives the flat shelf with the same g, so movements to and from flat interpolate cleanly.
+    ShelfFilterParams ShelfButterworthLowConfig(const float cuttoff_percent, const float gain_db);
+    ShelfFilterParams ShelfButterworthHighConfig(const float cuttoff_percent, const float gain_db);
+    TwoPoleFilterParams TwoPoleButterworthLowPassConfig(const float cuttoff_percent);
+    TwoPoleFilterParams TwoPoleButterworthHighPassConfig(const float cuttoff_percent);
+    // Unity magnitude with the phase of a Linkwitz-Riley low pass and high pass summed at the same cutoff.
+    TwoPoleFilterParams TwoPoleButterworthAllPassConfig(const float cuttoff_percent);
 }
@@ -0,0 +1,101 @@
+// nLoudness - ITU-R BS.1770 loudness measurement
+// Author - Nic Taylor
+
+#include "nLoudness.h"
+#include "nMath.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+namespace nMath {
+    namespace {
+        inline float BlockLoudness(const double mean_square) {
+            return mean_square > 0.0 ? static_cast<float>(-0.691 + 10.0 * log10(mean_square)) : -HUGE_VALF;
+        }
+    }
+
+    KWeighting::KWeighting() : shelf_left(0.f), shelf_right(0.f) {
+    }
+
+    void KWeighting::Prepare(const float sample_rate) {
+        // Analog prototypes of the BS.1770 filters so any sample rate gets the 48 kHz response.
+        const double shelf_k = tan(M_PI * 1681.974450955533 / sample_rate);
+        const double shelf_q = 0.7071752369554196;
+        const double shelf_vh = pow(10.0, 3.999843853973347 / 20.0);
+        const double shelf_vb = pow(shelf_vh, 0.4996667741545416);
+        const double shelf_a0 = 1.0 + shelf_k / shelf_q + shelf_k * shelf_k;
+        const TwoPoleFilterParams shelf(
+            static_cast<float>((shelf_vh + shelf_vb * shelf_k / shelf_q + shelf_k * shelf_k) / shelf_a0),
+            static_cast<float>(2.0 * (shelf_k * shelf_k - shelf_vh) / shelf_a0),
+            static_cast<float>((shelf_vh - shelf_vb * shelf_k / shelf_q + shelf_k * shelf_k) / shelf_a0),
+            static_cast<float>(2.0 * (shelf_k * shelf_k - 1.0) / shelf_a0),
+            static_cast<float>((1.0 - shelf_k / shelf_q + shelf_k * shelf_k) / shelf_a0));
+
+        const double high_pass_k = tan(M_PI * 38.13547087602444 / sample_rate);
+        const double high_pass_q = 0.5003270373238773;
+        const double high_pass_a0 = 1.0 + high_pass_k / high_pass_q + high_pass_k * high_pass_k;
+        const TwoPoleFilterParams high_pass(1.f, -2.f, 1.f,
+            static_cast<float>(2.0 * (high_pass_k * high_pass_k - 1.0) / high_pass_a0),
+            static_cast<float>((1.0 - high_pass_k / high_pass_q + high_pass_k * high_pass_k) / high_pass_a0));
+
+        lanes.SetLane(0, shelf);
+        lanes.SetLane(1, shelf);
+        lanes.SetLane(2, high_pass);
+        lanes.SetLane(3, high_pass);
+        Reset();
+    }
+
+    void KWeighting::Reset() {
+        lanes.Reset();
+        shelf_left = 0.f;
+        shelf_right = 0.f;
+    }
+
+    float KWeighting::Process(const float left, const float right) {
+        alignas(16) float x[4] = { left, right, shelf_left, shelf_right };
+        lanes.Apply(x);
+        shelf_left = x[0];
+        shelf_right = x[1];
+        return x[2] * x[2] + x[3] * x[3];
+    }
+
+    float GatedLoudness(const std::vector<double>& hop_energy, const uint32_t frames_per_hop) {
+        constexpr size_t kHopsPerBlock = 4;
+        if (hop_energy.size() < kHopsPerBlock || frames_per_hop == 0) {
+            return kLoudnessAbsoluteGate;
+        }
+        const size_t num_blocks = hop_energy.size() - kHopsPerBlock + 1;
+        std::vector<double> blocks(num_blocks);
+        double window = 0.0;
+        for (size_t hop = 0; hop < hop_energy.size(); ++hop) {
+            window += hop_energy[hop];
+            if (hop >= kHopsPerBlock) {
+                window -= hop_energy[hop - kHopsPerBlock];
+            }
+            if (hop + 1 >= kHopsPerBlock) {
+                blocks[hop + 1 - kHopsPerBlock] = nMath::Max(window, 0.0) / (kHopsPerBlock * frames_per_hop);
+            }
+        }
+
+        auto gated_mean = [&blocks](const float gate, double& mean) {
+            double sum = 0.0;
+            size_t count = 0;
+            for (const double block : blocks) {
+                if (BlockLoudness(block) > gate) {
+                    sum += block;
+                    ++count;
+                }
+            }
+            mean = count ? sum / count : 0.0;
+            return count > 0;
+        };
+        double mean = 0.0;
+        if (!gated_mean(kLoudnessAbsoluteGate, mean)) {
+            return kLoudnessAbsoluteGate;
+        }
+        if (!gated_mean(BlockLoudness(mean) - 10.f, mean)) {
+            return kLoudnessAbsoluteGate;
+        }
+        return nMath::Max(BlockLoudness(mean), kLoudnessAbsoluteGate);
+    }
+}
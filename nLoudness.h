@@ -0,0 +1,34 @@
+// nLoudness - ITU-R BS.1770 loudness measurement
+// Author - Nic Taylor
+
+#pragma once
+#include <vector>
+#include <stdint.h>
+
+#include "nCrossover.h"
+
+namespace nMath {
+    // Blocks quieter than the absolute gate are ignored, a measurement with nothing above it reads as the gate.
+    constexpr float kLoudnessAbsoluteGate = -70.f;
+
+    // K-weighting pre-filter for a stereo pair. The shelf and the high pass are pipelined a frame apart so all four
+    // biquads run as one vector biquad.
+    class KWeighting {
+    public:
+        KWeighting();
+
+        void Prepare(const float sample_rate);
+        void Reset();
+        // Sum of the squared weighted channels of the frame before this one.
+        float Process(const float left, const float right);
+
+    private:
+        BiquadLanes lanes;
+        float shelf_left;
+        float shelf_right;
+    };
+
+    // Integrated loudness in LUFS from the weighted energy of each 100 ms hop summed over channels. Blocks are
+    // 400 ms with 75% overlap, gated at kLoudnessAbsoluteGate and then 10 LU under the absolute gated loudness.
+    float GatedLoudness(const std::vector<double>& hop_energy, const uint32_t frames_per_hop);
+}
@@ -0,0 +1,153 @@
+// nResampler - windowed sinc interpolation at fractional positions
+// Author - Nic Taylor
+
+#include "nResampler.h"
+#include "nMath.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <assert.h>
+#include <string.h>
+#include <xmmintrin.h>
+
+namespace nMath {
+    SincResampler::SincResampler(const float cutoff_) : cutoff(cutoff_) {
+        static_assert(kTaps % 4 == 0, "kTaps must be a multiple of 4.");
+        table.resize((kPhases + 1) * kTaps);
+        const double half_width = kTaps / 2.0;
+        for (int32_t phase = 0; phase <= kPhases; ++phase) {
+            const double fraction = phase / (double)kPhases;
+            double sum = 0.0;
+            for (int32_t tap = 0; tap < kTaps; ++tap) {
+                // Distance from the interpolated position to input frame tap - kLeadFrames.
+                const double x = (tap - kLeadFrames) - fraction;
+                const double sinc = fabs(x) < 1e-9 ? 1.0 : sin(M_PI * cutoff * x) / (M_PI * cutoff * x);
+                const double t = (x + half_width) / (2.0 * half_width); // 0 to 1 across the kernel
+                const double blackman = t <= 0.0 || t >= 1.0 ? 0.0 :
+                    0.42 - 0.5 * cos(2.0 * M_PI * t) + 0.08 * cos(4.0 * M_PI * t);
+                table[phase * kTaps + tap] = static_cast<float>(cutoff * sinc * blackman);
+                sum += table[phase * kTaps + tap];
+            }
+            // Unity gain at DC for every phase.
+            for (int32_t tap = 0; tap < kTaps; ++tap) {
+                table[phase * kTaps + tap] = static_cast<float>(table[phase * kTaps + tap] / sum);
+            }
+        }
+    }
+
+    void SincResampler::Coefficients(const float fraction, float* coefficients) const {
+        assert(fraction >= 0.f && fraction <= 1.f);
+        const float position = fraction * kPhases;
+        const int32_t phase = nMath::Min(static_cast<int32_t>(position), kPhases - 1);
+        const __m128 blend = _mm_set1_ps(position - phase);
+        float const * const lower = &table[phase * kTaps];
+        float const * const upper = lower + kTaps;
+        for (int32_t tap = 0; tap < kTaps; tap += 4) {
+            const __m128 low = _mm_loadu_ps(lower + tap);
+            const __m128 high = _mm_loadu_ps(upper + tap);
+            _mm_storeu_ps(coefficients + tap, _mm_add_ps(low, _mm_mul_ps(blend, _mm_sub_ps(high, low))));
+        }
+    }
+
+    float SincResampler::Apply(float const * const input, float const * const coefficients) {
+        __m128 sum = _mm_setzero_ps();
+        for (int32_t tap = 0; tap < kTaps; tap += 4) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(input + tap), _mm_loadu_ps(coefficients + tap)));
+        }
+        float lanes[4];
+        _mm_storeu_ps(lanes, sum);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+
+    float SincResampler::Interpolate(float const * const input, const float fraction) const {
+        float coefficients[kTaps];
+        Coefficients(fraction, coefficients);
+        return Apply(input, coefficients);
+    }
+
+    namespace {
+        inline float Hermite(float const * const x, const float t) {
+            const float c1 = 0.5f * (x[2] - x[0]);
+            const float c2 = x[0] - 2.5f * x[1] + 2.f * x[2] - 0.5f * x[3];
+            const float c3 = 0.5f * (x[3] - x[0]) + 1.5f * (x[1] - x[2]);
+            return ((c3 * t + c2) * t + c1) * t + x[1];
+        }
+    }
+
+    StreamResampler::StreamResampler() : input_rate(0.0), output_rate(0.0), ratio(1.0), max_output_frames(0),
+        buffered(0), pending(0), position(0.0) {
+    }
+
+    void StreamResampler::Prepare(const double input_rate_, const double output_rate_,
+        const int32_t max_output_frames_) {
+        assert(input_rate_ > 0.0 && output_rate_ > 0.0 && max_output_frames_ > 0);
+        input_rate = input_rate_;
+        output_rate = output_rate_;
+        ratio = input_rate / output_rate;
+        max_output_frames = max_output_frames_;
+        // Lower the cutoff to the output Nyquist when decimating.
+        sinc = SincResampler(0.95f * static_cast<float>(nMath::Min(1.0, 1.0 / ratio)));
+        const size_t capacity = static_cast<size_t>(ceil(max_output_frames * ratio)) + SincResampler::kTaps + 2;
+        input_left.assign(capacity, 0.f);
+        input_right.assign(capacity, 0.f);
+        Reset();
+    }
+
+    void StreamResampler::Reset() {
+        // Silent history so the first frames have taps before them.
+        buffered = SincResampler::kLeadFrames;
+        pending = 0;
+        position = SincResampler::kLeadFrames;
+        memset(input_left.data(), 0, buffered * sizeof(float));
+        memset(input_right.data(), 0, buffered * sizeof(float));
+    }
+
+    int32_t StreamResampler::Reserve(const int32_t num_frames) {
+        assert(num_frames <= max_output_frames);
+        const double last = position + (num_frames - 1) * ratio;
+        const int32_t needed = static_cast<int32_t>(last) + SincResampler::kTailFrames + 1;
+        pending = nMath::Max(needed - buffered, 0);
+        assert(static_cast<size_t>(buffered + pending) <= input_left.size());
+        memset(&input_left[buffered], 0, pending * sizeof(float));
+        memset(&input_right[buffered], 0, pending * sizeof(float));
+        return pending;
+    }
+
+    void StreamResampler::Process(float* left, float* right, const int32_t num_frames,
+        const ResampleQuality quality) {
+        buffered += pending;
+        pending = 0;
+        float const * const input_l = input_left.data();
+        float const * const input_r = input_right.data();
+        for (int32_t i = 0; i < num_frames; ++i) {
+            const int32_t frame = static_cast<int32_t>(position);
+            const float fraction = static_cast<float>(position - frame);
+            switch (quality) {
+            case RQ_LINEAR:
+                left[i] = input_l[frame] + fraction * (input_l[frame + 1] - input_l[frame]);
+                right[i] = input_r[frame] + fraction * (input_r[frame + 1] - input_r[frame]);
+                break;
+            case RQ_CUBIC:
+                left[i] = Hermite(input_l + frame - 1, fraction);
+                right[i] = Hermite(input_r + frame - 1, fraction);
+                break;
+            default:
+            {
+                float coefficients[SincResampler::kTaps];
+                sinc.Coefficients(fraction, coefficients);
+                left[i] = SincResampler::Apply(input_l + frame - SincResampler::kLeadFrames, coefficients);
+                right[i] = SincResampler::Apply(input_r + frame - SincResampler::kLeadFrames, coefficients);
+            }
+                break;
+            }
+            position += ratio;
+        }
+        // Keep the taps the next block needs behind its first output.
+        const int32_t discard = nMath::Max(static_cast<int32_t>(position) - SincResampler::kLeadFrames, 0);
+        const int32_t kept = buffered - discard;
+        memmove(input_left.data(), input_l + discard, kept * sizeof(float));
+        memmove(input_right.data(), input_r + discard, kept * sizeof(float));
+        buffered = kept;
+        position -= discard;
+    }
+}
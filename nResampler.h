@@ -0,0 +1,81 @@
+// nResampler - windowed sinc interpolation at fractional positions
+// Author - Nic Taylor
+
+#pragma once
+#include <vector>
+#include <stdint.h>
+
+namespace nMath {
+    // Polyphase Blackman windowed sinc. Coefficients between the stored phases are interpolated linearly, so any
+    // fraction can be read without building a table per ratio. The cutoff is relative to the input Nyquist and
+    // should be lowered by the ratio when decimating.
+    class SincResampler {
+    public:
+        static constexpr int32_t kTaps = 16; // multiple of 4 for SSE
+        static constexpr int32_t kPhases = 128;
+        // Input frames needed before and after the interpolated position.
+        static constexpr int32_t kLeadFrames = kTaps / 2 - 1;
+        static constexpr int32_t kTailFrames = kTaps / 2;
+
+        explicit SincResampler(const float cutoff = 0.95f);
+
+        float Cutoff() const { return cutoff; }
+        // kTaps coefficients for input frames [frame - kLeadFrames, frame + kTailFrames] at frame + fraction.
+        void Coefficients(const float fraction, float* coefficients) const;
+        // Dot product of kTaps input values with coefficients.
+        static float Apply(float const * const input, float const * const coefficients);
+        float Interpolate(float const * const input, const float fraction) const;
+        template <class Ranges>
+        void WorkingMemory(Ranges& ranges) const { ranges.Add(table); }
+
+    private:
+        float cutoff;
+        std::vector<float> table; // kPhases + 1 rows of kTaps
+    };
+
+    enum ResampleQuality : int {
+        RQ_LINEAR,
+        RQ_CUBIC, // 4 point Hermite
+        RQ_SINC,
+    };
+
+    // Converts a stereo stream pulled in blocks from one rate to another. Prepare sizes the buffers for the largest
+    // output block, so each block pulls a bounded number of input frames and Process never allocates. Quality
+    // can change between blocks; linear is roughly a quarter of the cost of sinc.
+    class StreamResampler {
+    public:
+        StreamResampler();
+
+        void Prepare(const double input_rate, const double output_rate, const int32_t max_output_frames);
+        void Reset();
+        double InputRate() const { return input_rate; }
+        double OutputRate() const { return output_rate; }
+        bool Bypassed() const { return input_rate == output_rate; }
+        int32_t MaxOutputFrames() const { return max_output_frames; }
+
+        // Input frames to write before Process for num_frames of output, at most max_output_frames. The pending
+        // input is cleared so a source that writes nothing reads as silence.
+        int32_t Reserve(const int32_t num_frames);
+        float* PendingLeft() { return &input_left[buffered]; }
+        float* PendingRight() { return &input_right[buffered]; }
+        void Process(float* left, float* right, const int32_t num_frames, const ResampleQuality quality);
+        template <class Ranges>
+        void WorkingMemory(Ranges& ranges) const {
+            sinc.WorkingMemory(ranges);
+            ranges.Add(input_left);
+            ranges.Add(input_right);
+        }
+
+    private:
+        double input_rate;
+        double output_rate;
+        double ratio; // input frames per output frame
+        int32_t max_output_frames;
+        SincResampler sinc;
+        std::vector<float> input_left;
+        std::vector<float> input_right;
+        int32_t buffered;
+        int32_t pending;
+        double position; // next output in input frames from the start of the buffer
+    };
+}